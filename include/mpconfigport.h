@@ -124,6 +124,26 @@ extern void mp_hal_end_atomic_section(void);
 #define MICROPY_BEGIN_ATOMIC_SECTION() mp_hal_begin_atomic_section()
 #define MICROPY_END_ATOMIC_SECTION(state) mp_hal_end_atomic_section()
 
+// Called periodically by the VM to account for (and limit) CPU usage.
+void mp_hal_vm_hook(void);
+
+#define MICROPY_VM_HOOK_COUNT (64)
+#define MICROPY_VM_HOOK_INIT static __thread unsigned int vm_hook_divisor = MICROPY_VM_HOOK_COUNT;
+#define MICROPY_VM_HOOK_POLL if (--vm_hook_divisor == 0) { \
+		vm_hook_divisor = MICROPY_VM_HOOK_COUNT; \
+		mp_hal_vm_hook(); \
+	}
+#define MICROPY_VM_HOOK_LOOP MICROPY_VM_HOOK_POLL
+#define MICROPY_VM_HOOK_RETURN MICROPY_VM_HOOK_POLL
+
+// Monotonic time of the current interpreter (which may be simulated).
+uint64_t mp_hal_clock_us(void);
+// Returns non-zero if the delay has been simulated.
+int mp_hal_clock_delay_us(uint64_t us);
+// Time of day of the current interpreter (which may be simulated).
+struct timeval;
+void mp_hal_clock_timeofday(struct timeval *tv);
+
 // Seconds since the Epoch.
 int32_t mp_hal_time_s(void);
 // Milliseconds since the Epoch.
@@ -40,11 +40,11 @@
 #include <esp_timer.h>
 
 mp_uint_t mp_hal_ticks_ms(void) {
-    return esp_timer_get_time() / 1000ULL;
+    return mp_hal_clock_us() / 1000ULL;
 }
 
 mp_uint_t mp_hal_ticks_us(void) {
-    return esp_timer_get_time();
+    return mp_hal_clock_us();
 }
 
 #ifdef ENV_NATIVE
@@ -52,18 +52,26 @@ mp_uint_t mp_hal_ticks_us(void) {
 # include <unistd.h>
 
 void mp_hal_delay_ms(mp_uint_t ms) {
+    if (mp_hal_clock_delay_us(ms * 1000ULL)) {
+        return;
+    }
+
     struct timespec ts = {
-        .tv_sec = 0,
-        .tv_nsec = ms * 1000000,
+        .tv_sec = ms / 1000,
+        .tv_nsec = (ms % 1000) * 1000000,
     };
 
     nanosleep(&ts, NULL);
 }
 
 void mp_hal_delay_us(mp_uint_t us) {
+    if (mp_hal_clock_delay_us(us)) {
+        return;
+    }
+
     struct timespec ts = {
-        .tv_sec = 0,
-        .tv_nsec = us * 1000,
+        .tv_sec = us / 1000000,
+        .tv_nsec = (us % 1000000) * 1000,
     };
 
     nanosleep(&ts, NULL);
@@ -73,6 +81,10 @@ void mp_hal_delay_us(mp_uint_t us) {
 # include "freertos/task.h"
 
 void mp_hal_delay_ms(mp_uint_t ms) {
+    if (mp_hal_clock_delay_us(ms * 1000ULL)) {
+        return;
+    }
+
     uint64_t us = ms * 1000;
     uint64_t dt;
     uint64_t t0 = esp_timer_get_time();
@@ -100,6 +112,10 @@ void mp_hal_delay_ms(mp_uint_t ms) {
 }
 
 void mp_hal_delay_us(mp_uint_t us) {
+    if (mp_hal_clock_delay_us(us)) {
+        return;
+    }
+
     // these constants are tested for a 240MHz clock
     const uint32_t this_overhead = 5;
     const uint32_t pend_overhead = 150;
@@ -127,7 +143,7 @@ void mp_hal_delay_us(mp_uint_t us) {
 
 int32_t mp_hal_time_s(void) {
     struct timeval tv;
-    gettimeofday(&tv, NULL);
+    mp_hal_clock_timeofday(&tv);
     int32_t seconds = tv.tv_sec;
     #if !MICROPY_EPOCH_IS_1970
     seconds = (uint32_t)seconds - TIMEUTILS_SECONDS_1970_TO_2000;
@@ -137,7 +153,7 @@ int32_t mp_hal_time_s(void) {
 
 int64_t mp_hal_time_ms(void) {
     struct timeval tv;
-    gettimeofday(&tv, NULL);
+    mp_hal_clock_timeofday(&tv);
     int32_t seconds = tv.tv_sec;
     #if !MICROPY_EPOCH_IS_1970
     seconds = (uint32_t)seconds - TIMEUTILS_SECONDS_1970_TO_2000;
@@ -149,7 +165,7 @@ int64_t mp_hal_time_ms(void) {
 
 int64_t mp_hal_time_us(void) {
     struct timeval tv;
-    gettimeofday(&tv, NULL);
+    mp_hal_clock_timeofday(&tv);
     int32_t seconds = tv.tv_sec;
     #if !MICROPY_EPOCH_IS_1970
     seconds = (uint32_t)seconds - TIMEUTILS_SECONDS_1970_TO_2000;
@@ -161,7 +177,7 @@ int64_t mp_hal_time_us(void) {
 
 int64_t mp_hal_time_ns(void) {
     struct timeval tv;
-    gettimeofday(&tv, NULL);
+    mp_hal_clock_timeofday(&tv);
     int32_t seconds = tv.tv_sec;
     #if !MICROPY_EPOCH_IS_1970
     seconds = (uint32_t)seconds - TIMEUTILS_SECONDS_1970_TO_2000;
@@ -0,0 +1,30 @@
+import cbor2
+import os
+import sys
+
+TYPES = ["buses", "presets", "profiles", "scripts"]
+
+def content_hash(data):
+	value = 0xcbf29ce484222325
+	for byte in data:
+		value ^= byte
+		value = (value * 0x100000001b3) & 0xffffffffffffffff
+	return value
+
+base = sys.argv[1]
+files = {}
+
+for directory in TYPES:
+	path = os.path.join(base, directory)
+	if not os.path.isdir(path):
+		continue
+
+	for filename in sorted(os.listdir(path)):
+		with open(os.path.join(path, filename), "rb") as f:
+			files[directory + "/" + filename] = f.read()
+
+with open(os.path.join(base, "manifest.cbor"), "wb") as f:
+	cbor2.dump({name: [len(data), content_hash(data)] for name, data in files.items()}, f)
+
+with open(os.path.join(base, "bundle.cbor"), "wb") as f:
+	cbor2.dump(files, f)
@@ -33,9 +33,9 @@ aurcor.register_config(config)
 
 def generate():
 	if config["real_time"]:
-		next_output_us = aurcor.next_time_us()
+		next_output_us = aurcor.next_time_us(mod=period_us)
 	else:
-		next_output_us = aurcor.next_ticks64_us()
+		next_output_us = aurcor.next_ticks64_us(mod=period_us)
 
 	current_us = (next_output_us % total_duration_us)
 	burst_idx = current_us // burst_duration_us
@@ -69,7 +69,7 @@ def generate():
 				elif pos < fade_active_length:
 					buffer[i] = colour
 				elif pos < fade_active_fade_length:
-					buffer[i] = hue, saturation, fade_multipliers[fade_length - (fade_active_fade_length - pos) - 1]
+					buffer[i] = hue, saturation, value * fade_multipliers[pos - fade_active_length]
 				else:
 					buffer[i] = 0, 0, 0
 
@@ -111,6 +111,10 @@ while True:
 		blank_duration_us = blank_length * interval_us
 		total_burst_duration_us = burst_duration_us * burst_count
 		total_duration_us = total_burst_duration_us + blank_duration_us
+		# Only the position within the full colour cycle is needed
+		period_us = total_duration_us * colour_count
+		if not 0 < period_us < (1 << 30):
+			period_us = None
 
 		colours = list(map(aurcor.rgb_to_hsv_tuple, config["colours"]))
 		fade_multipliers = list([config["fade_rate1"] * (config["fade_rateN"] ** n) / aurcor.MAX_VALUE for n in range(0, fade_length)])
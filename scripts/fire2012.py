@@ -145,9 +145,9 @@ while True:
 		aurcor.output_rgb(buffer)
 	elif config["auto"] == AUTO_EXP_HUE_FADE:
 		if config["real_time"]:
-			next_output_ms = aurcor.next_time_ms()
+			next_output_ms = aurcor.next_time_ms(mod=config["hue_duration"])
 		else:
-			next_output_ms = aurcor.next_ticks64_ms()
+			next_output_ms = aurcor.next_ticks64_ms(mod=config["hue_duration"])
 
 		hue = aurcor.EXP_HUE_RANGE * (next_output_ms % config["hue_duration"]) // config["hue_duration"]
 
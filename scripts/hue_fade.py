@@ -37,13 +37,13 @@ while True:
 			update_us = 0
 
 		sweep.config_changed(config)
-		twinkle.config_changed(config)
+		twinkle.config_changed(config, not sweep.enabled())
 		aurcor.output_defaults(**sweep.apply_default_config())
 
 	if config["real_time"]:
-		next_output_ms = aurcor.next_time_ms()
+		next_output_ms = aurcor.next_time_ms(mod=config["duration"])
 	else:
-		next_output_ms = aurcor.next_ticks64_ms()
+		next_output_ms = aurcor.next_ticks64_ms(mod=config["duration"])
 
 	hue = aurcor.EXP_HUE_RANGE * (next_output_ms % config["duration"]) // config["duration"]
 
@@ -52,7 +52,8 @@ while True:
 			aurcor.output_exp_hsv(sweep.apply_mask_hsv([[hue, aurcor.MAX_SATURATION, aurcor.MAX_VALUE]] * aurcor.length()))
 		else:
 			sweep.sleep(update_us)
-	elif twinkle.enabled():
+	elif twinkle.enabled() and not twinkle.layered():
 		aurcor.output_exp_hsv(twinkle.apply_hsv([[hue, aurcor.MAX_SATURATION, aurcor.MAX_VALUE]] * aurcor.length()))
 	else:
+		twinkle.apply_layer()
 		aurcor.output_exp_hsv([hue], repeat=True)
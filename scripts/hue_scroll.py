@@ -31,9 +31,9 @@ def generate():
 
 	if config["duration"] > 0:
 		if config["real_time"]:
-			next_output_ms = aurcor.next_time_ms()
+			next_output_ms = aurcor.next_time_ms(mod=config["duration"])
 		else:
-			next_output_ms = aurcor.next_ticks64_ms()
+			next_output_ms = aurcor.next_ticks64_ms(mod=config["duration"])
 
 		hue = (next_output_ms % config["duration"]) / config["duration"]
 	else:
@@ -52,7 +52,8 @@ while True:
 
 		twinkle.config_changed(config)
 
-	if twinkle.enabled():
+	if twinkle.enabled() and not twinkle.layered():
 		aurcor.output_exp_hsv(twinkle.apply_hsv(list(generate())))
 	else:
+		twinkle.apply_layer()
 		aurcor.output_exp_hsv(list(generate()))
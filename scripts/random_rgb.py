@@ -49,14 +49,15 @@ def generate_type2(without=None):
 	return (random.randint(0, aurcor.EXP_HUE_RANGE - 1), aurcor.MAX_SATURATION, aurcor.MAX_VALUE)
 
 def fill():
-	global buffer, positions, last
+	global buffer, positions, last, elapsed_us
 
 	buffer = [[0, 0, 0]] * aurcor.length()
 	positions = list(range(0, aurcor.length()))
 	for pos in positions:
 		buffer[pos] = generate()
 
-	last = aurcor.ticks64_us()
+	last = aurcor.ticks30_us()
+	elapsed_us = 0
 
 def shuffle(count):
 	length = len(positions) - 1
@@ -79,12 +80,16 @@ def replace(count):
 			buffer[positions[pos]] = generate(buffer[pos])
 
 def change():
-	global last
+	global last, elapsed_us
 
-	now = aurcor.ticks64_us()
-	if now - last >= interval_us:
-		replace(min((now - last) // interval_us * config["count"], len(buffer)))
-		last = now
+	# Accumulate the time between calls because 30-bit ticks wrap
+	# too often to compare directly against long intervals
+	now = aurcor.ticks30_us()
+	elapsed_us += aurcor.ticks30_diff(now, last)
+	last = now
+	if elapsed_us >= interval_us:
+		replace(min(elapsed_us // interval_us * config["count"], len(buffer)))
+		elapsed_us = 0
 
 while True:
 	if aurcor.config(config):
@@ -115,7 +120,7 @@ while True:
 		fill()
 
 		sweep.config_changed(config)
-		twinkle.config_changed(config)
+		twinkle.config_changed(config, not sweep.enabled())
 		aurcor.output_defaults(**sweep.apply_default_config(defaults))
 
 	change()
@@ -124,7 +129,8 @@ while True:
 			aurcor.output_hsv(sweep.apply_mask_hsv(buffer))
 		else:
 			sweep.sleep(update_us)
-	elif twinkle.enabled():
+	elif twinkle.enabled() and not twinkle.layered():
 		aurcor.output_hsv(twinkle.apply_hsv(buffer))
 	else:
+		twinkle.apply_layer()
 		aurcor.output_hsv(buffer)
@@ -38,9 +38,9 @@ def repeat_colours():
 while True:
 	if aurcor.config(config):
 		sweep.config_changed(config)
-		twinkle.config_changed(config)
+		twinkle.config_changed(config, not sweep.enabled())
 
-		if sweep.enabled() or twinkle.enabled():
+		if sweep.enabled() or (twinkle.enabled() and not twinkle.layered()):
 			repeat_colours()
 			colours = list(map(aurcor.rgb_to_hsv_tuple, config["colours"]))
 
@@ -51,7 +51,8 @@ while True:
 			aurcor.output_hsv(sweep.apply_mask_hsv(colours))
 		else:
 			sweep.sleep()
-	elif twinkle.enabled():
+	elif twinkle.enabled() and not twinkle.layered():
 		aurcor.output_hsv(twinkle.apply_hsv(colours))
 	else:
+		twinkle.apply_layer()
 		aurcor.output_rgb(config["colours"], repeat=True)
@@ -81,13 +81,13 @@ def enabled():
 def refresh():
 	global current_pos, last_update_us
 
-	now_us = aurcor.ticks64_us()
+	now_us = aurcor.ticks30_us()
 
 	if last_update_us is None:
 		last_update_us = now_us
 		return True
 
-	elapsed_us = now_us - last_update_us
+	elapsed_us = aurcor.ticks30_diff(now_us, last_update_us)
 	if elapsed_us >= interval_us:
 		current_pos = (current_pos + 1) % (2 * sweep_length)
 		last_update_us = now_us
@@ -96,10 +96,10 @@ def refresh():
 	return False
 
 def sleep(max_us=1000000):
-	now_us = aurcor.ticks64_us()
+	now_us = aurcor.ticks30_us()
 	timeout_us = min(interval_us, max_us)
 
-	elapsed_us = now_us - last_update_us
+	elapsed_us = aurcor.ticks30_diff(now_us, last_update_us)
 	if elapsed_us < timeout_us:
 		time.sleep_us(timeout_us - elapsed_us)
 
@@ -22,6 +22,11 @@ MODE_RAISE_VALUE = const(1) # Start at minimum level, twinkling to maximum
 MODE_RAISE_SATURATION_VALUE = const(2) # Start saturation at zero, twinkling to full; value as above
 MAX_MODE = const(2)
 
+LAYER = const(0)
+MAX_LEVEL = const(255)
+
+layer = None
+
 def create_config(enabled=False):
 	return {
 		"twinkle.enabled": ("bool", enabled),
@@ -32,14 +37,15 @@ def create_config(enabled=False):
 		"twinkle.mode": ("s32", MODE_LOWER_VALUE),
 	}
 
-def config_changed(config):
+def config_changed(config, available=True):
 	global is_enabled, length, active_count, max_count, positions, start_times
 	global level_minimum, level_range, invert, inactive_value_multiplier
-	global twinkle_mode, interval_us, duration_us, last
+	global twinkle_mode, interval_us, duration_us, last, pending_us
 
-	is_enabled = config["twinkle.enabled"]
+	is_enabled = available and config["twinkle.enabled"]
 
 	if not is_enabled:
+		disable_layer()
 		return
 
 	if config["twinkle.mode"] < 0 or config["twinkle.mode"] > MAX_MODE:
@@ -65,11 +71,47 @@ def config_changed(config):
 
 	interval_us = max(1, config["twinkle.period"] * 1000 // config["twinkle.number"])
 	duration_us = max(2, config["twinkle.duration"] * 1000)
-	last = aurcor.next_ticks64_us()
+	last = aurcor.next_ticks30_us()
+	pending_us = 0
+
+	# Desaturation can't be done with a blend mode, so it has to be applied
+	# to the values in Python
+	if twinkle_mode == MODE_RAISE_SATURATION_VALUE:
+		disable_layer()
+	else:
+		enable_layer()
+
+def enable_layer():
+	global layer, inactive_level
+
+	if twinkle_mode == MODE_LOWER_VALUE:
+		inactive_level = MAX_LEVEL
+	else:
+		inactive_level = round(MAX_LEVEL * level_minimum)
+
+	try:
+		layer = aurcor.layer(LAYER, mode=aurcor.BLEND_MULTIPLY)
+	except MemoryError:
+		layer = None
+		return
+
+	layer[:] = bytes((inactive_level,)) * len(layer)
+
+def disable_layer():
+	global layer
+
+	if layer is not None:
+		aurcor.layer(LAYER, mode=aurcor.BLEND_NONE)
+		layer = None
 
 def enabled():
 	return is_enabled
 
+# The script's output is multiplied by a brightness layer instead of
+# modifying its values, which must then be output unchanged
+def layered():
+	return is_enabled and layer is not None
+
 def start(now, count):
 	global active_count
 
@@ -102,31 +144,73 @@ def stop(indexes):
 		start_times[n] = tmp
 
 def change(now):
-	global last
+	global last, pending_us
 
-	if now - last >= interval_us:
+	# Accumulate the time between calls because 30-bit ticks wrap
+	# too often to compare directly against long intervals
+	pending_us += aurcor.ticks30_diff(now, last)
+	last = now
+	if pending_us >= interval_us:
 		if active_count < max_count:
-			count = (now - last) // interval_us
+			count = pending_us // interval_us
 			start(now, min(count, max_count - active_count))
-			last += count * interval_us
+			pending_us -= count * interval_us
+		else:
+			pending_us = 0
+
+def apply_layer():
+	if not is_enabled or layer is None:
+		return
+
+	half_duration_us = duration_us // 2
+	level_minimum_range = MAX_LEVEL * level_minimum
+	level_range_range = MAX_LEVEL * level_range
+
+	now = aurcor.next_ticks30_us()
+	change(now)
+	stopped = []
+
+	for n in range(0, active_count):
+		elapsed_us = aurcor.ticks30_diff(now, start_times[n])
+
+		if elapsed_us >= duration_us:
+			stopped.append(n)
+			level = inactive_level
+		elif twinkle_mode == MODE_LOWER_VALUE:
+			if elapsed_us < half_duration_us:
+				level = round(level_minimum_range + level_range_range * ((half_duration_us - elapsed_us - 1) / half_duration_us))
+			else:
+				level = round(level_minimum_range + level_range_range * ((elapsed_us - half_duration_us) / half_duration_us))
 		else:
-			last = now
+			if elapsed_us < half_duration_us:
+				level = round(level_minimum_range + level_range_range * ((elapsed_us + 1) / half_duration_us))
+			else:
+				level = round(level_minimum_range + level_range_range * ((duration_us - elapsed_us) / half_duration_us))
+
+		offset = positions[n] * 3
+		layer[offset] = layer[offset + 1] = layer[offset + 2] = level
+
+	stop(stopped)
 
 def apply_hsv(values):
 	if not is_enabled:
 		return values
 
+	if layer is not None:
+		apply_layer()
+		return values
+
 	half_duration_us = duration_us // 2
 	max_value = aurcor.MAX_VALUE
 	values = values.copy()
 
-	now = aurcor.next_ticks64_us()
+	now = aurcor.next_ticks30_us()
 	change(now)
 	stopped = []
 
 	if twinkle_mode == MODE_LOWER_VALUE:
 		for n in range(0, active_count):
-			elapsed_us = now - start_times[n]
+			elapsed_us = aurcor.ticks30_diff(now, start_times[n])
 			if elapsed_us >= duration_us:
 				stopped.append(n)
 				continue
@@ -142,7 +226,7 @@ def apply_hsv(values):
 			values[pos] = hue, saturation, value
 	elif twinkle_mode == MODE_RAISE_VALUE:
 		for n in range(0, active_count):
-			elapsed_us = now - start_times[n]
+			elapsed_us = aurcor.ticks30_diff(now, start_times[n])
 			if elapsed_us >= duration_us:
 				stopped.append(n)
 				continue
@@ -158,7 +242,7 @@ def apply_hsv(values):
 			values[pos] = hue, saturation, value
 	elif twinkle_mode == MODE_RAISE_SATURATION_VALUE:
 		for n in range(0, active_count):
-			elapsed_us = now - start_times[n]
+			elapsed_us = aurcor.ticks30_diff(now, start_times[n])
 			if elapsed_us >= duration_us:
 				stopped.append(n)
 				continue
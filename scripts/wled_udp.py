@@ -28,7 +28,7 @@ buffer = bytearray(buffer_len)
 
 sources = collections.OrderedDict()
 frames = 0
-last_report_ms = aurcor.ticks64_ms()
+last_report_ms = aurcor.ticks30_ms()
 
 def parse_warls(data, offset, length):
 	while offset + 4 < length:
@@ -96,9 +96,10 @@ while True:
 
 	aurcor.output_rgb(buffer)
 
-	now_ms = aurcor.ticks64_ms()
-	if now_ms - last_report_ms >= 60000:
-		logging.debug(f"Sources: {sources}, {frames / (now_ms - last_report_ms) * 1000} fps")
+	now_ms = aurcor.ticks30_ms()
+	elapsed_ms = aurcor.ticks30_diff(now_ms, last_report_ms)
+	if elapsed_ms >= 60000:
+		logging.debug(f"Sources: {sources}, {frames / elapsed_ms * 1000} fps")
 
 		sources = collections.OrderedDict()
 		frames = 0
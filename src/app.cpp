@@ -24,10 +24,12 @@
 #endif
 
 #include <algorithm>
+#include <array>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -36,20 +38,26 @@
 
 #include "app/gcc.h"
 #include "aurcor/download.h"
+#include "aurcor/file_hash_index.h"
+#include "aurcor/frame_recorder.h"
 #include "aurcor/constants.h"
 #include "aurcor/led_bus.h"
+#include "aurcor/led_bus_config.h"
+#include "aurcor/led_profile.h"
 #include "aurcor/micropython.h"
 #include "aurcor/preset.h"
 #include "aurcor/refresh.h"
 #include "aurcor/spi_led_bus.h"
+#include "aurcor/transition.h"
 #include "aurcor/uart_dma_led_bus.h"
 #include "aurcor/uart_led_bus.h"
+#include "aurcor/util.h"
 #include "aurcor/web_client.h"
 #include "aurcor/web_interface.h"
 
 namespace aurcor {
 
-std::shared_mutex App::file_mutex_;
+std::array<std::shared_mutex,App::FILE_MUTEXES> App::file_mutexes_;
 
 App::App() {
 }
@@ -57,9 +65,34 @@ App::App() {
 App::~App() {
 }
 
+/*
+ * Each top-level directory has its own lock so that reading files in one
+ * directory (e.g. importing scripts) doesn't block writing to another (e.g.
+ * updating presets). Everything else uses the last lock.
+ */
+std::shared_mutex& App::file_mutex(const std::string_view &path) {
+	static const std::array<const char *,FILE_MUTEXES - 1> directories{
+		LEDBusConfig::DIRECTORY_NAME,
+		LEDProfile::DIRECTORY_NAME,
+		MicroPython::DIRECTORY_NAME,
+		Preset::DIRECTORY_NAME,
+	};
+	auto end = path.find('/', 1);
+	auto directory = path.substr(0, end);
+
+	for (size_t i = 0; i < directories.size(); i++) {
+		if (directory == directories[i])
+			return file_mutexes_[i];
+	}
+
+	return file_mutexes_.back();
+}
+
 void App::init() {
 	app::App::init();
 
+	FileHashIndex::load();
+
 #if defined(ARDUINO_LOLIN_S3)
 	/*
 	 * Reserved: Power/Boot (0 3 45 46) USB (19 20) Flash/SPIRAM (26 27 28 29 30 31 32 33 34 35 36 37)
@@ -99,6 +132,14 @@ void App::init() {
 
 	MicroPython::setup(buses_.size());
 	LEDBusUDP::setup(buses_.size());
+	FrameRecording::setup(buses_.size());
+	Transition::setup(MicroPython::SPARE_COUNT);
+
+	for (auto &entry : buses_) {
+		for (size_t profile = LEDProfiles::MIN_ID; profile <= LEDProfiles::MAX_ID; profile++)
+			profile_loader_.add(entry.second, static_cast<enum led_profile_id>(profile), false);
+	}
+	profile_loader_.loop();
 
 	for (auto &entry : buses_) {
 		auto &bus = entry.second;
@@ -154,6 +195,12 @@ std::pair<const std::unordered_map<std::string,std::string>&,std::shared_lock<st
 	return {cached_presets_->descriptions(), std::move(read_lock)};
 }
 
+uint64_t App::preset_descriptions_version() {
+	auto presets = preset_descriptions();
+
+	return ((uint64_t)cached_presets_->id() << 32) | cached_presets_->generation();
+}
+
 void App::add_preset_description(const Preset &preset) {
 	std::unique_lock lock{cached_presets_mutex_};
 
@@ -185,20 +232,53 @@ std::string App::current_preset_name(std::shared_ptr<LEDBus> bus) {
 	return it->second->name();
 }
 
+std::shared_ptr<Preset> App::current_preset(std::shared_ptr<LEDBus> bus) {
+	std::lock_guard lock{presets_map_mutex_};
+	auto it = presets_.find(bus);
+
+	if (it == presets_.end())
+		return nullptr;
+
+	return it->second;
+}
+
 void App::loop() {
 	app::App::loop();
 
 	if (download_ && download_->finished())
 		download_.reset();
 
+	FileHashIndex::save();
+	profile_loader_.loop();
+
 	for (auto &bus : buses_)
 		bus.second->loop();
 
+	for (auto it = outgoing_mps_.begin(); it != outgoing_mps_.end(); ) {
+		if (!(*it)->bus()->transition().active()) {
+			dispose(std::move(*it));
+			it = outgoing_mps_.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	for (auto it = disposed_mps_.begin(); it != disposed_mps_.end(); ) {
+		if ((*it)->stop()) {
+			it = disposed_mps_.erase(it);
+		} else {
+			++it;
+		}
+	}
+
 	refresh_files();
 
 	for (auto &preset : presets_)
 		preset.second->loop();
 
+	if (web_interface_)
+		web_interface_->loop();
+
 	std::unique_lock write_lock{cached_presets_mutex_};
 	if (cached_presets_)
 		cached_presets_->loop();
@@ -239,7 +319,7 @@ bool App::detach(const std::shared_ptr<LEDBus> &bus, const std::shared_ptr<Micro
 	auto it = mps_.find(bus);
 
 	if (it != mps_.end()) {
-		auto &other_mp = it->second;
+		auto other_mp = it->second;
 
 		if (mp && other_mp != mp)
 			return false;
@@ -247,9 +327,22 @@ bool App::detach(const std::shared_ptr<LEDBus> &bus, const std::shared_ptr<Micro
 		if (!other_mp->stop())
 			return false;
 
-		logger_.trace(F("Detach %s[%s] from %s[%s]"),
-			other_mp->type(), other_mp->name().c_str(), bus->type(), bus->name());
-		mps_.erase(it);
+		/* Detach all of the buses in the script's group */
+		for (it = mps_.begin(); it != mps_.end(); ) {
+			if (it->second == other_mp) {
+				auto &other_bus = it->first;
+
+				logger_.trace(F("Detach %s[%s] from %s[%s]"),
+					other_mp->type(), other_mp->name().c_str(), other_bus->type(), other_bus->name());
+
+				if (clear && other_bus != bus)
+					other_bus->clear();
+
+				it = mps_.erase(it);
+			} else {
+				++it;
+			}
+		}
 	}
 
 	if (clear)
@@ -258,6 +351,56 @@ bool App::detach(const std::shared_ptr<LEDBus> &bus, const std::shared_ptr<Micro
 	return true;
 }
 
+bool App::grouped(const std::shared_ptr<LEDBus> &bus) const {
+	auto it = mps_.find(bus);
+
+	return it != mps_.end() && it->second->bus() != bus;
+}
+
+void App::dispose(std::shared_ptr<MicroPython> mp) {
+	if (!mp->stop())
+		disposed_mps_.push_back(std::move(mp));
+}
+
+bool App::transition(const std::shared_ptr<LEDBus> &bus) {
+	auto it = mps_.find(bus);
+
+	if (it == mps_.end() || it->second->bus() != bus)
+		return false;
+
+	auto mp = it->second;
+
+	/* Scripts driving a group of buses can't be blended */
+	for (auto &entry : mps_) {
+		if (entry.second == mp && entry.first != bus)
+			return false;
+	}
+
+	auto type = bus->transition_type();
+	auto duration_ms = bus->transition_ms();
+
+	if (type == Transition::Type::NONE || !duration_ms)
+		return false;
+
+	if (!bus->transition().start(type, duration_ms, current_time_us())) {
+		logger_.debug(F("No buffer available for transition on %s[%s]"), bus->type(), bus->name());
+		return false;
+	}
+
+	if (!mp->outgoing()) {
+		bus->transition().stop();
+		return false;
+	}
+
+	logger_.trace(F("Transition %s[%s] out of %s[%s] (%s, %ums)"),
+		mp->type(), mp->name().c_str(), bus->type(), bus->name(),
+		Transition::name(type), duration_ms);
+
+	mps_.erase(it);
+	outgoing_mps_.push_back(std::move(mp));
+	return true;
+}
+
 bool App::start(const std::shared_ptr<LEDBus> &bus, const std::shared_ptr<Preset> &preset,
 		bool overwrite) {
 	std::unique_lock lock{presets_map_mutex_, std::defer_lock};
@@ -405,7 +548,7 @@ void App::refresh_files() {
 				&& !bus.profile(profile).modified()) {
 			logger_.trace(F("Reload profile \"%s\" on %s[%s]"),
 				LEDProfiles::lc_name(profile), bus.type(), bus.name());
-			bus.load_profile(profile);
+			profile_loader_.add(entry.first, profile, true);
 		}
 	}
 
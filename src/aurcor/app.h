@@ -20,10 +20,12 @@
 
 #include <Arduino.h>
 
+#include <array>
 #include <initializer_list>
 #include <memory>
 #include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -31,6 +33,7 @@
 
 #include "app/app.h"
 #include "led_profiles.h"
+#include "profile_loader.h"
 #include "refresh.h"
 
 namespace aurcor {
@@ -50,7 +53,7 @@ public:
 	void start() override;
 	void loop() override;
 
-	static inline std::shared_mutex& file_mutex() { return file_mutex_; }
+	static std::shared_mutex& file_mutex(const std::string_view &path);
 
 	inline const std::string& immutable_id() const { return app_hash(); }
 
@@ -58,6 +61,12 @@ public:
 	std::shared_ptr<LEDBus> bus(const std::string &name);
 	void attach(const std::shared_ptr<LEDBus> &bus, const std::shared_ptr<MicroPython> &mp);
 	bool detach(const std::shared_ptr<LEDBus> &bus, const std::shared_ptr<MicroPython> &mp = nullptr, bool clear = false);
+	/* Bus is attached to a script running as part of another bus's group */
+	bool grouped(const std::shared_ptr<LEDBus> &bus) const;
+	/* Stop a script that isn't attached to any bus in the background */
+	void dispose(std::shared_ptr<MicroPython> mp);
+	/* Detach the script from the bus but keep it running for a transition */
+	bool transition(const std::shared_ptr<LEDBus> &bus);
 	bool start(const std::shared_ptr<LEDBus> &bus, const std::shared_ptr<Preset> &preset, bool overwrite = true);
 	std::shared_ptr<std::shared_ptr<Preset>> edit(const std::shared_ptr<LEDBus> &bus);
 	bool unsaved_preset(const std::shared_ptr<LEDBus> &bus);
@@ -71,11 +80,17 @@ public:
 	void refresh_files(std::unique_ptr<Refresh> &&refresh);
 
 	std::pair<const std::unordered_map<std::string,std::string>&,std::shared_lock<std::shared_mutex>> preset_descriptions();
+	/*
+	 * Identifies the current content of the preset descriptions, including a
+	 * random ID for the cache so that it's not reused across restarts.
+	 */
+	uint64_t preset_descriptions_version();
 	void add_preset_description(const Preset &preset);
 	void add_preset_description(const std::string &name);
 	void remove_preset_description(const std::string &name);
 
 	std::string current_preset_name(std::shared_ptr<LEDBus> bus);
+	std::shared_ptr<Preset> current_preset(std::shared_ptr<LEDBus> bus);
 
 private:
 	App(App&&) = delete;
@@ -87,16 +102,21 @@ private:
 	void refresh_files();
 	void refresh_presets(const std::unordered_set<std::string> &preset_names);
 
-	static std::shared_mutex file_mutex_;
+	static constexpr size_t FILE_MUTEXES = 5;
+
+	static std::array<std::shared_mutex,FILE_MUTEXES> file_mutexes_;
 
 	std::unordered_map<std::string,std::shared_ptr<LEDBus>> buses_;
 	std::unordered_map<std::shared_ptr<LEDBus>,std::shared_ptr<MicroPython>> mps_;
+	std::vector<std::shared_ptr<MicroPython>> disposed_mps_;
+	std::vector<std::shared_ptr<MicroPython>> outgoing_mps_;
 
 	std::mutex presets_map_mutex_; // Only used to protect WebInterface
 	std::unordered_map<std::shared_ptr<LEDBus>,std::shared_ptr<Preset>> presets_;
 
 	std::unique_ptr<Download> download_;
 	std::unique_ptr<WebInterface> web_interface_;
+	ProfileLoader profile_loader_;
 
 	std::shared_mutex cached_presets_mutex_;
 	std::unique_ptr<PresetDescriptionCache> cached_presets_;
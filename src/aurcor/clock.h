@@ -0,0 +1,87 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <sys/time.h>
+
+#include <cstdint>
+
+#include "util.h"
+
+namespace aurcor {
+
+/*
+ * Monotonic clock and time of day for an interpreter. When simulated, time
+ * only advances when the interpreter waits, and waiting doesn't take any
+ * real time. The time of day starts from the real time of day when the
+ * simulation starts.
+ *
+ * Must only be used by the interpreter's thread while it's running.
+ */
+class Clock {
+public:
+	Clock() = default;
+
+	inline bool simulated() const { return simulated_; }
+	inline void simulate(uint64_t start_us) {
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		simulated_ = true;
+		simulated_us_ = start_us;
+		epoch_offset_us_ = tv.tv_sec * 1000000LL + tv.tv_usec - start_us;
+	}
+
+	inline uint64_t now_us() const {
+		return simulated_ ? simulated_us_ : current_time_us();
+	}
+
+	inline void timeofday(struct timeval &tv) const {
+		if (simulated_) {
+			int64_t epoch_us = epoch_offset_us_ + simulated_us_;
+
+			tv.tv_sec = epoch_us / 1000000LL;
+			tv.tv_usec = epoch_us % 1000000LL;
+		} else {
+			gettimeofday(&tv, NULL);
+		}
+	}
+
+	/* Returns true if the delay has been simulated */
+	inline bool delay_us(uint64_t us) {
+		if (!simulated_)
+			return false;
+
+		simulated_us_ += us;
+		return true;
+	}
+
+private:
+	Clock(Clock&&) = delete;
+	Clock(const Clock&) = delete;
+	Clock& operator=(Clock&&) = delete;
+	Clock& operator=(const Clock&) = delete;
+
+	bool simulated_{false};
+	uint64_t simulated_us_{0};
+	int64_t epoch_offset_us_{0};
+};
+
+} // namespace aurcor
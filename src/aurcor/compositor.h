@@ -0,0 +1,86 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "constants.h"
+
+namespace aurcor {
+
+/*
+ * Blends layers on top of a frame in a single pass, so that scripts can
+ * render overlays into separate buffers without having to combine them with
+ * the base frame in Python.
+ *
+ * Layers are applied in order before the profile transform. They belong to
+ * the script's interpreter, so they can't be used to stack separate scripts
+ * or native effects.
+ */
+class Compositor {
+public:
+	static constexpr size_t MAX_LAYERS = AURCOR_MAX_LAYERS;
+	static constexpr uint8_t MAX_OPACITY = UINT8_MAX;
+
+	enum class Blend : uint8_t {
+		NONE = AURCOR_BLEND_NONE,
+		ADD = AURCOR_BLEND_ADD,
+		MULTIPLY = AURCOR_BLEND_MULTIPLY,
+		MAX = AURCOR_BLEND_MAX,
+		ALPHA = AURCOR_BLEND_ALPHA,
+	};
+
+	Compositor(size_t max_bytes) : max_bytes_(max_bytes) {}
+	~Compositor() = default;
+
+	static bool valid(int mode);
+
+	/*
+	 * Configures a layer and returns its buffer, allocating it if necessary
+	 * (initially black). Throws std::bad_alloc if there's not enough memory.
+	 */
+	uint8_t *layer(size_t index, Blend mode, uint8_t opacity);
+	inline size_t layer_bytes() const { return max_bytes_; }
+
+	void apply(uint8_t *buffer, size_t size) const;
+	/* Apply to a copy of the frame, leaving the source unmodified */
+	void apply(const uint8_t *src, uint8_t *dst, size_t size) const;
+
+private:
+	struct Layer {
+		Blend mode{Blend::NONE};
+		uint8_t opacity{MAX_OPACITY};
+		std::vector<uint8_t> data;
+	};
+
+	Compositor(Compositor&&) = delete;
+	Compositor(const Compositor&) = delete;
+	Compositor& operator=(Compositor&&) = delete;
+	Compositor& operator=(const Compositor&) = delete;
+
+	static void apply(uint8_t *buffer, size_t size, const Layer &layer);
+
+	const size_t max_bytes_;
+	std::array<Layer,MAX_LAYERS> layers_;
+};
+
+} // namespace aurcor
@@ -41,6 +41,22 @@
 #define AURCOR_MAX_SATURATION 100
 #define AURCOR_MAX_VALUE 100
 
+/* Result of writing a frame to the bus */
+#define AURCOR_OUTPUT_SENT 0
+#define AURCOR_OUTPUT_SKIPPED 1
+#define AURCOR_OUTPUT_QUEUED 2
+
+/* Compositor layer blend modes */
+#define AURCOR_BLEND_NONE 0
+#define AURCOR_BLEND_ADD 1
+#define AURCOR_BLEND_MULTIPLY 2
+#define AURCOR_BLEND_MAX 3
+#define AURCOR_BLEND_ALPHA 4
+
+#ifndef AURCOR_MAX_LAYERS
+# define AURCOR_MAX_LAYERS 4
+#endif
+
 #ifdef __cplusplus
 # include <cstddef>
 
@@ -0,0 +1,92 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace aurcor {
+
+/*
+ * Time an interpreter spends running (rather than waiting) in each window of
+ * real time, as a percentage.
+ *
+ * Must only be used by the interpreter's thread while it's running.
+ */
+class CPUUsage {
+public:
+	static constexpr uint64_t WINDOW_US = 1000000;
+	static constexpr unsigned int MAX_LIMIT = 100;
+
+	CPUUsage() = default;
+
+	inline unsigned int usage() const { return usage_; }
+
+	inline void start(uint64_t now_us) {
+		window_start_us_ = now_us;
+		running_since_us_ = now_us;
+		running_us_ = 0;
+		usage_ = 0;
+	}
+
+	/* Returns true if the usage has been updated */
+	inline bool update(uint64_t now_us) {
+		if (now_us > running_since_us_) {
+			running_us_ += now_us - running_since_us_;
+			running_since_us_ = now_us;
+		}
+
+		if (now_us - window_start_us_ < WINDOW_US)
+			return false;
+
+		usage_ = std::min<uint64_t>(MAX_LIMIT, running_us_ * MAX_LIMIT / (now_us - window_start_us_));
+		window_start_us_ = now_us;
+		running_us_ = 0;
+		return true;
+	}
+
+	/* The interpreter is about to wait; returns true if the usage has been updated */
+	inline bool wait(uint64_t now_us, uint64_t duration_us) {
+		bool updated = update(now_us);
+
+		running_since_us_ = std::max(running_since_us_, now_us + duration_us);
+		return updated;
+	}
+
+	/* Returns how long to wait for to stay within the limit */
+	inline uint64_t exceeded_us(uint64_t now_us, unsigned int limit) const {
+		if (limit >= MAX_LIMIT || running_us_ < WINDOW_US * limit / MAX_LIMIT)
+			return 0;
+
+		return window_start_us_ + WINDOW_US - std::min(now_us, window_start_us_ + WINDOW_US);
+	}
+
+private:
+	CPUUsage(CPUUsage&&) = delete;
+	CPUUsage(const CPUUsage&) = delete;
+	CPUUsage& operator=(CPUUsage&&) = delete;
+	CPUUsage& operator=(const CPUUsage&) = delete;
+
+	uint64_t window_start_us_{0};
+	uint64_t running_since_us_{0};
+	uint64_t running_us_{0};
+	unsigned int usage_{0};
+};
+
+} // namespace aurcor
@@ -19,13 +19,18 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <uuid/log.h>
 
+#include "app/fs.h"
 #include "app.h"
 #include "led_profiles.h"
 #include "memory_pool.h"
@@ -40,6 +45,16 @@ class Download {
 public:
 	static constexpr size_t MAX_FILE_SIZE = 64 * 1024;
 	static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+#ifdef ENV_NATIVE
+	static constexpr size_t MAX_TRANSFERS = 4;
+#else
+	static constexpr size_t MAX_TRANSFERS = 2;
+#endif
+	static constexpr const char *INDEX_FILENAME = "/download.cbor";
+	static constexpr const char *MANIFEST_FILENAME = "manifest.cbor";
+	static constexpr const char *BUNDLE_FILENAME = "bundle.cbor";
+	static constexpr size_t MIN_BUNDLE_FILES = 8;
+	static constexpr const char *TEMP_FILENAME_EXT = ".tmp";
 
 	static void init();
 
@@ -53,23 +68,59 @@ public:
 private:
 	enum class Update {
 		NO_CHANGE,
+		NOT_MODIFIED,
 		MODIFIED,
 		DELETED,
 		FAILED,
 	};
 
+	struct Type {
+		const char *description;
+		const char *directory;
+		std::function<bool(const std::string &filename)> filter;
+		std::function<void(const std::string &filename, Update result)> updated;
+	};
+
+	struct Transfer {
+		Transfer(std::string filename_, std::string url_)
+			: filename(std::move(filename_)), url(std::move(url_)) {}
+
+		std::string filename;
+		std::string url;
+		Update result{Update::FAILED};
+	};
+
+	struct FileInfo {
+		std::string etag;
+		size_t size{0};
+	};
+
 	static std::string filename_without_extension(const std::string &path, const std::string &extension);
 
 	void run();
-	void download_buses(const std::string &path);
-	void download_presets(const std::string &path);
-	void download_profiles(const std::string &path);
-	void download_scripts(const std::string &path);
+	void load_index();
+	void save_index();
+
+	void download_listing();
+	void download_type(const std::string &path, const Type &type);
+	bool download_manifest();
+	void download_bundle(std::unordered_map<std::string,std::vector<std::string>> &pending);
+	bool unchanged(const std::string &filename, size_t size, uint64_t hash);
+
+	void transfer(const std::string &path, const Type &type, uint64_t list_time_us,
+		const std::vector<std::string> &filenames);
+	void transfer_files(WebClient &client, MemoryBlock &buffer,
+		std::vector<Transfer> &transfers, std::atomic<size_t> &next);
 
 	bool bus_and_profile_from_filename(const std::string &path,
 		std::shared_ptr<LEDBus> &bus_name, enum led_profile_id &profile_id);
-	ssize_t download_to_buffer(const std::string &url);
-	Update update_file(const std::string &filename, const std::string &url);
+	ssize_t download_to_buffer(WebClient &client, MemoryBlock &buffer,
+		const std::string &url, const std::string &if_none_match);
+	Update update_file(WebClient &client, MemoryBlock &buffer,
+		const std::string &filename, const std::string &url);
+	Update store_file(const std::string &filename, const uint8_t *data, size_t len,
+		const std::string &etag);
+	static bool same_contents(fs::File &file, const uint8_t *buffer, size_t len);
 
 	static uuid::log::Logger logger_;
 
@@ -78,10 +129,15 @@ private:
 	std::thread thread_;
 	std::unique_ptr<MemoryBlock> buffer_;
 	WebClient client_;
-	uint64_t download_time_{0};
-	uint64_t update_time_{0};
+	std::atomic<uint64_t> download_time_{0};
+	std::atomic<uint64_t> update_time_{0};
 	std::unique_ptr<Refresh> changed_;
 	std::atomic<bool> done_{false};
+	std::unordered_map<std::string,Type> types_;
+
+	std::mutex index_mutex_;
+	std::unordered_map<std::string,FileInfo> index_;
+	bool index_modified_{false};
 };
 
 } // namespace aurcor
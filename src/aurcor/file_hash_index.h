@@ -0,0 +1,98 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <uuid/log.h>
+
+#include "util.h"
+
+namespace aurcor {
+
+/*
+ * Persisted index of the size and content hash of files written by the app,
+ * so that changes can be detected without reading the existing file.
+ *
+ * Callers must hold App::file_mutex() for the file when updating the index,
+ * so that it's consistent with the contents of the filesystem.
+ */
+class FileHashIndex {
+public:
+	static constexpr const char *FILENAME = "/hashes.cbor";
+
+	/* Calculates the hash of everything written through it */
+	class Writer: public Print {
+	public:
+		explicit Writer(Print &out) : out_(out) {}
+
+		size_t write(uint8_t c) override;
+		size_t write(const uint8_t *buffer, size_t size) override;
+
+		inline size_t size() const { return size_; }
+		inline uint64_t hash() const { return hash_; }
+
+	private:
+		Print &out_;
+		size_t size_{0};
+		uint64_t hash_{content_hash(nullptr, 0)};
+	};
+
+	static void load();
+	/* Returns false if the index could not be saved */
+	static bool save();
+
+	static bool matches(const std::string &filename, size_t size, uint64_t hash);
+	static bool contains(const std::string &filename);
+	static void update(const std::string &filename, size_t size, uint64_t hash);
+	static void update(const std::string &filename, const Writer &writer);
+	static void rename(const std::string &from, const std::string &to);
+	static void remove(const std::string &filename);
+	/*
+	 * Remove a file from the index and save it immediately, before the file
+	 * is replaced, so that the old hash is never used for the new content if
+	 * the index isn't saved again before a restart.
+	 *
+	 * The lock for the file must not be held because top-level files share
+	 * it with the index.
+	 */
+	static bool invalidate(const std::string &filename);
+
+private:
+	struct Entry {
+		size_t size{0};
+		uint64_t hash{0};
+	};
+
+	FileHashIndex() = delete;
+
+	static uuid::log::Logger logger_;
+
+	static std::mutex mutex_;
+	static std::unordered_map<std::string,Entry> entries_;
+	static std::atomic<bool> modified_;
+};
+
+} // namespace aurcor
@@ -0,0 +1,93 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uuid/log.h>
+
+#include "frame_recorder.h"
+#include "led_profile.h"
+#include "led_profiles.h"
+#include "pixel_map.h"
+
+namespace aurcor {
+
+class LEDBus;
+class MemoryBlock;
+class Preset;
+
+/*
+ * Plays back a frame recording in a loop with the recorded timing.
+ *
+ * Recordings of script frames have the normal profile and pixel map of the
+ * bus applied; recordings of output frames are written unmodified.
+ */
+class FramePlayer {
+public:
+	static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+
+	/* Returns true if the script name refers to a recording */
+	static bool supported(const std::string &script);
+
+	FramePlayer(std::shared_ptr<LEDBus> bus, Preset &preset, const std::string &script);
+	~FramePlayer();
+
+	inline bool running() const { return running_; }
+
+private:
+	static uuid::log::Logger logger_;
+
+	FramePlayer(FramePlayer&&) = delete;
+	FramePlayer(const FramePlayer&) = delete;
+	FramePlayer& operator=(FramePlayer&&) = delete;
+	FramePlayer& operator=(const FramePlayer&) = delete;
+
+	void run();
+	bool play(MemoryBlock &buffer);
+	/* Returns the number of bytes read or -1 on error */
+	int read(size_t offset, uint8_t *data, size_t size);
+	/* Returns false if stopped */
+	bool wait_until(uint64_t time_us);
+	void output(const std::vector<uint8_t> &frame);
+
+	const std::shared_ptr<LEDBus> bus_;
+	Preset &preset_;
+	const std::string filename_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	bool stop_{false};
+	std::atomic<bool> running_{true};
+	std::thread thread_;
+
+	FrameRecording::Stage stage_{FrameRecording::Stage::OUTPUT};
+	LEDProfile::SnapshotReader profile_snapshot_;
+	PixelMap pixel_map_;
+	std::vector<uint8_t> output_;
+};
+
+} // namespace aurcor
@@ -0,0 +1,164 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <uuid/log.h>
+
+#include "constants.h"
+#include "led_bus_format.h"
+#include "memory_pool.h"
+#include "util.h"
+
+namespace aurcor {
+
+class LEDBus;
+
+/*
+ * Recordings of frames output to a bus.
+ *
+ * The file starts with a header (magic, version, stage, bus format) followed
+ * by a record for each frame:
+ *   varint interval since the previous frame (µs)
+ *   varint frame size (bytes)
+ *   varint ops, (length << 2 | op), until the frame size is reached:
+ *     SKIP    keep bytes from the previous frame
+ *     LITERAL new bytes follow
+ *     REPEAT  copy bytes from the previous LED in this frame
+ */
+class FrameRecording {
+public:
+	static constexpr const char *DIRECTORY_NAME = "/recordings";
+	static constexpr const char *FILENAME_EXT = ".rec";
+	/* Presets with a script name using this prefix play back a recording */
+	static constexpr const char *SCRIPT_PREFIX = "recording:";
+	static constexpr size_t SCRIPT_PREFIX_LEN = std::char_traits<char>::length(SCRIPT_PREFIX);
+	static constexpr size_t MAX_NAME_LENGTH = 48;
+
+	static constexpr size_t HEADER_SIZE = 8;
+	static constexpr size_t MAX_FRAME_SIZE = MAX_LEDS * 3;
+	/* Literal runs are only interrupted by runs of at least MIN_RUN bytes */
+	static constexpr size_t MAX_RECORD_SIZE = 2 * MAX_FRAME_SIZE + 16;
+	static constexpr size_t BUFFER_SIZE = 32 * 1024;
+	static_assert(BUFFER_SIZE >= 2 * MAX_RECORD_SIZE, "Buffer must fit at least two frames");
+
+	enum class Stage : uint8_t {
+		OUTPUT = 0, /* After the profile transform */
+		SCRIPT = 1, /* Before the profile transform */
+	};
+
+	static void setup(size_t count);
+	static std::unique_ptr<MemoryBlock> allocate();
+
+	static std::vector<std::string> names();
+	static bool valid_name(const std::string &name);
+	static bool exists(const std::string &name);
+	static std::string filename(const std::string &name);
+
+	static void encode_header(uint8_t *data, Stage stage, LEDBusFormat format);
+	static bool decode_header(const uint8_t *data, Stage &stage, LEDBusFormat &format);
+
+	/* Encode a frame as a delta from the previous frame; returns the record size */
+	static size_t encode(uint32_t interval_us, const uint8_t *frame, size_t size,
+		const uint8_t *previous, size_t previous_size, uint8_t *record);
+	/* Decode a record over the previous frame; returns 0 if the record is invalid */
+	static size_t decode(const uint8_t *record, size_t available,
+		uint32_t &interval_us, std::vector<uint8_t> &frame);
+
+private:
+	enum Op : uint8_t {
+		SKIP = 0,
+		LITERAL = 1,
+		REPEAT = 2,
+	};
+
+	static constexpr uint8_t MAGIC[4] = {'A', 'U', 'R', 'F'};
+	static constexpr uint8_t VERSION = 1;
+	static constexpr size_t MIN_RUN = 4;
+	static constexpr size_t REPEAT_DISTANCE = 3;
+
+	static uint8_t *put_varint(uint8_t *pos, uint32_t value);
+	static bool get_varint(const uint8_t *&pos, const uint8_t *end, uint32_t &value);
+
+	static std::shared_ptr<MemoryPool> buffers_;
+};
+
+/*
+ * Captures frames for a bus into a memory buffer from any thread, which is
+ * written to the file from the main loop.
+ */
+class FrameRecorder {
+public:
+	static constexpr size_t FLUSH_SIZE = 4 * 1024;
+	static constexpr uint64_t FLUSH_INTERVAL_MS = 1000;
+
+	FrameRecorder(const LEDBus &bus);
+	~FrameRecorder();
+
+	Result start(const std::string &name, FrameRecording::Stage stage);
+	void stop();
+
+	inline bool recording(FrameRecording::Stage stage) const { return active_ && stage_ == stage; }
+	inline bool active() const { return active_; }
+	inline const std::string& name() const { return name_; }
+	inline FrameRecording::Stage stage() const { return stage_; }
+	inline uint32_t frames() const { return frames_; }
+	inline uint32_t dropped_frames() const { return dropped_frames_; }
+
+	void capture(const uint8_t *data, size_t size);
+	void loop();
+
+private:
+	static uuid::log::Logger logger_;
+
+	FrameRecorder(FrameRecorder&&) = delete;
+	FrameRecorder(const FrameRecorder&) = delete;
+	FrameRecorder& operator=(FrameRecorder&&) = delete;
+	FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+	bool flush(bool force);
+	void release();
+
+	const LEDBus &bus_;
+	std::atomic<bool> active_{false};
+	FrameRecording::Stage stage_{FrameRecording::Stage::OUTPUT};
+	std::string name_;
+	std::string filename_;
+	uint64_t flush_time_ms_{0};
+
+	std::mutex mutex_;
+	std::unique_ptr<MemoryBlock> buffer_;
+	size_t head_{0};
+	size_t used_{0};
+	std::vector<uint8_t> previous_;
+	std::vector<uint8_t> record_;
+	uint64_t last_us_{0};
+	std::atomic<uint32_t> frames_{0};
+	std::atomic<uint32_t> dropped_frames_{0};
+};
+
+} // namespace aurcor
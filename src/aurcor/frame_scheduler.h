@@ -0,0 +1,66 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace aurcor {
+
+/*
+ * Schedules periodic frame deadlines for a bus. Deadlines follow on from the
+ * previous deadline (not from when the previous frame was actually output) so
+ * that the frame rate doesn't drift when scripts are slow to produce frames.
+ *
+ * All times are provided by the caller so that the interpreter's clock (which
+ * may be simulated) is used.
+ */
+class FrameScheduler {
+public:
+	/*
+	 * How long before the deadline a frame can be given to the bus, so that
+	 * it's ready to be transmitted on time.
+	 */
+	static constexpr uint32_t DEFAULT_LATENCY_US = 1000;
+
+	FrameScheduler(uint32_t latency_us = DEFAULT_LATENCY_US) : latency_us_(latency_us) {}
+	~FrameScheduler() = default;
+
+	inline uint32_t latency_us() const { return latency_us_; }
+	inline uint32_t missed_deadlines() const { return missed_deadlines_; }
+
+	void reset();
+	/* Returns the deadline for the next frame (which may have passed) */
+	uint64_t deadline_us(uint32_t interval_us, uint64_t now_us) const;
+	/* Returns true if the deadline was missed */
+	bool output(uint64_t deadline_us, uint32_t interval_us, uint64_t start_us);
+
+private:
+	FrameScheduler(FrameScheduler&&) = delete;
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(FrameScheduler&&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+	const uint32_t latency_us_;
+	bool started_{false};
+	uint64_t last_deadline_us_{0};
+	std::atomic<uint32_t> missed_deadlines_{0};
+};
+
+} // namespace aurcor
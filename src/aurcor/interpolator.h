@@ -0,0 +1,120 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <uuid/log.h>
+
+namespace aurcor {
+
+class LEDBus;
+
+/*
+ * Linear interpolation from the last output frame to the most recent frame
+ * over the interval between the two most recent frames.
+ */
+class Interpolation {
+public:
+	static constexpr uint64_t MAX_INTERVAL_US = 1000000;
+
+	Interpolation(size_t max_bytes);
+	~Interpolation() = default;
+
+	void add(const uint8_t *data, size_t size, uint64_t now_us);
+	/* Returns false if the output frame is unchanged */
+	bool blend(uint64_t now_us);
+	inline bool finished() const { return finished_; }
+	inline const std::vector<uint8_t>& output() const { return output_; }
+
+private:
+	Interpolation(Interpolation&&) = delete;
+	Interpolation(const Interpolation&) = delete;
+	Interpolation& operator=(Interpolation&&) = delete;
+	Interpolation& operator=(const Interpolation&) = delete;
+
+	std::vector<uint8_t> from_;
+	std::vector<uint8_t> to_;
+	std::vector<uint8_t> output_;
+	uint64_t start_us_{0};
+	uint64_t interval_us_{0};
+	bool finished_{true};
+};
+
+/*
+ * Outputs frames at the bus default frame rate by linearly blending from the
+ * last output frame to the most recent script frame over the interval between
+ * script frames, so that scripts can run at a lower frame rate without
+ * visible steps.
+ *
+ * This delays output of script frames by one script frame interval. Frames
+ * for all of the buses in a group are output together so that they stay
+ * synchronised.
+ */
+class Interpolator {
+public:
+	static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+
+	/*
+	 * Throws std::bad_alloc or std::system_error if there's not enough
+	 * memory for the frames or the thread.
+	 */
+	Interpolator(std::shared_ptr<LEDBus> bus, std::vector<std::shared_ptr<LEDBus>> group = {});
+	~Interpolator();
+
+	/*
+	 * Frames must already have had the profile applied. The index is 0 for
+	 * the main bus, followed by the buses in the group.
+	 */
+	void add(size_t index, const uint8_t *data, size_t size, bool reverse_order);
+
+private:
+	struct Output {
+		Output(std::shared_ptr<LEDBus> bus);
+
+		const std::shared_ptr<LEDBus> bus;
+		Interpolation frames;
+		std::vector<uint8_t> frame;
+		bool changed{false};
+	};
+
+	static uuid::log::Logger logger_;
+
+	Interpolator(Interpolator&&) = delete;
+	Interpolator(const Interpolator&) = delete;
+	Interpolator& operator=(Interpolator&&) = delete;
+	Interpolator& operator=(const Interpolator&) = delete;
+
+	bool finished() const;
+	void run();
+
+	std::vector<std::unique_ptr<Output>> outputs_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	bool stop_{false};
+	std::thread thread_;
+	bool reverse_order_{false};
+};
+
+} // namespace aurcor
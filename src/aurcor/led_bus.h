@@ -22,11 +22,15 @@
 # include <Arduino.h>
 
 # include <freertos/semphr.h>
+# ifndef ENV_NATIVE
+#  include <esp_timer.h>
+# endif
 
 # include <algorithm>
 # include <array>
 # include <atomic>
 # include <memory>
+# include <mutex>
 # include <string>
 # include <string_view>
 # include <vector>
@@ -38,11 +42,14 @@ extern "C" {
 # include <uuid/log.h>
 
 # include "constants.h"
+# include "frame_recorder.h"
+# include "frame_scheduler.h"
 # include "led_bus_config.h"
 # include "led_bus_format.h"
 # include "led_bus_udp.h"
 # include "led_profile.h"
 # include "led_profiles.h"
+# include "transition.h"
 # include "util.h"
 #endif
 
@@ -55,6 +62,8 @@ public:
 	static constexpr unsigned long UPDATE_RATE_HZ = 800000;
 	static constexpr size_t RESET_TIME_US = LED_BUS_RESET_TIME_US;
 	static constexpr TickType_t SEMAPHORE_TIMEOUT_TICKS = 30 * 1000 * portTICK_PERIOD_MS;
+	static constexpr size_t MONITOR_MAX_LEDS = 64;
+	static constexpr size_t MONITOR_MAX_BYTES = MONITOR_MAX_LEDS * BYTES_PER_LED;
 
 	LEDBus(const char *name, size_t default_length = 1);
 	virtual ~LEDBus();
@@ -77,6 +86,11 @@ public:
 	inline void udp_port(uint16_t value) { config_.udp_port(value); }
 	inline unsigned int udp_queue_size() const { return config_.udp_queue_size(); }
 	inline void udp_queue_size(unsigned int value) { config_.udp_queue_size(value); }
+	inline Transition::Type transition_type() const { return config_.transition_type(); }
+	inline unsigned int transition_ms() const { return config_.transition_ms(); }
+	inline void transition(Transition::Type type, unsigned int duration_ms) { config_.transition(type, duration_ms); }
+	inline unsigned int cpu_limit() const { return config_.cpu_limit(); }
+	inline void cpu_limit(unsigned int value) { config_.cpu_limit(value); }
 	inline void reload_config() { config_.reload(); }
 
 	inline LEDProfile& profile(enum led_profile_id id) { return profiles_.get(id); }
@@ -84,10 +98,25 @@ public:
 	inline Result load_profile(enum led_profile_id id) { return profiles_.load(id); }
 	inline bool profile_loaded(enum led_profile_id id) { return profiles_.loaded(id); }
 	inline Result save_profile(enum led_profile_id id) { return profiles_.save(id); }
+	inline uint32_t profile_load_time_us(enum led_profile_id id) const { return profiles_.load_time_us(id); }
 
 	inline uint64_t last_update_us() const { return last_update_us_; }
+	inline uint32_t frames() const { return frames_; }
+	inline uint32_t skipped_frames() const { return skipped_frames_; }
+	inline void skip_frame() { skipped_frames_++; }
+	inline FrameScheduler& scheduler() { return scheduler_; }
+	inline uint32_t missed_deadlines() const { return scheduler_.missed_deadlines(); }
+	inline uint32_t frame_interval_us() const { return frame_interval_us_; }
+	inline uint32_t max_frame_interval_us(bool reset) { return reset ? max_frame_interval_us_.exchange(0) : max_frame_interval_us_.load(); }
+	inline void monitor(bool enabled) { monitor_ = enabled; }
+	inline FrameRecorder& recorder() { return recorder_; }
+	inline Transition& transition() { return transition_; }
+	/* Percentage of time that the script on this bus has spent running */
+	inline unsigned int cpu_usage() const { return cpu_usage_; }
+	inline void cpu_usage(unsigned int value) { cpu_usage_ = value; }
+	size_t monitor_frame(std::array<uint8_t,MONITOR_MAX_BYTES> &buffer); /* Returns number of LEDs */
 	bool ready() const;
-	void write(const uint8_t *data, size_t size, bool reverse_order); /* data is in RGB order */
+	bool write(const uint8_t *data, size_t size, bool reverse_order, bool wait = true, uint64_t start_us = 0); /* data is in RGB order */
 	void clear();
 
 	void loop();
@@ -98,6 +127,13 @@ public:
 
 protected:
 	virtual void start(const uint8_t *data, size_t size, bool reverse_order) = 0;
+	/*
+	 * Transmission is started by calling tx_start() when the requested start
+	 * time has been reached and the reset time after the previous
+	 * transmission (tx_delay_us) has elapsed.
+	 */
+	void schedule_tx(uint32_t tx_delay_us);
+	virtual void tx_start() {}
 	void finish();
 	IRAM_ATTR void finish_isr();
 
@@ -109,13 +145,37 @@ private:
 	LEDBus& operator=(LEDBus&&) = delete;
 	LEDBus& operator=(const LEDBus&) = delete;
 
+	void monitor_capture(const uint8_t *data, size_t size);
+#ifndef ENV_NATIVE
+	static void tx_timer_callback(void *arg);
+#endif
+
 	const char *name_;
 	SemaphoreHandle_t semaphore_{nullptr};
+#ifndef ENV_NATIVE
+	esp_timer_handle_t tx_timer_{nullptr};
+#endif
 	std::atomic<bool> busy_{false};
+	uint64_t tx_start_us_{0};
+	uint64_t next_tx_start_us_{0};
+	uint32_t next_tx_delay_us_{0};
+	FrameScheduler scheduler_;
 	uint64_t last_update_us_{0};
+	std::atomic<uint32_t> frames_{0};
+	std::atomic<uint32_t> skipped_frames_{0};
+	std::atomic<uint32_t> frame_interval_us_{0};
+	std::atomic<uint32_t> max_frame_interval_us_{0};
+	std::atomic<unsigned int> cpu_usage_{0};
+
+	std::atomic<bool> monitor_{false};
+	std::mutex monitor_mutex_;
+	std::array<uint8_t,MONITOR_MAX_BYTES> monitor_frame_{};
+	size_t monitor_length_{0};
 	mutable LEDBusConfig config_;
 	mutable LEDProfiles profiles_;
 	LEDBusUDP udp_{*this};
+	FrameRecorder recorder_{*this};
+	Transition transition_;
 };
 
 class NullLEDBus: public LEDBus, public std::enable_shared_from_this<NullLEDBus> {
@@ -35,6 +35,8 @@
 #include "constants.h"
 #include "led_bus_format.h"
 #include "led_bus_udp.h"
+#include "snapshot.h"
+#include "transition.h"
 
 namespace aurcor {
 
@@ -43,6 +45,8 @@ public:
 	static constexpr LEDBusFormat DEFAULT_FORMAT = LEDBusFormat::RGB;
 	static constexpr uint16_t DEFAULT_RESET_TIME_US = LED_BUS_RESET_TIME_US;
 	static constexpr uint16_t DEFAULT_DEFAULT_FPS = 50;
+	static constexpr unsigned int MAX_CPU_LIMIT = 100;
+	static constexpr unsigned int DEFAULT_CPU_LIMIT = MAX_CPU_LIMIT;
 
 	static constexpr const char *DIRECTORY_NAME = "/buses";
 	static constexpr const char *FILENAME_EXT = ".cbor";
@@ -74,6 +78,13 @@ public:
 	unsigned int udp_queue_size() const;
 	void udp_queue_size(unsigned int value);
 
+	Transition::Type transition_type() const;
+	unsigned int transition_ms() const;
+	void transition(Transition::Type type, unsigned int duration_ms);
+
+	unsigned int cpu_limit() const;
+	void cpu_limit(unsigned int value);
+
 	void reset();
 	inline void reload() { load(); }
 
@@ -82,14 +93,26 @@ protected:
 	void reset_time_us_constrained(unsigned int value);
 	void default_fps_constrained(unsigned int value);
 	void udp_queue_size_constrained(unsigned int value);
+	void transition_ms_constrained(unsigned int value);
+	void cpu_limit_constrained(unsigned int value);
 
 	bool load();
 	bool save();
 
 private:
+	/* Configuration used for every frame, readable without locking */
+	struct Snapshot {
+		uint16_t length;
+		uint16_t reset_time_us;
+		LEDBusFormat format;
+		bool reverse;
+	};
+	static_assert(MAX_LEDS <= UINT16_MAX, "Length must fit in snapshot");
+
 	static std::string make_filename(const char *bus_name);
 
 	void reset_locked();
+	void publish_locked();
 
 	bool load(qindesign::cbor::Reader &reader);
 	void save(qindesign::cbor::Writer &writer);
@@ -106,13 +129,19 @@ private:
 	uint16_t default_fps_{DEFAULT_DEFAULT_FPS};
 	uint16_t udp_port_{0};
 	unsigned int udp_queue_size_{LEDBusUDP::DEFAULT_QUEUE_SIZE};
+	Transition::Type transition_type_{Transition::DEFAULT_TYPE};
+	unsigned int transition_ms_{Transition::DEFAULT_DURATION_MS};
+	unsigned int cpu_limit_{DEFAULT_CPU_LIMIT};
 	bool length_set_{false};
 	bool format_set_{false};
 	bool reset_time_us_set_{false};
 	bool default_fps_set_{false};
 	bool udp_port_set_{false};
 	bool udp_queue_size_set_{false};
+	bool transition_ms_set_{false};
+	bool cpu_limit_set_{false};
 	bool reverse_{false};
+	SeqLock<Snapshot> snapshot_;
 };
 
 } // namespace aurcor
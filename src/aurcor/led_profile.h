@@ -23,6 +23,8 @@
 #include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <CBOR.h>
 #include <CBOR_parsing.h>
@@ -33,6 +35,7 @@
 
 #include "constants.h"
 #include "led_bus_format.h"
+#include "snapshot.h"
 #include "util.h"
 
 namespace aurcor {
@@ -54,12 +57,18 @@ public:
 	static constexpr const char *DIRECTORY_NAME = "/profiles";
 	static constexpr const char *FILENAME_EXT = ".cbor";
 
+	class Snapshot;
+	using SnapshotReader = Published<Snapshot>::Reader;
+
 	LEDProfile() = default;
 	~LEDProfile() = default;
 
 	void print(uuid::console::Shell &shell, size_t limit = MAX_LEDS) const;
 	void transform(uint8_t *data, size_t size, LEDBusFormat format) const;
 
+	/* Current ratios, without locking unless the profile has been modified */
+	inline const Snapshot& snapshot(SnapshotReader &reader) const { return reader.get(snapshot_); }
+
 	std::vector<unsigned int> indexes() const;
 	Result get(unsigned int index, uint8_t &r, uint8_t &g, uint8_t &b) const;
 	Result set(unsigned int index, int r, int g, int b);
@@ -155,15 +164,43 @@ private:
 
 	void save(qindesign::cbor::Writer &writer, index_t index, const Ratio &ratio);
 
-	template <int R_IDX,int G_IDX, int B_IDX>
-	void transform(uint8_t *data, size_t size) const;
+	void publish_locked();
 
 	static uuid::log::Logger logger_;
 
 	mutable std::shared_mutex data_mutex_;
 	std::map<index_t,Ratio> ratios_;
+	Published<Snapshot> snapshot_;
 
 	bool modified_{false};
 };
 
+/* Immutable copy of a profile's ratios, used to transform each frame */
+class LEDProfile::Snapshot {
+	friend LEDProfile;
+public:
+	Snapshot() = default;
+	~Snapshot() = default;
+
+	void transform(uint8_t *data, size_t size, LEDBusFormat format) const;
+	/* Transform into a separate buffer, leaving the source unmodified */
+	void transform(const uint8_t *src, uint8_t *dst, size_t size, LEDBusFormat format) const;
+	/*
+	 * Transform while reordering the LEDs, with the source LED index for
+	 * each output LED provided by a lookup table. Output LEDs with an out of
+	 * range source index are turned off.
+	 */
+	void transform(const uint8_t *src, size_t src_size, uint8_t *dst,
+		const index_t *lut, size_t length, LEDBusFormat format) const;
+
+private:
+	template <int R_IDX,int G_IDX, int B_IDX>
+	void transform(const uint8_t *src, uint8_t *dst, size_t size) const;
+	template <int R_IDX,int G_IDX, int B_IDX>
+	void transform(const uint8_t *src, size_t src_size, uint8_t *dst,
+		const index_t *lut, size_t length) const;
+
+	std::vector<std::pair<index_t,Ratio>> ratios_;
+};
+
 } // namespace aurcor
@@ -42,6 +42,7 @@ LED_PROFILES
 # include <Arduino.h>
 
 # include <array>
+# include <atomic>
 # include <bitset>
 # include <mutex>
 # include <vector>
@@ -73,6 +74,7 @@ public:
 	Result load(enum led_profile_id id);
 	bool loaded(enum led_profile_id id);
 	Result save(enum led_profile_id id);
+	inline uint32_t load_time_us(enum led_profile_id id) const { return load_time_us_[(size_t)id]; }
 
 private:
 	static const std::array<const char *,NUM_LED_PROFILES> lc_names_;
@@ -83,6 +85,8 @@ private:
 	std::mutex mutex_;
 	std::array<LEDProfile,NUM_LED_PROFILES> profiles_;
 	std::bitset<NUM_LED_PROFILES> loaded_{};
+	std::array<std::atomic<bool>,NUM_LED_PROFILES> available_{};
+	std::array<std::atomic<uint32_t>,NUM_LED_PROFILES> load_time_us_{};
 };
 
 class BusLEDProfileHash {
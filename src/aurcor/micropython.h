@@ -21,9 +21,11 @@
 #include <Arduino.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <csetjmp>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -41,6 +43,8 @@ extern "C" {
 #include <uuid/console.h>
 #include <uuid/log.h>
 
+#include "clock.h"
+#include "cpu_usage.h"
 #include "io_buffer.h"
 #include "memory_pool.h"
 #include "modaurcor.h"
@@ -105,6 +109,9 @@ public:
 	static_assert(TASK_STACK_LIMIT < TASK_STACK_SIZE, "Task stack limit must be lower than task stack size");
 	static_assert(TASK_STACK_LIMIT < TASK_EXC_STACK_LIMIT, "Task stack limit must be lower than task exception stack limit");
 
+	/* Additional heaps so that the next script can be prepared while the previous one stops */
+	static constexpr size_t SPARE_COUNT = 1;
+
 	static constexpr const char *DIRECTORY_NAME = "/scripts";
 	static constexpr const char *FILENAME_EXT = ".mpy";
 	static constexpr size_t FILENAME_EXT_LEN = std::char_traits<char>::length(FILENAME_EXT);
@@ -112,9 +119,17 @@ public:
 	static void setup(size_t pool_count);
 	static std::string script_filename(const char *path);
 	static bool builtin_filename(const char *path);
+#ifdef ENV_NATIVE
+	/* Applies to interpreters created after it is changed */
+	static inline bool simulated_clock() { return simulated_clock_; }
+	static inline void simulated_clock(bool simulated) { simulated_clock_ = simulated; }
+#endif
 
 	virtual const char* type() const = 0;
 	const std::string& name() const { return name_; }
+	const std::shared_ptr<LEDBus>& bus() const { return bus_; }
+	/* Continue running in the background, providing frames for a transition */
+	bool outgoing();
 	bool stop();
 
 	virtual ~MicroPython() = default;
@@ -137,14 +152,20 @@ protected:
 
 	static uuid::log::Logger logger_;
 
-	MicroPython(const std::string &name, std::shared_ptr<LEDBus> bus, std::shared_ptr<Preset> preset);
+	MicroPython(const std::string &name, std::shared_ptr<LEDBus> bus, std::shared_ptr<Preset> preset,
+		std::vector<std::shared_ptr<LEDBus>> group = {});
 
 	bool start();
+	/* Start the interpreter but wait for release() before running the script */
+	bool prepare();
+	bool release();
+	bool wait_released();
 	virtual void main();
 	virtual void shutdown();
 	virtual void cleanup();
 
 	inline bool memory_blocks_available() const { return heap_ && pystack_ && ledbufs_; }
+	inline Clock& clock() { return clock_; }
 	inline bool running() const { return running_; }
 	inline bool stopping() const { return stopping_; }
 
@@ -169,6 +190,9 @@ protected:
 	virtual uuid::log::Level modulogging_effective_level();
 	virtual std::unique_ptr<aurcor::micropython::Print> modulogging_print(uuid::log::Level level);
 
+	/* Called on the interpreter thread after the script has output a frame */
+	virtual void frame_written() {}
+
 	const std::string name_;
 	std::shared_ptr<LEDBus> bus_;
 
@@ -179,6 +203,9 @@ private:
 	static std::shared_ptr<MemoryPool> heaps_;
 	static std::shared_ptr<MemoryPool> pystacks_;
 	static std::shared_ptr<MemoryPool> ledbufs_;
+#ifdef ENV_NATIVE
+	static std::atomic<bool> simulated_clock_;
+#endif
 
 	MicroPython(MicroPython&&) = delete;
 	MicroPython(const MicroPython&) = delete;
@@ -196,11 +223,23 @@ private:
 	friend void ::mp_hal_end_atomic_section(void);
 	void mp_hal_end_atomic_section();
 
+	friend uint64_t ::mp_hal_clock_us(void);
+	friend int ::mp_hal_clock_delay_us(uint64_t us);
+	friend void ::mp_hal_clock_timeofday(struct timeval *tv);
+
+	friend void ::mp_hal_vm_hook(void);
+	void vm_hook();
+	void cpu_updated();
+
 	std::unique_ptr<MemoryBlock> heap_;
 	std::unique_ptr<MemoryBlock> pystack_;
 	std::unique_ptr<MemoryBlock> ledbuf_;
 	std::thread thread_;
 	bool started_{false};
+	std::mutex release_mutex_;
+	std::condition_variable release_cv_;
+	std::atomic<bool> held_{false};
+	std::atomic<bool> outgoing_{false};
 	std::mutex active_;
 	std::atomic<bool> running_{false};
 	bool stopping_{false};
@@ -219,6 +258,9 @@ private:
 	std::mutex atomic_section_mutex_;
 
 	std::shared_ptr<Preset> preset_;
+	Clock clock_;
+	CPUUsage cpu_;
+	unsigned int cpu_limit_{CPUUsage::MAX_LIMIT};
 	micropython::PyModule modaurcor_;
 	micropython::ULogging modulogging_;
 };
@@ -265,7 +307,8 @@ class MicroPythonFile final: public MicroPython,
 public:
 	static constexpr size_t MAX_NAME_LENGTH = 48;
 
-	MicroPythonFile(const std::string &name, std::shared_ptr<LEDBus> bus, std::shared_ptr<Preset> preset);
+	MicroPythonFile(const std::string &name, std::shared_ptr<LEDBus> bus, std::shared_ptr<Preset> preset,
+		std::vector<std::shared_ptr<LEDBus>> group = {});
 	~MicroPythonFile() override;
 
 	static std::vector<std::string> scripts();
@@ -274,6 +317,8 @@ public:
 	const char* type() const override { return "MicroPythonFile"; }
 
 	using MicroPython::start;
+	using MicroPython::prepare;
+	using MicroPython::release;
 	using MicroPython::running;
 
 protected:
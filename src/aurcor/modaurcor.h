@@ -62,12 +62,24 @@ mp_obj_t aurcor_rgb_to_exp_hsv_tuple(size_t n_args, const mp_obj_t *args);
 MP_DECLARE_CONST_FUN_OBJ_VAR_BETWEEN(aurcor_rgb_to_exp_hsv_tuple_obj);
 
 
-mp_obj_t aurcor_length(void);
-MP_DECLARE_CONST_FUN_OBJ_0(aurcor_length_obj);
+mp_obj_t aurcor_length(size_t n_args, const mp_obj_t *args);
+MP_DECLARE_CONST_FUN_OBJ_VAR_BETWEEN(aurcor_length_obj);
+
+mp_obj_t aurcor_buses(void);
+MP_DECLARE_CONST_FUN_OBJ_0(aurcor_buses_obj);
 
 mp_obj_t aurcor_default_fps(void);
 MP_DECLARE_CONST_FUN_OBJ_0(aurcor_default_fps_obj);
 
+mp_obj_t aurcor_width(void);
+MP_DECLARE_CONST_FUN_OBJ_0(aurcor_width_obj);
+
+mp_obj_t aurcor_height(void);
+MP_DECLARE_CONST_FUN_OBJ_0(aurcor_height_obj);
+
+mp_obj_t aurcor_xy(mp_obj_t x, mp_obj_t y);
+MP_DECLARE_CONST_FUN_OBJ_2(aurcor_xy_obj);
+
 mp_obj_t aurcor_register_config(mp_obj_t dict);
 MP_DECLARE_CONST_FUN_OBJ_1(aurcor_register_config_obj);
 
@@ -88,9 +100,22 @@ mp_obj_t aurcor_output_defaults(size_t n_args, const mp_obj_t *args, mp_map_t *k
 MP_DECLARE_CONST_FUN_OBJ_KW(aurcor_output_defaults_obj);
 
 
+mp_obj_t aurcor_frame(void);
+MP_DECLARE_CONST_FUN_OBJ_0(aurcor_frame_obj);
+
+mp_obj_t aurcor_show(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
+MP_DECLARE_CONST_FUN_OBJ_KW(aurcor_show_obj);
+
+mp_obj_t aurcor_layer(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
+MP_DECLARE_CONST_FUN_OBJ_KW(aurcor_layer_obj);
+
+
 mp_obj_t aurcor_next_ticks30_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 MP_DECLARE_CONST_FUN_OBJ_KW(aurcor_next_ticks30_ms_obj);
 
+mp_obj_t aurcor_next_ticks30_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
+MP_DECLARE_CONST_FUN_OBJ_KW(aurcor_next_ticks30_us_obj);
+
 mp_obj_t aurcor_next_ticks64_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 MP_DECLARE_CONST_FUN_OBJ_KW(aurcor_next_ticks64_ms_obj);
 
@@ -128,15 +153,23 @@ MP_DECLARE_CONST_FUN_OBJ_KW(aurcor_udp_receive_obj);
 
 # include "led_bus.h"
 # include "led_bus_format.h"
+# include "led_profile.h"
 # include "led_profiles.h"
 
+# include <array>
+# include <atomic>
 # include <memory>
 # include <limits>
+# include <vector>
 #endif
 
 namespace aurcor {
 
+class Clock;
+class Compositor;
+class Interpolator;
 class MemoryBlock;
+class PixelMap;
 class Preset;
 
 namespace micropython {
@@ -174,15 +207,25 @@ public:
 
 	static mp_obj_t rgb_to_hsv_tuple(size_t n_args, const mp_obj_t *args, bool exp);
 
-	PyModule(MemoryBlock *led_buffer, std::shared_ptr<LEDBus> bus, Preset &preset);
+	PyModule(MemoryBlock *led_buffer, std::shared_ptr<LEDBus> bus,
+		std::vector<std::shared_ptr<LEDBus>> group, Preset &preset, Clock &clock);
+	~PyModule();
 
-	mp_obj_t length();
+	mp_obj_t length(size_t n_args, const mp_obj_t *args);
+	mp_obj_t buses();
 	mp_obj_t default_fps();
+	mp_obj_t width();
+	mp_obj_t height();
+	mp_obj_t xy(mp_obj_t x_obj, mp_obj_t y_obj);
 	mp_obj_t register_config(mp_obj_t dict);
 	mp_obj_t config(mp_obj_t dict);
 	mp_obj_t output_leds(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs, OutputType type, bool set_defaults);
+	mp_obj_t frame();
+	mp_obj_t show(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
+	mp_obj_t layer(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 
 	mp_obj_t next_ticks30_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
+	mp_obj_t next_ticks30_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	mp_obj_t next_ticks64_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	mp_obj_t next_ticks64_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	mp_obj_t next_time(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
@@ -191,8 +234,10 @@ public:
 
 	mp_obj_t udp_receive(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 
+	/* Frames are only provided to the bus's transition from now on */
+	inline void outgoing() { outgoing_ = true; }
+
 private:
-	static constexpr size_t TIMING_DELAY_US = 10;
 	static constexpr enum led_profile_id DEFAULT_PROFILE = LED_PROFILE_NORMAL;
 	static constexpr mp_int_t MAX_WAIT_MS = 1000;
 	static constexpr mp_int_t MAX_WAIT_US = MAX_WAIT_MS * 1000;
@@ -211,14 +256,31 @@ private:
 	static_assert(EXPANDED_HUE_TIMES > 1, "Invalid expanded hue times");
 	static_assert(EXPANDED_HUE_SIZE == (EXPANDED_HUE_SIZE % HUE_RANGE), "Invalid expanded hue size");
 
+	/* Another bus in the preset's group, with the next frame to be output */
+	struct GroupMember {
+		GroupMember(std::shared_ptr<LEDBus> bus) : bus(std::move(bus)) {
+			frame.reserve(LEDBus::MAX_BYTES);
+		}
+
+		std::shared_ptr<LEDBus> bus;
+		std::array<LEDProfile::SnapshotReader,NUM_LED_PROFILES> profile_snapshots;
+		std::vector<uint8_t> frame;
+		bool pending{false};
+	};
+
 	static constexpr bool HSV_TO_RGB_USE_FLOAT = false;
 	static constexpr bool RGB_TO_HSV_USE_FLOAT = false;
 
-	friend mp_obj_t ::aurcor_length();
+	friend mp_obj_t ::aurcor_length(size_t n_args, const mp_obj_t *args);
+	friend mp_obj_t ::aurcor_buses();
 	friend mp_obj_t ::aurcor_default_fps();
+	friend mp_obj_t ::aurcor_width();
+	friend mp_obj_t ::aurcor_height();
+	friend mp_obj_t ::aurcor_xy(mp_obj_t x, mp_obj_t y);
 	friend mp_obj_t ::aurcor_register_config(mp_obj_t dict);
 	friend mp_obj_t ::aurcor_config(mp_obj_t dict);
 	friend mp_obj_t ::aurcor_next_ticks30_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
+	friend mp_obj_t ::aurcor_next_ticks30_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	friend mp_obj_t ::aurcor_next_ticks64_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	friend mp_obj_t ::aurcor_next_ticks64_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	friend mp_obj_t ::aurcor_next_time(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
@@ -228,6 +290,9 @@ private:
 	friend mp_obj_t ::aurcor_output_hsv(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	friend mp_obj_t ::aurcor_output_exp_hsv(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	friend mp_obj_t ::aurcor_output_defaults(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
+	friend mp_obj_t ::aurcor_frame();
+	friend mp_obj_t ::aurcor_show(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
+	friend mp_obj_t ::aurcor_layer(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	friend mp_obj_t ::aurcor_udp_receive(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 	static PyModule& current();
 
@@ -236,25 +301,52 @@ private:
 	static mp_int_t saturation_obj_to_int(mp_obj_t saturation);
 	static mp_int_t value_obj_to_int(mp_obj_t value);
 
+	static enum led_profile_id profile_obj_to_id(mp_obj_t profile);
 	long calc_wait_us(mp_obj_t fps_obj, mp_obj_t wait_ms_obj, mp_obj_t wait_us_obj, bool set_defaults);
+	const FrameScheduler& scheduler() const;
+	uint32_t frame_interval_us(long wait_us) const;
+	uint64_t frame_deadline_us(long wait_us, uint64_t now_us) const;
+	bool frame_ready(long wait_us) const;
+	bool group_ready() const;
+	void skip_frame();
+	size_t led_count() const;
+	size_t frame_bytes() const;
+	size_t group_index(mp_int_t index) const;
+	mp_int_t write_leds(uint8_t *buffer, size_t out_bytes, enum led_profile_id profile, long wait_us, bool block);
+	mp_int_t write_outgoing(uint8_t *buffer, size_t out_bytes, long wait_us);
+	uint32_t default_interval_us() const;
+	mp_int_t stage_leds(size_t index, const uint8_t *buffer, size_t out_bytes, enum led_profile_id profile);
+	bool write_group(bool block, uint64_t start_us);
 	void next_wait_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs,
-		uint64_t &now_us, uint64_t &start_us);
+		uint64_t &now_us, uint64_t &start_us, mp_int_t &mod);
+	static mp_obj_t int_mod(int64_t value, mp_int_t mod);
 	void next_timeofday(struct timeval &tv, uint64_t offset_us);
+	uint32_t latency_us() const;
 
 	MemoryBlock *led_buffer_;
 	std::shared_ptr<LEDBus> bus_;
+	std::vector<std::unique_ptr<GroupMember>> group_;
 	size_t bus_length_;
 	LEDBusFormat bus_format_;
 	unsigned int bus_default_fps_;
 	Preset &preset_;
+	Clock &clock_;
+	std::unique_ptr<PixelMap> pixel_map_;
+	std::vector<uint8_t> map_buffer_;
+	std::vector<uint8_t> output_buffer_;
 
 	enum led_profile_id profile_{DEFAULT_PROFILE};
+	std::array<LEDProfile::SnapshotReader,NUM_LED_PROFILES> profile_snapshots_;
 	long wait_us_{DEFAULT_WAIT_US};
 	bool repeat_{DEFAULT_REPEAT};
 	bool reverse_{DEFAULT_REVERSE};
 
-	bool bus_written_{false};
 	bool config_used_{false};
+	std::unique_ptr<Compositor> compositor_;
+	std::unique_ptr<Interpolator> interpolator_;
+	bool interpolator_failed_{false};
+	std::atomic<bool> outgoing_{false};
+	FrameScheduler outgoing_scheduler_;
 };
 
 } // namespace micropython
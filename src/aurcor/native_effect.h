@@ -0,0 +1,159 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uuid/log.h>
+
+#include "led_profile.h"
+#include "led_profiles.h"
+#include "pixel_map.h"
+#include "script_config.h"
+
+namespace aurcor {
+
+class LEDBus;
+class Preset;
+
+/*
+ * Renders the simple built-in scripts natively, reading the same config
+ * keys, so that they don't need a MicroPython heap or interpreter.
+ *
+ * The sweep and twinkle overlays are not implemented; the effect stops if
+ * either of them is enabled so that the preset can run the script instead.
+ */
+class NativeEffect {
+public:
+	/* Renders frames for a supported script from its config */
+	class Renderer {
+	public:
+		/* Returns true if the script can be rendered natively with this config */
+		static bool supported(const std::string &script, const ScriptConfig &config);
+
+		/* The script must be one of the built-in scripts */
+		Renderer(const std::string &script);
+		~Renderer() = default;
+
+		inline const char *script() const { return effect_.script; }
+		/* The config needs the script to be run instead */
+		inline bool fallback() const { return fallback_; }
+		inline enum led_profile_id profile() const { return profile_; }
+		inline bool real_time() const { return real_time_; }
+
+		void register_config(ScriptConfig &config) const;
+		void read_config(const ScriptConfig &config);
+		void render(uint8_t *buffer, size_t length, uint64_t now_us);
+
+	private:
+		enum class Type : uint8_t {
+			STATIC_RGB,
+			HUE_FADE,
+			HUE_SCROLL,
+			BURST_RGB,
+		};
+
+		struct Effect {
+			const char *script;
+			Type type;
+			bool sweep;
+			bool twinkle;
+		};
+
+		/* 1x speed = 5s duration for 1 burst on 200 LEDs */
+		static constexpr uint64_t BURST_DURATION_PER_LED_US = 18727;
+
+		Renderer(Renderer&&) = delete;
+		Renderer(const Renderer&) = delete;
+		Renderer& operator=(Renderer&&) = delete;
+		Renderer& operator=(const Renderer&) = delete;
+
+		static const Effect* find(const std::string &script);
+
+		void render_static(uint8_t *buffer, size_t length) const;
+		void render_hue_fade(uint8_t *buffer, size_t length, uint64_t time_ms) const;
+		void render_hue_scroll(uint8_t *buffer, size_t length, uint64_t time_ms) const;
+		void render_burst(uint8_t *buffer, size_t length, uint64_t time_us);
+
+		const Effect &effect_;
+
+		/* Config values */
+		bool fallback_{false};
+		std::vector<int32_t> colours_{0};
+		enum led_profile_id profile_{LED_PROFILE_NORMAL};
+		int32_t duration_{25000};
+		bool has_duration_{true};
+		bool real_time_{false};
+		float repeat_{1};
+		int32_t number_{3};
+		float fade_rate1_{0.5};
+		float fade_rateN_{0.75};
+		float speed_{1};
+
+		/* Burst colours (HSV) and fade multipliers derived from the config */
+		std::vector<std::array<int32_t,3>> burst_colours_;
+		std::vector<float> burst_fades_;
+	};
+
+	static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+
+	/* Returns true if the script can be run natively with this config */
+	static inline bool supported(const std::string &script, const ScriptConfig &config) {
+		return Renderer::supported(script, config);
+	}
+
+	NativeEffect(std::shared_ptr<LEDBus> bus, Preset &preset, const std::string &script);
+	~NativeEffect();
+
+	inline bool running() const { return running_; }
+
+private:
+	static uuid::log::Logger logger_;
+
+	NativeEffect(NativeEffect&&) = delete;
+	NativeEffect(const NativeEffect&) = delete;
+	NativeEffect& operator=(NativeEffect&&) = delete;
+	NativeEffect& operator=(const NativeEffect&) = delete;
+
+	static uint64_t real_time_us();
+
+	void run();
+
+	const std::shared_ptr<LEDBus> bus_;
+	Preset &preset_;
+	Renderer renderer_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	bool stop_{false};
+	std::atomic<bool> running_{true};
+	std::thread thread_;
+
+	std::array<LEDProfile::SnapshotReader,NUM_LED_PROFILES> profile_snapshots_;
+	PixelMap pixel_map_;
+};
+
+} // namespace aurcor
@@ -0,0 +1,106 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+
+#include <uuid/log.h>
+
+#include "constants.h"
+#include "util.h"
+
+namespace aurcor {
+
+/*
+ * Maps the logical LED positions that scripts render to the physical LED
+ * positions on the bus. The mapping is compiled to a lookup table of the
+ * logical index for each physical LED so that it can be applied in the same
+ * pass as the profile transform.
+ *
+ * Logical positions are numbered by row (y * width + x). The matrix is
+ * converted to strip order (optionally by column and/or serpentine) and then
+ * split across segments of the physical bus.
+ */
+class PixelMap {
+public:
+	using index_t = uint16_t;
+	static constexpr index_t UNMAPPED = std::numeric_limits<index_t>::max();
+	static_assert(UNMAPPED >= MAX_LEDS, "Index type is too small to cover all LEDs");
+
+	/* Kept separate from profiles so that they can't clash with a profile name */
+	static constexpr const char *DIRECTORY_NAME = "/maps";
+	static constexpr const char *FILENAME_EXT = ".cbor";
+
+	struct Segment {
+		index_t offset;
+		index_t length;
+		bool reverse;
+	};
+
+	PixelMap() = default;
+	~PixelMap() = default;
+
+	/* Returns Result::NOT_FOUND if there is no mapping for the bus */
+	Result load(const char *bus_name);
+	Result compile(size_t width, size_t height, bool vertical, bool serpentine,
+		const std::vector<Segment> &segments);
+	void clear();
+
+	inline bool empty() const { return lut_.empty(); }
+	inline size_t width() const { return width_; }
+	inline size_t height() const { return height_; }
+	/* Number of logical LEDs */
+	inline size_t length() const { return width_ * height_; }
+	/* Logical index for each physical LED */
+	inline const std::vector<index_t>& lut() const { return lut_; }
+
+private:
+#ifdef ENV_NATIVE
+	static constexpr bool VERBOSE = true;
+#else
+	static constexpr bool VERBOSE = false;
+#endif
+
+	PixelMap(PixelMap&&) = delete;
+	PixelMap(const PixelMap&) = delete;
+	PixelMap& operator=(PixelMap&&) = delete;
+	PixelMap& operator=(const PixelMap&) = delete;
+
+	static std::string make_filename(const char *bus_name);
+
+	Result load(qindesign::cbor::Reader &reader);
+	static Result load_segments(qindesign::cbor::Reader &reader, std::vector<Segment> &segments);
+	static Result load_segment(qindesign::cbor::Reader &reader, Segment &segment);
+
+	static uuid::log::Logger logger_;
+
+	size_t width_{0};
+	size_t height_{0};
+	std::vector<index_t> lut_;
+};
+
+} // namespace aurcor
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <bitset>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <shared_mutex>
@@ -45,8 +46,10 @@ extern "C" {
 
 namespace aurcor {
 
+class FramePlayer;
 class LEDBus;
 class MicroPythonFile;
+class NativeEffect;
 
 class Preset: public std::enable_shared_from_this<Preset> {
 public:
@@ -57,7 +60,7 @@ public:
 	static constexpr const char *FILENAME_EXT = ".cbor";
 
 	Preset(App &app, std::shared_ptr<LEDBus> bus, std::string name = "");
-	~Preset() = default;
+	~Preset();
 
 	static std::vector<std::string> names();
 
@@ -73,8 +76,18 @@ public:
 	bool reverse() const;
 	void reverse(bool reverse);
 
+	bool interpolate() const;
+	void interpolate(bool interpolate);
+
+	/* Names of other buses that are driven by the same script */
+	std::vector<std::string> group() const;
+	void group(std::vector<std::string> group);
+
 	void register_config(mp_obj_t dict);
 	bool populate_config(mp_obj_t dict);
+	/* Native equivalents for built-in effects */
+	void register_config(const std::function<void(ScriptConfig&)> &func);
+	bool populate_config(const std::function<void(const ScriptConfig&)> &func);
 
 	std::vector<std::string> config_keys(std::bitset<ScriptConfig::Type::INVALID> types = std::numeric_limits<unsigned long>::max()) const;
 	ScriptConfig::Type config_key_type(const std::string &key) const;
@@ -85,6 +98,7 @@ public:
 	Result del_config(const std::string &key, const std::string &value);
 	Result del_config(const std::string &key, size_t index);
 	Result set_config(const std::string &key, const std::string &value);
+	Result check_config(const std::string &key, const std::string &value) const;
 	Result set_config(const std::string &key, const std::string &value, size_t position);
 	Result unset_config(const std::string &key);
 	bool print_config(uuid::console::Shell &shell, const std::string *filter_key = nullptr) const;
@@ -127,6 +141,8 @@ private:
 
 	std::string make_filename() const;
 	bool restart() const;
+	void prepare_script();
+	bool native_effect_supported() const;
 
 	Result config_modified(Result result);
 	void reset();
@@ -136,6 +152,11 @@ private:
 	App &app_;
 	std::shared_ptr<LEDBus> bus_;
 	std::shared_ptr<MicroPythonFile> mp_;
+	std::shared_ptr<MicroPythonFile> next_mp_;
+	std::string next_script_;
+	uint64_t switch_time_ms_{0};
+	std::unique_ptr<NativeEffect> effect_;
+	std::unique_ptr<FramePlayer> player_;
 	std::unordered_set<std::string> scripts_imported_;
 	bool running_{false};
 	uint64_t stop_time_ms_{0};
@@ -146,6 +167,8 @@ private:
 	std::string script_;
 	bool script_changed_{false};
 	bool reverse_{false};
+	bool interpolate_{false};
+	std::vector<std::string> group_;
 	ScriptConfig config_;
 
 	std::weak_ptr<std::shared_ptr<Preset>> editing_;
@@ -166,6 +189,8 @@ public:
 	void remove(const std::string &name);
 
 	inline const std::unordered_map<std::string,std::string>& descriptions() const { return descriptions_; }
+	inline uint32_t id() const { return id_; }
+	inline uint32_t generation() const { return generation_; }
 
 private:
 	static uuid::log::Logger logger_;
@@ -174,6 +199,8 @@ private:
 	uint64_t start_;
 	std::unique_ptr<std::vector<std::string>> presets_;
 	std::unordered_map<std::string,std::string> descriptions_;
+	uint32_t id_;
+	uint32_t generation_{0};
 	size_t refresh_{0};
 };
 
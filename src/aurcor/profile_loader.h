@@ -0,0 +1,72 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <uuid/log.h>
+
+#include "led_profiles.h"
+
+namespace aurcor {
+
+class LEDBus;
+
+/*
+ * Loads LED profiles in the background so that scripts don't have to wait
+ * for them to be read from the filesystem when outputting a frame.
+ */
+class ProfileLoader {
+public:
+	static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+
+	ProfileLoader() = default;
+	~ProfileLoader();
+
+	void add(const std::shared_ptr<LEDBus> &bus, enum led_profile_id id, bool reload);
+	void loop();
+
+private:
+	struct Entry {
+		std::shared_ptr<LEDBus> bus;
+		enum led_profile_id id;
+		bool reload;
+	};
+
+	static uuid::log::Logger logger_;
+
+	ProfileLoader(ProfileLoader&&) = delete;
+	ProfileLoader(const ProfileLoader&) = delete;
+	ProfileLoader& operator=(ProfileLoader&&) = delete;
+	ProfileLoader& operator=(const ProfileLoader&) = delete;
+
+	void run();
+
+	std::mutex mutex_;
+	std::deque<Entry> pending_;
+	std::thread thread_;
+	std::atomic<bool> done_{false};
+};
+
+} // namespace aurcor
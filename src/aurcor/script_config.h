@@ -397,11 +397,25 @@ public:
 	void register_properties(mp_obj_t dict);
 	void populate_dict(mp_obj_t dict);
 
+	/*
+	 * Register a property from native code, without removing any other
+	 * properties. The default value is cleared and must be set by the caller.
+	 */
+	Property& register_property(const std::string &key, Type type);
+
+	/* Native access to values (or defaults); returns false if not set */
+	bool get(const std::string &key, bool &value) const;
+	bool get(const std::string &key, int32_t &value) const;
+	bool get(const std::string &key, float &value) const;
+	bool get(const std::string &key, enum led_profile_id &value) const;
+	bool get(const std::string &key, std::vector<int32_t> &values) const;
+
 	std::vector<std::string> keys(types_bitset types) const;
 	Type key_type(const std::string &key) const;
 	std::vector<std::string> container_values(const std::string &key) const;
 	Result modify(const std::string &key, const std::string &value, ContainerOp op, size_t index1 = 0, size_t index2 = 0);
 	Result set(const std::string &key, const std::string &value);
+	Result check(const std::string &key, const std::string &value) const; /* Validate set() without modifying */
 	Result unset(const std::string &key);
 	bool print(uuid::console::Shell &shell, const std::string *filter_key) const;
 	bool clear();
@@ -0,0 +1,163 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace aurcor {
+
+/*
+ * Small value that can be read consistently without locking. Writers must
+ * be serialised by the caller; readers retry if a write happens while they
+ * are reading.
+ */
+template <typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable_v<T>, "Value must be trivially copyable");
+
+public:
+	SeqLock() { store(T{}); }
+	~SeqLock() = default;
+
+	T load() const {
+		std::array<uint32_t,WORDS> words;
+		uint32_t before;
+		uint32_t after;
+		T value;
+
+		while (true) {
+			before = seq_.load(std::memory_order_acquire);
+
+			for (size_t i = 0; i < WORDS; i++)
+				words[i] = data_[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = seq_.load(std::memory_order_relaxed);
+
+			if (!(before & 1) && before == after)
+				break;
+
+			/* Let the writer finish if it's on the same core */
+			std::this_thread::yield();
+		}
+
+		std::memcpy(&value, words.data(), sizeof(value));
+		return value;
+	}
+
+	void store(const T &value) {
+		std::array<uint32_t,WORDS> words{};
+		uint32_t seq = seq_.load(std::memory_order_relaxed);
+
+		std::memcpy(words.data(), &value, sizeof(value));
+
+		seq_.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < WORDS; i++)
+			data_[i].store(words[i], std::memory_order_relaxed);
+
+		seq_.store(seq + 2, std::memory_order_release);
+	}
+
+private:
+	static constexpr size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+	SeqLock(SeqLock&&) = delete;
+	SeqLock(const SeqLock&) = delete;
+	SeqLock& operator=(SeqLock&&) = delete;
+	SeqLock& operator=(const SeqLock&) = delete;
+
+	std::atomic<uint32_t> seq_{0};
+	std::array<std::atomic<uint32_t>,WORDS> data_{};
+};
+
+/*
+ * Immutable value that is replaced by writers. Each reader keeps its own
+ * reference to the current value and only needs to lock when a new value
+ * has been published, so readers never wait for writers to build the next
+ * value. Old values are freed when the last reader stops using them.
+ */
+template <typename T>
+class Published {
+public:
+	class Reader {
+	public:
+		Reader() = default;
+		~Reader() = default;
+
+		const T& get(const Published &published) {
+			if (generation_ != published.generation_.load(std::memory_order_acquire)) {
+				std::lock_guard lock{published.mutex_};
+
+				value_ = published.value_;
+				generation_ = published.generation_.load(std::memory_order_relaxed);
+			}
+
+			return *value_;
+		}
+
+	private:
+		Reader(Reader&&) = delete;
+		Reader(const Reader&) = delete;
+		Reader& operator=(Reader&&) = delete;
+		Reader& operator=(const Reader&) = delete;
+
+		std::shared_ptr<const T> value_;
+		uint32_t generation_{0};
+	};
+
+	Published() : value_(std::make_shared<const T>()) {}
+	~Published() = default;
+
+	std::shared_ptr<const T> get() const {
+		std::lock_guard lock{mutex_};
+		return value_;
+	}
+
+	void publish(std::shared_ptr<const T> value) {
+		std::unique_lock lock{mutex_};
+
+		std::swap(value_, value);
+		generation_.fetch_add(1, std::memory_order_release);
+		lock.unlock();
+
+		/* The previous value is released here, outside the lock */
+	}
+
+private:
+	Published(Published&&) = delete;
+	Published(const Published&) = delete;
+	Published& operator=(Published&&) = delete;
+	Published& operator=(const Published&) = delete;
+
+	mutable std::mutex mutex_;
+	std::shared_ptr<const T> value_;
+	std::atomic<uint32_t> generation_{1};
+};
+
+} // namespace aurcor
@@ -70,6 +70,7 @@ public:
 
 protected:
 	void start(const uint8_t *data, size_t size, bool reverse_order) final override;
+	void tx_start() final override;
 
 private:
 	class DeviceDeleter {
@@ -97,8 +98,6 @@ private:
 	std::unique_ptr<struct spi_device_t,DeviceDeleter> device_;
 	std::unique_ptr<uint32_t> buffer_;
 	spi_transaction_t trans_{};
-	uint64_t next_tx_start_us_{0};
-	size_t next_tx_delay_us_{0};
 	bool ok_;
 };
 #endif
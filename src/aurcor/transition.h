@@ -0,0 +1,94 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "memory_pool.h"
+
+namespace aurcor {
+
+/*
+ * Blends frames from the outgoing script into frames from the incoming
+ * script while both are running, before the profile transform.
+ *
+ * The outgoing script continues to run in the background but its frames are
+ * only copied into a buffer, which is overlaid on the incoming script's
+ * frames until the transition has finished.
+ */
+class Transition {
+public:
+	enum class Type : uint8_t {
+		NONE = 0,
+		CROSSFADE = 1,
+		WIPE = 2,
+	};
+
+	static constexpr Type DEFAULT_TYPE = Type::NONE;
+	static constexpr unsigned int DEFAULT_DURATION_MS = 1000;
+	static constexpr unsigned int MAX_DURATION_MS = 60 * 1000;
+
+	static void setup(size_t count);
+	static const char *name(Type type);
+	static bool type(const std::string &name, Type &type);
+
+	Transition() = default;
+	~Transition() = default;
+
+	/* Returns false if there's no buffer available for the outgoing frame */
+	bool start(Type type, unsigned int duration_ms, uint64_t now_us);
+	void stop();
+	inline bool active() const { return active_; }
+
+	/* Frame from the outgoing script */
+	void outgoing(const uint8_t *data, size_t size);
+	/*
+	 * Blend the outgoing frame with a frame from the incoming script into
+	 * another buffer (which may be the same buffer). Returns false if there's
+	 * no transition, without writing to the destination.
+	 */
+	bool blend(const uint8_t *src, uint8_t *dst, size_t size, uint64_t now_us);
+
+	void loop(uint64_t now_us);
+
+private:
+	static std::shared_ptr<MemoryPool> buffers_;
+
+	Transition(Transition&&) = delete;
+	Transition(const Transition&) = delete;
+	Transition& operator=(Transition&&) = delete;
+	Transition& operator=(const Transition&) = delete;
+
+	void stop_locked();
+
+	std::mutex mutex_;
+	std::atomic<bool> active_{false};
+	Type type_{DEFAULT_TYPE};
+	uint64_t start_us_{0};
+	uint32_t duration_us_{0};
+	std::unique_ptr<MemoryBlock> buffer_;
+	size_t size_{0};
+};
+
+} // namespace aurcor
@@ -57,6 +57,7 @@ public:
 
 protected:
 	void start(const uint8_t *data, size_t size, bool reverse_order) final override;
+	void tx_start() final override;
 
 private:
 	static constexpr unsigned long TX_START_BITS = 1;
@@ -105,8 +106,6 @@ private:
 #endif
 	std::unique_ptr<lldesc_t> tx_link_;
 	std::unique_ptr<uint32_t> buffer_;
-	uint64_t next_tx_start_us_{0};
-	size_t next_tx_delay_us_{0};
 	bool ok_;
 };
 #endif
@@ -89,6 +89,7 @@ public:
 
 protected:
 	void transmit() override;
+	void tx_start() final override;
 
 private:
 	static constexpr unsigned long TX_START_BITS = 1;
@@ -121,8 +122,6 @@ private:
 	uart_dev_t &hw_;
 	const uintptr_t uart_fifo_reg_;
 	const uintptr_t uart_status_reg_;
-	uint64_t next_tx_start_us_{0};
-	size_t next_tx_delay_us_{0};
 	intr_handle_t interrupt_;
 	bool ok_;
 };
@@ -85,6 +85,16 @@ static inline constexpr unsigned int uint_divide(unsigned int divided, unsigned
 	return ((divided << (bits + 1U)) / divisor + (1U << bits)) >> (bits + 1U);
 }
 
+/* FNV-1a (64-bit) hash of file contents, which can be calculated incrementally */
+static inline uint64_t content_hash(const uint8_t *data, size_t len, uint64_t hash = 0xcbf29ce484222325ULL) {
+	for (size_t i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
 static inline bool str_begins_case_insensitive(const std::string &str, const char *find) {
 	return !::strncasecmp(str.c_str(), find, std::char_traits<char>::length(find));
 }
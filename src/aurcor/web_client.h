@@ -18,10 +18,11 @@
 
 #pragma once
 
+#include <Arduino.h>
+
 #ifdef ENV_NATIVE
 # include <curl/curl.h>
 #else
-# include <Arduino.h>
 # include <esp_http_client.h>
 #endif
 
@@ -45,9 +46,12 @@ public:
 	static void init();
 #endif
 
-	bool open(const std::string &url);
+	bool open(const std::string &url, const std::string &if_none_match = "");
 	ssize_t read(char *data, ssize_t size);
 
+	inline bool not_modified() const { return not_modified_; }
+	inline const std::string& etag() const { return etag_; }
+
 	std::vector<std::string> list_urls(const std::string &url,
 		const std::function<bool(const std::string &path)> &filter,
 		size_t max_path_length = 64);
@@ -69,10 +73,18 @@ private:
 
 #ifdef ENV_NATIVE
 	static size_t curl_append(char *ptr, size_t size, size_t nmemb, void *userdata);
+	static size_t curl_header(char *buffer, size_t size, size_t nitems, void *userdata);
+#else
+	static esp_err_t http_event(esp_http_client_event_t *evt);
 #endif
 
+	void header(const char *name, size_t name_len, const char *value, size_t value_len);
+
 	static uuid::log::Logger logger_;
 
+	std::string etag_;
+	bool not_modified_{false};
+
 #ifdef ENV_NATIVE
 	std::unique_ptr<CURL,CurlDeleter> curl_;
 	std::vector<char> data_;
@@ -81,4 +93,26 @@ private:
 #endif
 };
 
+/* Read-only stream over the response body of an open WebClient */
+class WebClientStream: public Stream {
+public:
+	explicit WebClientStream(WebClient &client) : client_(client) {}
+
+	int available() override;
+	int read() override;
+	int peek() override;
+	size_t readBytes(char *buffer, size_t length) override;
+
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+
+private:
+	bool fill();
+
+	WebClient &client_;
+	char buffer_[64];
+	size_t pos_{0};
+	size_t len_{0};
+};
+
 } // namespace aurcor
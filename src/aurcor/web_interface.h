@@ -20,29 +20,89 @@
 
 #include <Arduino.h>
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+
 #include <uuid/log.h>
 
 #include "app.h"
+#include "led_bus_format.h"
 #include "web_server.h"
 
 namespace aurcor {
 
+class LEDBus;
+class Preset;
 class WebServer;
 
 class WebInterface {
 public:
+	static constexpr size_t MAX_EVENT_STREAMS = 4;
+	static constexpr unsigned long EVENT_INTERVAL_MS = 250;
+	static constexpr size_t MAX_BATCH_SIZE = 4096;
+
 	WebInterface(App &app);
 
+	void loop();
+
 private:
+	/*
+	 * All of the operations in a batch are parsed and validated (including
+	 * loading any presets) before any of them are applied.
+	 */
+	struct BusOperation {
+		std::shared_ptr<LEDBus> bus;
+		std::shared_ptr<Preset> preset;
+		bool set_default{false};
+		bool fps_set{false};
+		unsigned int fps;
+		bool length_set{false};
+		size_t length;
+		bool format_set{false};
+		LEDBusFormat format;
+		bool reverse_set{false};
+		bool reverse;
+		std::vector<std::pair<std::string,std::string>> config;
+	};
+
 	static std::unordered_map<std::string_view,std::string_view> parse_form(std::string_view text);
+	static bool etag_matches(std::string_view if_none_match, std::string_view etag);
+	static void append_json_string(std::string &data, std::string_view text);
 
 	bool list_presets(WebServer::Request &req);
+	std::string render_presets(bool default_flag, const std::string &current_preset,
+		const std::string &default_preset);
 	bool set_preset(WebServer::Request &req);
+	bool batch(WebServer::Request &req);
+	const char *parse_batch(qindesign::cbor::Reader &reader, std::vector<BusOperation> &operations);
+	const char *parse_operation(qindesign::cbor::Reader &reader, BusOperation &operation);
+	const char *apply_batch(std::vector<BusOperation> &operations);
+	bool add_event_stream(const std::shared_ptr<WebServer::EventStream> &stream, bool frames);
+	std::string bus_status(const std::shared_ptr<LEDBus> &bus, uint64_t now_us);
+	std::string bus_frame(const std::shared_ptr<LEDBus> &bus);
 
 	static uuid::log::Logger logger_;
 
 	App &app_;
 	WebServer server_;
+
+	std::mutex list_presets_mutex_;
+	std::string list_presets_etag_;
+	std::string list_presets_data_;
+
+	std::mutex event_streams_mutex_;
+	std::vector<std::pair<std::shared_ptr<WebServer::EventStream>,bool>> event_streams_;
+	uint64_t last_event_us_{0};
+	std::unordered_map<std::string,std::pair<uint32_t,uint64_t>> bus_frames_;
 };
 
 } // namespace aurcor
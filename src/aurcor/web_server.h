@@ -32,8 +32,12 @@ typedef int MHD_Result;
 # include <esp_http_server.h>
 #endif
 
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -79,13 +83,15 @@ public:
 	private:
 #ifdef ENV_NATIVE
 		bool first();
-		void upload(const char *data, size_t len);
+		void upload(const char *data, size_t len, size_t max_length);
+		inline bool too_large() const { return too_large_; }
 		MHD_Result finish();
 
 		struct MHD_Connection *connection_;
 		const std::string url_;
 		bool first_{true};
 		std::vector<char> upload_data_;
+		bool too_large_{false};
 		std::vector<char> buffer_;
 		unsigned int status_{0};
 		const char *content_type_;
@@ -105,16 +111,59 @@ public:
 #endif
 	};
 
+	/*
+	 * Server-Sent Events stream. Events are queued without blocking and
+	 * the oldest events are dropped if the client isn't keeping up.
+	 */
+	class EventStream {
+		friend WebServer;
+	public:
+		static constexpr size_t MAX_QUEUED_EVENTS = 8;
+		static constexpr unsigned long KEEPALIVE_MS = 15000;
+
+		EventStream() = default;
+
+		bool send(const char *event, const std::string &data); /* Returns false if closed */
+		bool closed();
+		unsigned long dropped();
+
+	private:
+		EventStream(EventStream&&) = delete;
+		EventStream(const EventStream&) = delete;
+		EventStream& operator=(EventStream&&) = delete;
+		EventStream& operator=(const EventStream&) = delete;
+
+		bool receive(std::string &text, unsigned long timeout_ms);
+		void close();
+#ifdef ENV_NATIVE
+		ssize_t read(char *buffer, size_t max);
+#endif
+
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		std::deque<std::string> events_;
+		unsigned long dropped_{0};
+		bool closed_{false};
+#ifdef ENV_NATIVE
+		std::string pending_;
+		size_t pending_pos_{0};
+#endif
+	};
+
 	using get_function = std::function<bool(Request &req)>;
 	using post_function = std::function<bool(Request &req)>;
+	using event_function = std::function<bool(const std::shared_ptr<EventStream> &stream)>;
 
 	WebServer(uint16_t port = DEFAULT_PORT);
 	~WebServer();
 
 	bool add_get_handler(const std::string &uri, get_function handler);
-	bool add_post_handler(const std::string &uri, post_function handler);
+	/* Requests with a body longer than max_length are rejected (413) */
+	bool add_post_handler(const std::string &uri, post_function handler,
+		size_t max_length = SIZE_MAX);
 	bool add_static_content(const std::string &uri, const char *content_type,
 		const char * const headers[][2], const std::string_view data);
+	bool add_event_handler(const std::string &uri, event_function handler);
 
 private:
 #ifdef ENV_NATIVE
@@ -147,6 +196,7 @@ private:
 #ifdef ENV_NATIVE
 		virtual std::string method() = 0;
 		inline const std::string& uri() const { return uri_; }
+		virtual size_t max_length() const { return SIZE_MAX; }
 		virtual MHD_Result handle_connection(Request &req) = 0;
 #else
 		virtual httpd_method_t method() = 0;
@@ -186,10 +236,11 @@ private:
 
 	class PostURIHandler: public URIHandler {
 	public:
-		PostURIHandler(const std::string &uri, post_function handler);
+		PostURIHandler(const std::string &uri, post_function handler, size_t max_length);
 
 #ifdef ENV_NATIVE
 		std::string method() override;
+		inline size_t max_length() const override { return max_length_; }
 		MHD_Result handle_connection(Request &req) override;
 #endif
 
@@ -201,6 +252,7 @@ private:
 
 	private:
 		post_function function_;
+		const size_t max_length_;
 	};
 
 	class StaticContentURIHandler: public URIHandler {
@@ -225,6 +277,36 @@ private:
 		const std::string_view data_;
 	};
 
+	class EventURIHandler: public URIHandler {
+	public:
+#ifndef ENV_NATIVE
+		static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+#endif
+
+		EventURIHandler(const std::string &uri, event_function handler);
+
+#ifdef ENV_NATIVE
+		std::string method() override;
+		MHD_Result handle_connection(Request &req) override;
+#endif
+
+	protected:
+#ifndef ENV_NATIVE
+		httpd_method_t method() override;
+		esp_err_t handler_function(httpd_req_t *req) override;
+#endif
+
+	private:
+#ifdef ENV_NATIVE
+		static ssize_t read_events(void *cls, uint64_t pos, char *buf, size_t max);
+		static void free_events(void *cls);
+#else
+		static void stream_events(httpd_req_t *req, std::shared_ptr<EventStream> stream);
+#endif
+
+		event_function function_;
+	};
+
 #ifdef ENV_NATIVE
 	static inline std::unique_ptr<struct MHD_Response,MHD_ResponseDeleter>
 			wrap_response(struct MHD_Response *response) {
@@ -0,0 +1,119 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aurcor/compositor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace aurcor {
+
+/* Divide by 255 with rounding, for values up to 255 * 255 */
+static inline uint8_t div255(unsigned int value) {
+	value += 128;
+	return (value + (value >> 8)) >> 8;
+}
+
+bool Compositor::valid(int mode) {
+	switch (static_cast<Blend>(mode)) {
+	case Blend::NONE:
+	case Blend::ADD:
+	case Blend::MULTIPLY:
+	case Blend::MAX:
+	case Blend::ALPHA:
+		return true;
+	}
+
+	return false;
+}
+
+uint8_t *Compositor::layer(size_t index, Blend mode, uint8_t opacity) {
+	auto &layer = layers_.at(index);
+
+	if (layer.data.empty())
+		layer.data.resize(max_bytes_);
+
+	layer.mode = mode;
+	layer.opacity = opacity;
+	return layer.data.data();
+}
+
+void Compositor::apply(uint8_t *buffer, size_t size) const {
+	size = std::min(size, max_bytes_);
+
+	for (auto &layer : layers_) {
+		if (layer.mode != Blend::NONE && layer.opacity && !layer.data.empty())
+			apply(buffer, size, layer);
+	}
+}
+
+void Compositor::apply(const uint8_t *src, uint8_t *dst, size_t size) const {
+	if (src != dst)
+		std::memcpy(dst, src, size);
+
+	apply(dst, size);
+}
+
+void Compositor::apply(uint8_t *buffer, size_t size, const Layer &layer) {
+	const uint8_t *data = layer.data.data();
+	const unsigned int opacity = layer.opacity;
+	const unsigned int transparency = MAX_OPACITY - opacity;
+
+	if (layer.mode == Blend::ALPHA) {
+		if (opacity == MAX_OPACITY) {
+			std::memcpy(buffer, data, size);
+		} else {
+			for (size_t i = 0; i < size; i++)
+				buffer[i] = div255(buffer[i] * transparency + data[i] * opacity);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		unsigned int value;
+
+		switch (layer.mode) {
+		case Blend::ADD:
+			value = std::min(UINT8_MAX, buffer[i] + data[i]);
+			break;
+
+		case Blend::MULTIPLY:
+			value = div255(buffer[i] * data[i]);
+			break;
+
+		case Blend::MAX:
+			value = std::max(buffer[i], data[i]);
+			break;
+
+		case Blend::NONE:
+		case Blend::ALPHA:
+		default:
+			value = buffer[i];
+			break;
+		}
+
+		if (opacity == MAX_OPACITY) {
+			buffer[i] = value;
+		} else {
+			buffer[i] = div255(buffer[i] * transparency + value * opacity);
+		}
+	}
+}
+
+} // namespace aurcor
@@ -33,11 +33,14 @@
 
 #include "aurcor/app.h"
 #include "aurcor/console.h"
+#include "aurcor/frame_player.h"
+#include "aurcor/frame_recorder.h"
 #include "aurcor/micropython.h"
 #include "aurcor/led_bus_format.h"
 #include "aurcor/led_profile.h"
 #include "aurcor/preset.h"
 #include "aurcor/script_config.h"
+#include "aurcor/transition.h"
 #include "aurcor/web_client.h"
 #include "app/config.h"
 #include "app/console.h"
@@ -530,6 +533,44 @@ static std::shared_ptr<LEDBus> lookup_bus_or_default(Shell &shell, const std::ve
 	}
 }
 
+#ifdef ENV_NATIVE
+__attribute__((noinline))
+static std::vector<std::string> clocks_autocomplete(Shell &shell,
+		const std::vector<std::string> &current_arguments,
+		const std::string &next_argument) {
+	return {"real", "simulated"};
+};
+#endif
+
+__attribute__((noinline))
+static std::vector<std::string> on_off_autocomplete(Shell &shell,
+		const std::vector<std::string> &current_arguments,
+		const std::string &next_argument) {
+	return {"on", "off"};
+};
+
+__attribute__((noinline))
+static std::vector<std::string> transitions_autocomplete(Shell &shell,
+		const std::vector<std::string> &current_arguments,
+		const std::string &next_argument) {
+	if (current_arguments.size() == 0) {
+		return {"none", "crossfade", "wipe"};
+	} else {
+		return {};
+	}
+};
+
+__attribute__((noinline))
+static std::vector<std::string> recording_stages_autocomplete(Shell &shell,
+		const std::vector<std::string> &current_arguments,
+		const std::string &next_argument) {
+	if (current_arguments.size() == 1) {
+		return {"output", "script"};
+	} else {
+		return {};
+	}
+};
+
 __attribute__((noinline))
 static std::vector<std::string> reset_times_autocomplete(Shell &shell,
 		const std::vector<std::string> &current_arguments,
@@ -564,6 +605,23 @@ static void clear(Shell &shell, const std::vector<std::string> &arguments) {
 	}
 }
 
+#ifdef ENV_NATIVE
+/* [real|simulated] */
+static void clock(Shell &shell, const std::vector<std::string> &arguments) {
+	if (!arguments.empty()) {
+		if (arguments[0] == "real") {
+			MicroPython::simulated_clock(false);
+		} else if (arguments[0] == "simulated") {
+			MicroPython::simulated_clock(true);
+		} else {
+			shell.printfln(F("Unknown clock \"%s\""), arguments[0].c_str());
+		}
+	}
+
+	shell.printfln(F("Clock: %s"), MicroPython::simulated_clock() ? "simulated" : "real");
+}
+#endif
+
 /* [bus] <preset> */
 static void default_(Shell &shell, const std::vector<std::string> &arguments) {
 	const bool has_bus_name = (arguments.size() >= 2);
@@ -972,6 +1030,56 @@ static void show_udp_queue_size(Shell &shell) {
 	shell.printfln(F("UDP queue size: %u"), to_shell(shell).bus()->udp_queue_size());
 };
 
+__attribute__((noinline))
+static void show_cpu_limit(Shell &shell) {
+	auto limit = to_shell(shell).bus()->cpu_limit();
+
+	if (limit >= LEDBusConfig::MAX_CPU_LIMIT) {
+		shell.printfln(F("CPU limit:      <none>"));
+	} else {
+		shell.printfln(F("CPU limit:      %u%%"), limit);
+	}
+};
+
+__attribute__((noinline))
+static void show_cpu_usage(Shell &shell) {
+	shell.printfln(F("CPU usage:      %u%%"), to_shell(shell).bus()->cpu_usage());
+};
+
+__attribute__((noinline))
+static void show_transition(Shell &shell) {
+	auto &bus = to_shell(shell).bus();
+	auto type = bus->transition_type();
+
+	if (type == Transition::Type::NONE) {
+		shell.printfln(F("Transition:     %s"), Transition::name(type));
+	} else {
+		shell.printfln(F("Transition:     %s %u ms"), Transition::name(type), bus->transition_ms());
+	}
+};
+
+__attribute__((noinline))
+static void show_recording(Shell &shell) {
+	auto &recorder = to_shell(shell).bus()->recorder();
+
+	if (recorder.active()) {
+		shell.printfln(F("Recording:      %s (%s, %u frames, %u dropped)"),
+			recorder.name().c_str(),
+			recorder.stage() == FrameRecording::Stage::SCRIPT ? "script" : "output",
+			recorder.frames(), recorder.dropped_frames());
+	} else {
+		shell.printfln(F("Recording:      <none>"));
+	}
+};
+
+/* [percent] */
+static void cpu_limit(Shell &shell, const std::vector<std::string> &arguments) {
+	if (!arguments.empty() && shell.has_any_flags(CommandFlags::ADMIN)) {
+		to_shell(shell).bus()->cpu_limit(std::atol(arguments[0].c_str()));
+	}
+	show_cpu_limit(shell);
+}
+
 static void clear(Shell &shell, const std::vector<std::string> &arguments) {
 	auto &bus = to_shell(shell).bus();
 
@@ -1088,6 +1196,46 @@ static void profile(Shell &shell, const std::vector<std::string> &arguments) {
 	}
 }
 
+/* <name> [output|script] */
+static void record(Shell &shell, const std::vector<std::string> &arguments) {
+	auto &recorder = to_shell(shell).bus()->recorder();
+	auto &name = arguments[0];
+	auto stage = FrameRecording::Stage::OUTPUT;
+
+	if (arguments.size() >= 2) {
+		if (arguments[1] == "script") {
+			stage = FrameRecording::Stage::SCRIPT;
+		} else if (arguments[1] != "output") {
+			shell.printfln(F("Invalid stage \"%s\""), arguments[1].c_str());
+			return;
+		}
+	}
+
+	switch (recorder.start(name, stage)) {
+	case Result::OK:
+		break;
+
+	case Result::OUT_OF_RANGE:
+		shell.printfln(F("Invalid recording name \"%s\""), name.c_str());
+		return;
+
+	case Result::FULL:
+		shell.println(F("No recording buffers available"));
+		return;
+
+	default:
+		shell.printfln(F("Unable to write recording \"%s\""), name.c_str());
+		return;
+	}
+
+	show_recording(shell);
+}
+
+static void record_stop(Shell &shell, const std::vector<std::string> &arguments) {
+	to_shell(shell).bus()->recorder().stop();
+	show_recording(shell);
+}
+
 /* [microseconds] */
 static void reset_time(Shell &shell, const std::vector<std::string> &arguments) {
 	if (!arguments.empty() && shell.has_any_flags(CommandFlags::ADMIN)) {
@@ -1173,6 +1321,8 @@ static void show(Shell &shell, const std::vector<std::string> &arguments) {
 	show_default_preset(shell, to_shell(shell).bus());
 	show_udp_port(shell);
 	show_udp_queue_size(shell);
+	show_transition(shell);
+	show_recording(shell);
 
 	auto preset = to_app(shell).edit(to_shell(shell).bus());
 
@@ -1181,6 +1331,25 @@ static void show(Shell &shell, const std::vector<std::string> &arguments) {
 		preset ? (preset->get()->modified() ? " (unsaved)" : "") : "");
 
 	show_default_fps(shell);
+	show_cpu_usage(shell);
+	show_cpu_limit(shell);
+}
+
+/* [none|crossfade|wipe] [milliseconds] */
+static void transition(Shell &shell, const std::vector<std::string> &arguments) {
+	if (!arguments.empty() && shell.has_any_flags(CommandFlags::ADMIN)) {
+		auto &bus = to_shell(shell).bus();
+		auto &type_name = arguments[0];
+		Transition::Type type;
+
+		if (Transition::type(type_name, type)) {
+			bus->transition(type, arguments.size() >= 2
+				? std::atol(arguments[1].c_str()) : bus->transition_ms());
+		} else {
+			shell.printfln(F("Unknown transition \"%s\""), type_name.c_str());
+		}
+	}
+	show_transition(shell);
 }
 
 /* [port] */
@@ -1326,6 +1495,37 @@ static void show_direction(Shell &shell) {
 	shell.printfln(F("Direction:   %s"), preset.reverse() ? "reverse" : "normal");
 };
 
+__attribute__((noinline))
+static void show_interpolate(Shell &shell) {
+	auto &aurcor_shell = to_shell(shell);
+	auto &preset = aurcor_shell.preset();
+
+	shell.printfln(F("Interpolate: %s"), preset.interpolate() ? "on" : "off");
+};
+
+__attribute__((noinline))
+static void show_group(Shell &shell) {
+	auto &aurcor_shell = to_shell(shell);
+	auto group = aurcor_shell.preset().group();
+
+	shell.print(F("Group:       "));
+
+	if (group.empty()) {
+		shell.print(F("none"));
+	} else {
+		bool first = true;
+
+		for (auto &name : group) {
+			if (!first)
+				shell.print(", ");
+			shell.print(name.c_str());
+			first = false;
+		}
+	}
+
+	shell.println();
+};
+
 /* <config property> <value> */
 static void add(Shell &shell, const std::vector<std::string> &arguments) {
 	auto &name = arguments[0];
@@ -1460,6 +1660,69 @@ static void name(Shell &shell, const std::vector<std::string> &arguments) {
 	show_name(shell);
 }
 
+/* [bus] */
+static void group(Shell &shell, const std::vector<std::string> &arguments) {
+	auto &aurcor_shell = to_shell(shell);
+
+	if (!aurcor_shell.preset_active())
+		return;
+
+	if (!arguments.empty()) {
+		auto &name = arguments[0];
+		auto group = aurcor_shell.preset().group();
+
+		if (!to_app(shell).bus(name)) {
+			shell.printfln(F("Bus \"%s\" not found"), name.c_str());
+		} else if (name == aurcor_shell.bus()->name()) {
+			shell.printfln(F("Can't add the preset's own bus to its group"));
+		} else if (std::find(group.cbegin(), group.cend(), name) == group.cend()) {
+			group.push_back(name);
+			aurcor_shell.preset().group(std::move(group));
+		}
+	}
+
+	show_group(shell);
+}
+
+/* [on|off] */
+static void interpolate(Shell &shell, const std::vector<std::string> &arguments) {
+	auto &aurcor_shell = to_shell(shell);
+
+	if (!aurcor_shell.preset_active())
+		return;
+
+	if (!arguments.empty()) {
+		if (arguments[0] == "on") {
+			aurcor_shell.preset().interpolate(true);
+		} else if (arguments[0] == "off") {
+			aurcor_shell.preset().interpolate(false);
+		} else {
+			shell.printfln(F("Invalid value \"%s\""), arguments[0].c_str());
+		}
+	}
+
+	show_interpolate(shell);
+}
+
+/* [bus] */
+static void ungroup(Shell &shell, const std::vector<std::string> &arguments) {
+	auto &aurcor_shell = to_shell(shell);
+
+	if (!aurcor_shell.preset_active())
+		return;
+
+	auto group = aurcor_shell.preset().group();
+
+	if (arguments.empty()) {
+		group.clear();
+	} else {
+		group.erase(std::remove(group.begin(), group.end(), arguments[0]), group.end());
+	}
+
+	aurcor_shell.preset().group(std::move(group));
+	show_group(shell);
+}
+
 static void normal(Shell &shell, const std::vector<std::string> &arguments) {
 	auto &aurcor_shell = to_shell(shell);
 
@@ -1515,7 +1778,9 @@ static void script(Shell &shell, const std::vector<std::string> &arguments) {
 	if (!aurcor_shell.preset_active())
 		return;
 
-	if (MicroPythonFile::exists(script_name.c_str())) {
+	if (MicroPythonFile::exists(script_name.c_str())
+			|| (FramePlayer::supported(script_name)
+				&& FrameRecording::exists(script_name.substr(FrameRecording::SCRIPT_PREFIX_LEN)))) {
 		aurcor_shell.preset().script(script_name);
 		show_script(shell);
 	} else {
@@ -1562,6 +1827,8 @@ static void show(Shell &shell, const std::vector<std::string> &arguments) {
 		show_description(shell);
 		show_script(shell);
 		show_direction(shell);
+		show_interpolate(shell);
+		show_group(shell);
 
 		auto keys_size = preset.config_keys_size();
 		auto defaults_size = preset.config_defaults_size();
@@ -1850,6 +2117,9 @@ using namespace console;
 static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 	commands->add_command(context::main, user, {F("bus")}, {F("[bus]")}, main::bus, bus_names_autocomplete);
 	commands->add_command(context::main, user, {F("clear")}, {F("[bus]")}, main::clear, bus_names_autocomplete);
+#ifdef ENV_NATIVE
+	commands->add_command(context::main, admin, {F("clock")}, {F("[real|simulated]")}, main::clock, clocks_autocomplete);
+#endif
 	commands->add_command(context::main, admin, {F("default")}, {F("[bus]"), F("<preset>")}, main::default_, bus_preset_names_default_autocomplete);
 	commands->add_command(context::main, user, {F("download")}, {F("[url]")}, main::download);
 	commands->add_command(context::main, admin, {F("edit")}, {F("[bus]")}, main::edit, bus_names_autocomplete);
@@ -1868,14 +2138,18 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 
 	commands->add_command(context::bus, user, {F("default")}, {F("[preset]")}, bus::default_, preset_names_autocomplete);
 	commands->add_command(context::bus, user, {F("clear")}, bus::clear);
+	commands->add_command(context::bus, user, {F("cpu"), F("limit")}, {F("[percent]")}, bus::cpu_limit);
 	commands->add_command(context::bus, admin, {F("edit")}, {F("[preset]")}, bus::edit);
 	commands->add_command(context::bus, user, {F("format")}, {F("[format]")}, bus::format, bus_formats_autocomplete);
 	commands->add_command(context::bus, user, {F("fps")}, {F("[fps]")}, bus::fps);
 	commands->add_command(context::bus, user, {F("length")}, {F("[length]")}, bus::length);
+	commands->add_command(context::bus, user, {F("transition")}, {F("[none|crossfade|wipe]"), F("[milliseconds]")}, bus::transition, transitions_autocomplete);
 	commands->add_command(context::bus, user, {F("udp"), F("port")}, {F("[port]")}, bus::udp_port);
 	commands->add_command(context::bus, user, {F("udp"), F("queue"), F("size")}, {F("[size]")}, bus::udp_queue_size);
 	commands->add_command(context::bus, admin, {F("normal")}, bus::normal);
 	commands->add_command(context::bus, user, {F("profile")}, {F("<profile>")}, bus::profile, profile_names_autocomplete);
+	commands->add_command(context::bus, admin, {F("record")}, {F("<name>"), F("[output|script]")}, bus::record, recording_stages_autocomplete);
+	commands->add_command(context::bus, admin, {F("record"), F("stop")}, bus::record_stop);
 	commands->add_command(context::bus, user, {F("reset"), F("time")}, {F("[microseconds]")}, bus::reset_time, reset_times_autocomplete);
 	commands->add_command(context::bus, admin, {F("reverse")}, bus::reverse);
 	commands->add_command(context::bus, admin, {F("run")}, {F("<script>")}, bus::run, script_names_autocomplete);
@@ -1903,6 +2177,8 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 	commands->add_command(context::bus_preset, admin, {F("del")}, {F("<config property>"), F("<value>")}, bus_preset::del, preset_config_property_container_name_value_autocomplete);
 	commands->add_command(context::bus_preset, admin, {F("desc")}, {F("<description>")}, bus_preset::desc, preset_current_description_autocomplete);
 	commands->add_command(context::bus_preset, admin, {F("edit")}, {F("<config property>")}, bus_preset::edit, preset_config_property_container_name_autocomplete);
+	commands->add_command(context::bus_preset, admin, {F("group")}, {F("[bus]")}, bus_preset::group, bus_names_autocomplete);
+	commands->add_command(context::bus_preset, admin, {F("interpolate")}, {F("[on|off]")}, bus_preset::interpolate, on_off_autocomplete);
 	commands->add_command(context::bus_preset, admin, {F("name")}, {F("<name>")}, bus_preset::name, preset_current_name_autocomplete);
 	commands->add_command(context::bus_preset, admin, {F("normal")}, bus_preset::normal);
 	commands->add_command(context::bus_preset, admin, {F("reload")}, bus_preset::reload);
@@ -1913,6 +2189,7 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 	commands->add_command(context::bus_preset, admin, {F("script")}, {F("<script>")}, bus_preset::script, script_names_autocomplete);
 	commands->add_command(context::bus_preset, admin, {F("set")}, {F("<config property>"), F("<value>")}, bus_preset::set, preset_config_property_primitive_name_value_autocomplete);
 	commands->add_command(context::bus_preset, user, {F("show")}, {F("[config property]")}, bus_preset::show, preset_config_property_name_autocomplete);
+	commands->add_command(context::bus_preset, admin, {F("ungroup")}, {F("[bus]")}, bus_preset::ungroup, bus_names_autocomplete);
 	commands->add_command(context::bus_preset, admin, {F("unset")}, {F("<config property>")}, bus_preset::unset, preset_config_property_name_autocomplete);
 
 	commands->add_command(context::bus_preset_cfglist, admin, {F("after")}, {F("<position>"), F("<value>")}, bus_preset_cfglist::after);
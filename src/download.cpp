@@ -24,16 +24,26 @@
 # include <esp_pthread.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+
 #include "app/fs.h"
+#include "app/util.h"
 #include "aurcor/app.h"
+#include "aurcor/file_hash_index.h"
 #include "aurcor/led_bus_config.h"
 #include "aurcor/led_profiles.h"
 #include "aurcor/memory_pool.h"
@@ -43,6 +53,7 @@
 #include "aurcor/util.h"
 #include "aurcor/web_client.h"
 
+namespace cbor = qindesign::cbor;
 using app::FS;
 
 #ifndef PSTR_ALIGN
@@ -64,7 +75,7 @@ Download::Download(App &app, const std::string &url) : app_(app), url_(url) {
 }
 
 void Download::init() {
-	buffers_->resize(1);
+	buffers_->resize(MAX_TRANSFERS);
 }
 
 bool Download::start() {
@@ -104,30 +115,82 @@ void Download::run() {
 
 		logger_.notice("Downloading from %s", url_.c_str());
 
-		std::unordered_map<std::string,std::function<void(const std::string &path)>> types{
-			{"buses/", std::bind(&Download::download_buses, this, std::placeholders::_1)},
-			{"profiles/", std::bind(&Download::download_profiles, this, std::placeholders::_1)},
-			{"scripts/", std::bind(&Download::download_scripts, this, std::placeholders::_1)},
-			{"presets/", std::bind(&Download::download_presets, this, std::placeholders::_1)},
-		};
+		load_index();
 
-		changed_ = std::make_unique<Refresh>();
+		types_.emplace("buses/", Type{"Bus config", LEDBusConfig::DIRECTORY_NAME,
+			[this] (const std::string &filename) -> bool {
+				return !!app_.bus(filename_without_extension(filename, LEDBusConfig::FILENAME_EXT));
+			},
+			[this] (const std::string &filename, Update result) {
+				if (result == Update::MODIFIED)
+					changed_->buses.insert(app_.bus(filename_without_extension(filename, LEDBusConfig::FILENAME_EXT)));
+			}
+		});
 
-		uint64_t start = current_time_us();
-		auto urls = client_.list_urls(url_, [&types] (const std::string &path) -> bool {
-			return types.find(path) != types.end();
+		types_.emplace("profiles/", Type{"Bus profiles", LEDProfile::DIRECTORY_NAME,
+			[this] (const std::string &filename) -> bool {
+				std::shared_ptr<LEDBus> bus;
+				enum led_profile_id profile_id;
+
+				return bus_and_profile_from_filename(filename, bus, profile_id);
+			},
+			[this] (const std::string &filename, Update result) {
+				if (result == Update::MODIFIED) {
+					std::shared_ptr<LEDBus> bus;
+					enum led_profile_id profile_id;
+
+					if (bus_and_profile_from_filename(filename, bus, profile_id))
+						changed_->profiles.insert({bus, profile_id});
+				}
+			}
 		});
-		download_time_ += current_time_us() - start;
 
-		for (auto &url : urls) {
-			auto type = types.find(url);
+		types_.emplace("scripts/", Type{"Scripts", MicroPython::DIRECTORY_NAME,
+			[] (const std::string &filename) -> bool {
+				auto name = filename_without_extension(filename, MicroPython::FILENAME_EXT);
+				return allowed_file_name(name) && name.length() < MicroPythonFile::MAX_NAME_LENGTH;
+			},
+			[this] (const std::string &filename, Update result) {
+				if (result == Update::MODIFIED)
+					changed_->scripts.insert(filename_without_extension(filename, MicroPython::FILENAME_EXT));
+			}
+		});
 
-			if (type != types.end()) {
-				type->second(url);
+		types_.emplace("presets/", Type{"Presets", Preset::DIRECTORY_NAME,
+			[] (const std::string &filename) -> bool {
+				auto name = filename_without_extension(filename, Preset::FILENAME_EXT);
+				return allowed_file_name(name) && name.length() < Preset::MAX_NAME_LENGTH;
+			},
+			[this] (const std::string &filename, Update result) {
+				auto name = filename_without_extension(filename, Preset::FILENAME_EXT);
+
+				switch (result) {
+				case Update::MODIFIED:
+					changed_->presets.insert(name);
+					break;
+
+				case Update::DELETED:
+					app_.remove_preset_description(name);
+					break;
+
+				case Update::NO_CHANGE:
+				case Update::NOT_MODIFIED:
+				case Update::FAILED:
+				default:
+					break;
+				}
 			}
-		}
+		});
 
-		logger_.notice("Download complete (http=%" PRIu64 "ms, filesystem=%" PRIu64 "ms)", download_time_ / 1000, update_time_ / 1000);
+		changed_ = std::make_unique<Refresh>();
+
+		if (!download_manifest())
+			download_listing();
+
+		save_index();
+
+		logger_.notice("Download complete (http=%" PRIu64 "ms, filesystem=%" PRIu64 "ms)",
+			download_time_.load() / 1000, update_time_.load() / 1000);
 
 		app_.refresh_files(std::move(changed_));
 		done_ = true;
@@ -145,126 +208,418 @@ std::string Download::filename_without_extension(const std::string &filename, co
 	}
 }
 
-void Download::download_buses(const std::string &path) {
-	logger_.debug("Download bus config");
+bool Download::bus_and_profile_from_filename(const std::string &path,
+		std::shared_ptr<LEDBus> &bus, enum led_profile_id &profile_id) {
+	auto filename = filename_without_extension(path, LEDProfile::FILENAME_EXT);
+	auto pos = filename.find('.', 1);
+
+	if (pos == std::string::npos)
+		return false;
+
+	auto bus_name = filename.substr(0, pos);
+	auto profile_name = filename.substr(pos + 1);
+
+	bus = app_.bus(bus_name);
+	if (!bus)
+		return false;
+
+	return LEDProfiles::lc_id(profile_name, profile_id);
+}
 
+void Download::download_listing() {
 	uint64_t start = current_time_us();
-	auto urls = client_.list_urls(url_ + path, [this] (const std::string &path) -> bool {
-		return !!app_.bus(filename_without_extension(path, LEDBusConfig::FILENAME_EXT));
+	auto urls = client_.list_urls(url_, [this] (const std::string &path) -> bool {
+		return types_.find(path) != types_.end();
 	});
 	download_time_ += current_time_us() - start;
 
 	for (auto &url : urls) {
-		logger_.trace("Download bus config: %s", url.c_str());
-		if (update_file(std::string{LEDBusConfig::DIRECTORY_NAME} + "/" + url, url_ + path + url) == Update::MODIFIED)
-			changed_->buses.insert(app_.bus(filename_without_extension(url, LEDBusConfig::FILENAME_EXT)));
+		auto type = types_.find(url);
+
+		if (type != types_.end())
+			download_type(type->first, type->second);
 	}
 }
 
-void Download::download_presets(const std::string &path) {
-	logger_.debug("Download presets");
+void Download::download_type(const std::string &path, const Type &type) {
+	logger_.debug("Download %s", type.description);
 
 	uint64_t start = current_time_us();
-	auto urls = client_.list_urls(url_ + path, [] (const std::string &path) -> bool {
-		auto name = filename_without_extension(path, Preset::FILENAME_EXT);
-		return allowed_file_name(name) && name.length() < Preset::MAX_NAME_LENGTH;
-	});
+	auto urls = client_.list_urls(url_ + path, type.filter);
+	uint64_t list_time = current_time_us() - start;
+	download_time_ += list_time;
+
+	transfer(path, type, list_time, urls);
+}
+
+/*
+ * The manifest is a map of paths (relative to the download URL) to an array
+ * of the size and content hash of each file. Only files that don't match the
+ * local index need to be downloaded.
+ */
+bool Download::download_manifest() {
+	uint64_t start = current_time_us();
+
+	if (!client_.open(url_ + MANIFEST_FILENAME)) {
+		download_time_ += current_time_us() - start;
+		return false;
+	}
+
+	WebClientStream stream{client_};
+	cbor::Reader reader{stream};
+	std::unordered_map<std::string,std::vector<std::string>> pending;
+	size_t files = 0;
+	size_t pending_files = 0;
+	uint64_t entries;
+	bool indefinite;
+
+	if (stream.peek() == 0xd9)
+		cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag);
+
+	if (!cbor::expectMap(reader, &entries, &indefinite) || indefinite) {
+		logger_.err("Manifest does not contain a definite length map");
+		download_time_ += current_time_us() - start;
+		return false;
+	}
+
+	while (entries-- > 0) {
+		std::string path;
+		uint64_t length;
+		uint64_t size;
+		uint64_t hash;
+
+		if (!app::read_text(reader, path)
+				|| !cbor::expectArray(reader, &length, &indefinite)
+				|| indefinite || length != 2
+				|| !cbor::expectUnsignedInt(reader, &size)
+				|| !cbor::expectUnsignedInt(reader, &hash)) {
+			logger_.err("Invalid manifest entry");
+			download_time_ += current_time_us() - start;
+			return false;
+		}
+
+		auto pos = path.find('/');
+
+		if (pos == std::string::npos)
+			continue;
+
+		auto type_path = path.substr(0, pos + 1);
+		auto filename = path.substr(pos + 1);
+		auto type = types_.find(type_path);
+
+		if (type == types_.end() || !type->second.filter(filename))
+			continue;
+
+		files++;
+
+		if (!unchanged(std::string{type->second.directory} + "/" + filename, size, hash)) {
+			pending[type_path].push_back(filename);
+			pending_files++;
+		}
+	}
+
 	download_time_ += current_time_us() - start;
 
-	for (auto &url : urls) {
-		auto name = filename_without_extension(url, Preset::FILENAME_EXT);
+	logger_.debug("Manifest: %zu files (%zu changed) in %" PRIu64 "ms",
+		files, pending_files, (current_time_us() - start) / 1000);
 
-		logger_.trace("Download preset: %s", url.c_str());
+	if (pending_files >= MIN_BUNDLE_FILES)
+		download_bundle(pending);
 
-		switch (update_file(std::string{Preset::DIRECTORY_NAME} + "/" + url, url_ + path + url)) {
-		case Update::MODIFIED:
-			changed_->presets.insert(name);
+	for (auto &entry : pending) {
+		if (!entry.second.empty())
+			transfer(entry.first, types_.at(entry.first), 0, entry.second);
+	}
+
+	return true;
+}
+
+/*
+ * The bundle is a map of paths to the contents of each file. Files that
+ * have been updated are removed from the list of pending files.
+ */
+void Download::download_bundle(std::unordered_map<std::string,std::vector<std::string>> &pending) {
+	uint64_t start = current_time_us();
+	uint64_t update_start = update_time_;
+	size_t updated = 0;
+
+	if (!client_.open(url_ + BUNDLE_FILENAME)) {
+		download_time_ += current_time_us() - start;
+		return;
+	}
+
+	WebClientStream stream{client_};
+	cbor::Reader reader{stream};
+	uint64_t entries;
+	bool indefinite;
+
+	if (stream.peek() == 0xd9)
+		cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag);
+
+	if (!cbor::expectMap(reader, &entries, &indefinite) || indefinite) {
+		logger_.err("Bundle does not contain a definite length map");
+		download_time_ += current_time_us() - start;
+		return;
+	}
+
+	while (entries-- > 0) {
+		std::string path;
+
+		if (!app::read_text(reader, path)
+				|| reader.readDataType() != cbor::DataType::kBytes
+				|| reader.isIndefiniteLength()) {
+			logger_.err("Invalid bundle entry");
 			break;
+		}
+
+		uint64_t len = reader.getLength();
+		auto pos = path.find('/');
+		auto type_path = pos != std::string::npos ? path.substr(0, pos + 1) : "";
+		auto filename = pos != std::string::npos ? path.substr(pos + 1) : "";
+		auto type = pending.find(type_path);
+		bool wanted = false;
+
+		if (type != pending.end()) {
+			auto it = std::find(type->second.begin(), type->second.end(), filename);
+
+			if (it != type->second.end()) {
+				type->second.erase(it);
+				wanted = true;
+			}
+		}
+
+		if (!wanted || len > buffer_->size()) {
+			while (len > 0) {
+				size_t chunk = std::min(len, (uint64_t)buffer_->size());
+
+				if (reader.readBytes(buffer_->begin(), chunk) != chunk)
+					break;
+
+				len -= chunk;
+			}
+
+			if (wanted) {
+				logger_.trace("File %s too large", path.c_str());
+				type->second.push_back(filename);
+			}
+			continue;
+		}
+
+		if (reader.readBytes(buffer_->begin(), len) != len) {
+			logger_.err("Short read from bundle");
+			type->second.push_back(filename);
+			break;
+		}
+
+		auto &file_type = types_.at(type_path);
+		auto result = store_file(std::string{file_type.directory} + "/" + filename,
+			buffer_->begin(), len, "");
+
+		file_type.updated(filename, result);
+		updated++;
+	}
+
+	uint64_t total_time = current_time_us() - start;
+	uint64_t update_time = update_time_ - update_start;
+
+	download_time_ += total_time - update_time;
 
+	logger_.debug("Bundle: %zu files (transfer=%" PRIu64 "ms, filesystem=%" PRIu64 "ms)",
+		updated, (total_time - update_time) / 1000, update_time / 1000);
+}
+
+bool Download::unchanged(const std::string &filename, size_t size, uint64_t hash) {
+	std::shared_lock file_lock{App::file_mutex(filename)};
+	auto file = FS.open(filename.c_str());
+
+	if (size == 0)
+		return !file;
+
+	if (!file || file.size() != size)
+		return false;
+
+	return FileHashIndex::matches(filename, size, hash);
+}
+
+void Download::transfer(const std::string &path, const Type &type, uint64_t list_time_us,
+		const std::vector<std::string> &filenames) {
+	uint64_t start = current_time_us();
+	uint64_t update_start = update_time_;
+	std::vector<Transfer> transfers;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> next{0};
+
+	transfers.reserve(filenames.size());
+
+	for (auto &filename : filenames)
+		transfers.emplace_back(std::string{type.directory} + "/" + filename, url_ + path + filename);
+
+	/* Use additional threads (with their own client and buffer) for concurrent transfers */
+	for (size_t i = 1; i < std::min(MAX_TRANSFERS, transfers.size()); i++) {
+		auto buffer = buffers_->allocate();
+
+		if (!buffer)
+			break;
+
+		try {
+#ifndef ENV_NATIVE
+			auto cfg = esp_pthread_get_default_config();
+			cfg.stack_size = TASK_STACK_SIZE;
+			cfg.prio = uxTaskPriorityGet(nullptr);
+			esp_pthread_set_cfg(&cfg);
+#endif
+
+			threads.emplace_back([this, &transfers, &next, buffer = std::move(buffer)] {
+				try {
+					WebClient client;
+
+					transfer_files(client, *buffer, transfers, next);
+				} catch (...) {
+					logger_.emerg(F("Exception in download thread"));
+				}
+			});
+		} catch (...) {
+			break;
+		}
+	}
+
+	transfer_files(client_, *buffer_, transfers, next);
+
+	for (auto &thread : threads)
+		thread.join();
+
+	size_t modified = 0;
+	size_t not_modified = 0;
+	size_t failed = 0;
+
+	for (size_t i = 0; i < transfers.size(); i++) {
+		switch (transfers[i].result) {
+		case Update::MODIFIED:
 		case Update::DELETED:
-			app_.remove_preset_description(name);
+			modified++;
+			break;
+
+		case Update::NOT_MODIFIED:
+			not_modified++;
 			break;
 
-		case Update::NO_CHANGE:
 		case Update::FAILED:
+			failed++;
+			break;
+
+		case Update::NO_CHANGE:
 		default:
 			break;
 		}
+
+		type.updated(filenames[i], transfers[i].result);
 	}
+
+	logger_.debug("%s: %zu files (%zu modified, %zu not modified, %zu failed) with %zu transfers"
+		" (list=%" PRIu64 "ms, transfer=%" PRIu64 "ms, filesystem=%" PRIu64 "ms)",
+		type.description, transfers.size(), modified, not_modified, failed, threads.size() + 1,
+		list_time_us / 1000, (current_time_us() - start) / 1000,
+		(update_time_ - update_start) / 1000);
 }
 
-bool Download::bus_and_profile_from_filename(const std::string &path,
-		std::shared_ptr<LEDBus> &bus, enum led_profile_id &profile_id) {
-	auto filename = filename_without_extension(path, LEDProfile::FILENAME_EXT);
-	auto pos = filename.find('.', 1);
+void Download::transfer_files(WebClient &client, MemoryBlock &buffer,
+		std::vector<Transfer> &transfers, std::atomic<size_t> &next) {
+	size_t i;
 
-	if (pos == std::string::npos)
-		return false;
+	while ((i = next++) < transfers.size()) {
+		auto &transfer = transfers[i];
 
-	auto bus_name = filename.substr(0, pos);
-	auto profile_name = filename.substr(pos + 1);
+		logger_.trace("Download: %s", transfer.url.c_str());
+		transfer.result = update_file(client, buffer, transfer.filename, transfer.url);
+	}
+}
 
-	bus = app_.bus(bus_name);
-	if (!bus)
-		return false;
+void Download::load_index() {
+	std::shared_lock file_lock{App::file_mutex(INDEX_FILENAME)};
+	auto file = FS.open(INDEX_FILENAME, "r");
 
-	return LEDProfiles::lc_id(profile_name, profile_id);
-}
+	if (!file)
+		return;
 
-void Download::download_profiles(const std::string &path) {
-	logger_.debug("Download bus profiles");
+	cbor::Reader reader{file};
+	uint64_t entries;
+	bool indefinite;
 
-	uint64_t start = current_time_us();
-	auto urls = client_.list_urls(url_ + path, [this] (const std::string &path) -> bool {
-		std::shared_ptr<LEDBus> bus;
-		enum led_profile_id profile_id;
+	if (!cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag))
+		file.seek(0);
 
-		return bus_and_profile_from_filename(path, bus, profile_id);
-	});
-	download_time_ += current_time_us() - start;
+	if (!cbor::expectMap(reader, &entries, &indefinite) || indefinite)
+		return;
 
-	for (auto &url : urls) {
-		logger_.trace("Download bus profile: %s", url.c_str());
-		if (update_file(std::string{LEDProfile::DIRECTORY_NAME} + "/" + url, url_ + path + url) == Update::MODIFIED) {
-			std::shared_ptr<LEDBus> bus;
-			enum led_profile_id profile_id;
+	while (entries-- > 0) {
+		std::string filename;
+		FileInfo info;
+		uint64_t length;
+		uint64_t size;
 
-			if (bus_and_profile_from_filename(url, bus, profile_id))
-				changed_->profiles.insert({bus, profile_id});
-		}
+		if (!app::read_text(reader, filename))
+			break;
+
+		if (!cbor::expectArray(reader, &length, &indefinite) || indefinite || length != 2)
+			break;
+
+		if (!app::read_text(reader, info.etag) || !cbor::expectUnsignedInt(reader, &size))
+			break;
+
+		info.size = size;
+		index_.emplace(std::move(filename), std::move(info));
 	}
 }
 
-void Download::download_scripts(const std::string &path) {
-	logger_.debug("Download scripts");
+void Download::save_index() {
+	std::lock_guard index_lock{index_mutex_};
 
-	uint64_t start = current_time_us();
-	auto urls = client_.list_urls(url_ + path, [] (const std::string &path) -> bool {
-		auto name = filename_without_extension(path, MicroPython::FILENAME_EXT);
-		return allowed_file_name(name) && name.length() < MicroPythonFile::MAX_NAME_LENGTH;
-	});
-	download_time_ += current_time_us() - start;
+	if (!index_modified_)
+		return;
 
-	for (auto &url : urls) {
-		logger_.trace("Download script: %s", url.c_str());
-		if (update_file(std::string{MicroPython::DIRECTORY_NAME} + "/" + url, url_ + path + url) == Update::MODIFIED)
-			changed_->scripts.insert(filename_without_extension(url, MicroPython::FILENAME_EXT));
+	std::unique_lock file_lock{App::file_mutex(INDEX_FILENAME)};
+	auto file = FS.open(INDEX_FILENAME, "w", true);
+
+	if (!file) {
+		logger_.err("Unable to open %s for writing", INDEX_FILENAME);
+		return;
+	}
+
+	cbor::Writer writer{file};
+
+	writer.writeTag(cbor::kSelfDescribeTag);
+	writer.beginMap(index_.size());
+
+	for (auto &entry : index_) {
+		app::write_text(writer, entry.first);
+		writer.beginArray(2);
+		app::write_text(writer, entry.second.etag);
+		writer.writeUnsignedInt(entry.second.size);
+	}
+
+	if (file.getWriteError()) {
+		logger_.err("Failed to write %s: %u", INDEX_FILENAME, file.getWriteError());
+		file.close();
+		FS.remove(INDEX_FILENAME);
 	}
+
+	index_modified_ = false;
 }
 
-ssize_t Download::download_to_buffer(const std::string &url) {
-	if (!client_.open(url))
+ssize_t Download::download_to_buffer(WebClient &client, MemoryBlock &buffer,
+		const std::string &url, const std::string &if_none_match) {
+	if (!client.open(url, if_none_match))
 		return -1;
 
-	ssize_t len = client_.read(reinterpret_cast<char*>(buffer_->begin()), (ssize_t)buffer_->size());
+	ssize_t len = client.read(reinterpret_cast<char*>(buffer.begin()), (ssize_t)buffer.size());
 
 	if (len < 0)
 		return -1;
 
-	if (len == (ssize_t)buffer_->size()) {
+	if (len == (ssize_t)buffer.size()) {
 		char c;
 
-		ssize_t extra_len = client_.read(&c, 1);
+		ssize_t extra_len = client.read(&c, 1);
 
 		if (extra_len > 0)
 			logger_.trace("File %s too large", url.c_str());
@@ -276,73 +631,134 @@ ssize_t Download::download_to_buffer(const std::string &url) {
 	return len;
 }
 
-Download::Update Download::update_file(const std::string &filename, const std::string &url) {
-	uint64_t start = current_time_us();
-	ssize_t len = download_to_buffer(url);
-	if (len < 0)
-		return Update::FAILED;
-	download_time_ += current_time_us() - start;
+Download::Update Download::update_file(WebClient &client, MemoryBlock &buffer,
+		const std::string &filename, const std::string &url) {
+	std::string if_none_match;
 
-	std::unique_lock lock{App::file_mutex()};
-	bool changed = false;
-	bool deleted = false;
+	{
+		std::lock_guard index_lock{index_mutex_};
+		auto it = index_.find(filename);
 
-	start = current_time_us();
+		if (it != index_.end() && !it->second.etag.empty()) {
+			std::shared_lock file_lock{App::file_mutex(filename)};
+			auto file = FS.open(filename.c_str());
 
-	if (len > 0) {
-		auto file = FS.open(filename.c_str());
+			/* Only use the ETag if the file hasn't been modified locally */
+			if (file && file.size() == it->second.size)
+				if_none_match = it->second.etag;
+		}
+	}
 
-		if (file) {
-			changed = (file.size() != (size_t)len);
+	uint64_t start = current_time_us();
+	ssize_t len = download_to_buffer(client, buffer, url, if_none_match);
+	download_time_ += current_time_us() - start;
+	if (len < 0)
+		return client.not_modified() ? Update::NOT_MODIFIED : Update::FAILED;
 
-			if (!changed) {
-				uint8_t data[256];
-				size_t pos = 0;
-				size_t remaining = len;
+	return store_file(filename, buffer.begin(), len, client.etag());
+}
 
-				while (remaining > 0) {
-					size_t block_size = std::min(sizeof(data), remaining);
-					size_t read = file.read(data, block_size);
+/*
+ * Changes are detected by comparing the content hash with the index so that
+ * the existing file doesn't need to be read. Files that aren't in the index
+ * are compared directly and then added to the index. The exclusive lock is
+ * only needed if the file is going to be modified.
+ *
+ * The file is removed from the saved index before it's replaced so that a
+ * restart before the index is saved again causes it to be downloaded again.
+ */
+Download::Update Download::store_file(const std::string &filename,
+		const uint8_t *buffer, size_t len, const std::string &etag) {
+	uint64_t hash = content_hash(buffer, len);
+	bool changed = false;
+	bool deleted = false;
+	bool failed = false;
 
-					if (read != block_size) {
-						changed = true;
-						break;
-					}
+	uint64_t start = current_time_us();
 
-					if (std::memcmp(buffer_->begin() + pos, data, block_size)) {
-						changed = true;
-						break;
-					}
+	{
+		std::shared_lock file_lock{App::file_mutex(filename)};
+		auto file = FS.open(filename.c_str());
 
-					pos += block_size;
-					remaining -= block_size;
-				}
-			}
-		} else {
+		if (len == 0) {
+			changed = !!file;
+		} else if (!file || file.size() != len) {
 			changed = true;
+		} else if (FileHashIndex::contains(filename)) {
+			changed = !FileHashIndex::matches(filename, len, hash);
+		} else {
+			changed = !same_contents(file, buffer, len);
+
+			if (!changed)
+				FileHashIndex::update(filename, len, hash);
 		}
 	}
 
-	if (len == 0) {
+	if (changed && len == 0) {
+		std::unique_lock file_lock{App::file_mutex(filename)};
+
 		if (FS.remove(filename.c_str())) {
 			logger_.info("Deleted %s", filename.c_str());
 			deleted = true;
 		}
+
+		FileHashIndex::remove(filename);
+	} else if (changed && !FileHashIndex::invalidate(filename)) {
+		logger_.err("Unable to remove %s from the file hash index", filename.c_str());
+		changed = false;
+		failed = true;
 	} else if (changed) {
-		auto file = FS.open(filename.c_str(), "w", true);
-		size_t written = file.write(buffer_->begin(), len);
+		/*
+		 * Write to a temporary file first so that the exclusive lock is
+		 * only needed to replace the existing file.
+		 */
+		auto temp_filename = filename + TEMP_FILENAME_EXT;
+		size_t written;
+
+		{
+			std::shared_lock file_lock{App::file_mutex(filename)};
+			auto file = FS.open(temp_filename.c_str(), "w", true);
+
+			written = file.write(buffer, len);
+		}
+
+		std::unique_lock file_lock{App::file_mutex(filename)};
 
-		if (written < (size_t)len) {
+		if (written < len) {
 			logger_.err("Short write (%zu of %zu) updating %s",
 				written, len, filename.c_str());
+			FS.remove(temp_filename.c_str());
 			changed = false;
+			failed = true;
+		} else if (!FS.rename(temp_filename.c_str(), filename.c_str())) {
+			logger_.err("Unable to rename %s to %s",
+				temp_filename.c_str(), filename.c_str());
+			FS.remove(temp_filename.c_str());
+			changed = false;
+			failed = true;
 		} else {
 			logger_.info("Updated %s", filename.c_str());
+			FileHashIndex::update(filename, len, hash);
 		}
 	}
 
 	update_time_ += current_time_us() - start;
 
+	{
+		std::lock_guard index_lock{index_mutex_};
+
+		if (len > 0 && !failed && !etag.empty()) {
+			auto &info = index_[filename];
+
+			if (info.etag != etag || info.size != len) {
+				info = {etag, len};
+				index_modified_ = true;
+			}
+		} else if (index_.erase(filename)) {
+			index_modified_ = true;
+		}
+	}
+
 	if (deleted) {
 		return Update::DELETED;
 	} else if (changed) {
@@ -352,4 +768,23 @@ Download::Update Download::update_file(const std::string &filename, const std::s
 	}
 }
 
+bool Download::same_contents(fs::File &file, const uint8_t *buffer, size_t len) {
+	uint8_t data[256];
+	size_t pos = 0;
+
+	while (pos < len) {
+		size_t block_size = std::min(sizeof(data), len - pos);
+
+		if (file.read(data, block_size) != block_size)
+			return false;
+
+		if (std::memcmp(buffer + pos, data, block_size))
+			return false;
+
+		pos += block_size;
+	}
+
+	return true;
+}
+
 } // namespace aurcor
@@ -0,0 +1,218 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "aurcor/file_hash_index.h"
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+
+#include "app/fs.h"
+#include "app/util.h"
+#include "aurcor/app.h"
+#include "aurcor/util.h"
+
+namespace cbor = qindesign::cbor;
+using app::FS;
+
+#ifndef PSTR_ALIGN
+# define PSTR_ALIGN 4
+#endif
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "file-hashes";
+
+namespace aurcor {
+
+uuid::log::Logger FileHashIndex::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+std::mutex FileHashIndex::mutex_;
+std::unordered_map<std::string,FileHashIndex::Entry> FileHashIndex::entries_;
+std::atomic<bool> FileHashIndex::modified_{false};
+
+size_t FileHashIndex::Writer::write(uint8_t c) {
+	size_t written = out_.write(c);
+
+	if (written) {
+		hash_ = content_hash(&c, 1, hash_);
+		size_++;
+	}
+
+	return written;
+}
+
+size_t FileHashIndex::Writer::write(const uint8_t *buffer, size_t size) {
+	size_t written = out_.write(buffer, size);
+
+	hash_ = content_hash(buffer, written, hash_);
+	size_ += written;
+	return written;
+}
+
+void FileHashIndex::load() {
+	std::shared_lock file_lock{App::file_mutex(FILENAME)};
+	std::lock_guard lock{mutex_};
+	auto file = FS.open(FILENAME, "r");
+
+	entries_.clear();
+
+	if (!file)
+		return;
+
+	cbor::Reader reader{file};
+	uint64_t entries;
+	bool indefinite;
+
+	if (!cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag))
+		file.seek(0);
+
+	if (!cbor::expectMap(reader, &entries, &indefinite) || indefinite) {
+		logger_.err(F("Invalid file hash index"));
+		return;
+	}
+
+	while (entries-- > 0) {
+		std::string filename;
+		uint64_t length;
+		uint64_t size;
+		uint64_t hash;
+
+		if (!app::read_text(reader, filename)
+				|| !cbor::expectArray(reader, &length, &indefinite)
+				|| indefinite || length != 2
+				|| !cbor::expectUnsignedInt(reader, &size)
+				|| !cbor::expectUnsignedInt(reader, &hash)) {
+			logger_.err(F("Invalid file hash index entry"));
+			entries_.clear();
+			return;
+		}
+
+		entries_.emplace(std::move(filename), Entry{(size_t)size, hash});
+	}
+
+	logger_.trace(F("Loaded %zu file hashes"), entries_.size());
+}
+
+bool FileHashIndex::save() {
+	if (!modified_)
+		return true;
+
+	std::unique_lock file_lock{App::file_mutex(FILENAME)};
+	std::lock_guard lock{mutex_};
+	auto file = FS.open(FILENAME, "w", true);
+
+	modified_ = false;
+
+	if (!file) {
+		logger_.err(F("Unable to open %s for writing"), FILENAME);
+		modified_ = true;
+		return false;
+	}
+
+	cbor::Writer writer{file};
+
+	writer.writeTag(cbor::kSelfDescribeTag);
+	writer.beginMap(entries_.size());
+
+	for (auto &entry : entries_) {
+		app::write_text(writer, entry.first);
+		writer.beginArray(2);
+		writer.writeUnsignedInt(entry.second.size);
+		writer.writeUnsignedInt(entry.second.hash);
+	}
+
+	if (file.getWriteError()) {
+		logger_.err(F("Failed to write %s: %u"), FILENAME, file.getWriteError());
+		file.close();
+		FS.remove(FILENAME);
+		modified_ = true;
+		return false;
+	}
+
+	return true;
+}
+
+bool FileHashIndex::matches(const std::string &filename, size_t size, uint64_t hash) {
+	std::lock_guard lock{mutex_};
+	auto it = entries_.find(filename);
+
+	return it != entries_.end() && it->second.size == size && it->second.hash == hash;
+}
+
+bool FileHashIndex::contains(const std::string &filename) {
+	std::lock_guard lock{mutex_};
+
+	return entries_.find(filename) != entries_.end();
+}
+
+void FileHashIndex::update(const std::string &filename, size_t size, uint64_t hash) {
+	std::lock_guard lock{mutex_};
+	auto &entry = entries_[filename];
+
+	if (entry.size != size || entry.hash != hash) {
+		entry = {size, hash};
+		modified_ = true;
+	}
+}
+
+void FileHashIndex::update(const std::string &filename, const Writer &writer) {
+	update(filename, writer.size(), writer.hash());
+}
+
+void FileHashIndex::rename(const std::string &from, const std::string &to) {
+	std::lock_guard lock{mutex_};
+	auto it = entries_.find(from);
+
+	if (it != entries_.end()) {
+		entries_[to] = it->second;
+		entries_.erase(it);
+		modified_ = true;
+	} else if (entries_.erase(to)) {
+		modified_ = true;
+	}
+}
+
+void FileHashIndex::remove(const std::string &filename) {
+	std::lock_guard lock{mutex_};
+
+	if (entries_.erase(filename))
+		modified_ = true;
+}
+
+bool FileHashIndex::invalidate(const std::string &filename) {
+	{
+		std::lock_guard lock{mutex_};
+
+		if (!entries_.erase(filename))
+			return true;
+
+		modified_ = true;
+	}
+
+	return save();
+}
+
+} // namespace aurcor
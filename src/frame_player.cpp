@@ -0,0 +1,251 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aurcor/frame_player.h"
+
+#include <Arduino.h>
+
+#ifndef ENV_NATIVE
+# include <esp_pthread.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uuid/log.h>
+
+#include "app/fs.h"
+#include "aurcor/app.h"
+#include "aurcor/led_bus.h"
+#include "aurcor/led_bus_config.h"
+#include "aurcor/memory_pool.h"
+#include "aurcor/preset.h"
+#include "aurcor/util.h"
+
+#ifndef PSTR_ALIGN
+# define PSTR_ALIGN 4
+#endif
+
+using app::FS;
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "frame-player";
+
+namespace aurcor {
+
+uuid::log::Logger FramePlayer::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::LPR};
+
+bool FramePlayer::supported(const std::string &script) {
+	return script.compare(0, FrameRecording::SCRIPT_PREFIX_LEN, FrameRecording::SCRIPT_PREFIX) == 0
+		&& FrameRecording::valid_name(script.substr(FrameRecording::SCRIPT_PREFIX_LEN));
+}
+
+FramePlayer::FramePlayer(std::shared_ptr<LEDBus> bus, Preset &preset, const std::string &script)
+		: bus_(std::move(bus)), preset_(preset),
+		filename_(supported(script)
+			? FrameRecording::filename(script.substr(FrameRecording::SCRIPT_PREFIX_LEN)) : "") {
+	if (!supported(script)) {
+		logger_.err(F("[%s] Invalid recording script \"%s\""), bus_->name(), script.c_str());
+		running_ = false;
+		return;
+	}
+
+	pixel_map_.load(bus_->name());
+
+	try {
+#ifndef ENV_NATIVE
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+#endif
+
+		thread_ = std::thread{&FramePlayer::run, this};
+	} catch (...) {
+		logger_.emerg("Out of memory");
+		running_ = false;
+	}
+}
+
+FramePlayer::~FramePlayer() {
+	{
+		std::lock_guard lock{mutex_};
+		stop_ = true;
+	}
+
+	cv_.notify_all();
+
+	if (thread_.joinable())
+		thread_.join();
+}
+
+void FramePlayer::run() {
+	try {
+		auto buffer = FrameRecording::allocate();
+
+		if (!buffer) {
+			logger_.err(F("[%s] No buffer available to play file %s"), bus_->name(), filename_.c_str());
+		} else if (play(*buffer)) {
+			return;
+		}
+	} catch (...) {
+		logger_.emerg(F("Exception in frame player thread"));
+	}
+
+	running_ = false;
+}
+
+/* Returns false if there was an error playing the recording */
+bool FramePlayer::play(MemoryBlock &buffer) {
+	uint8_t *data = buffer.begin();
+	const size_t capacity = buffer.size();
+	std::vector<uint8_t> frame;
+	LEDBusFormat format;
+	uint64_t next_us = current_time_us();
+	int len;
+
+	frame.reserve(FrameRecording::MAX_FRAME_SIZE);
+	output_.reserve(LEDBus::MAX_BYTES);
+
+	len = read(0, data, FrameRecording::HEADER_SIZE);
+	if (len < 0)
+		return false;
+
+	if ((size_t)len != FrameRecording::HEADER_SIZE
+			|| !FrameRecording::decode_header(data, stage_, format)) {
+		logger_.err(F("Invalid recording file %s"), filename_.c_str());
+		return false;
+	}
+
+	if (stage_ == FrameRecording::Stage::OUTPUT && format != bus_->format()) {
+		logger_.warning(F("[%s] Recording file %s has format %s instead of %s"),
+			bus_->name(), filename_.c_str(), LEDBusFormats::uc_name(format),
+			LEDBusFormats::uc_name(bus_->format()));
+	}
+
+	while (true) {
+		size_t offset = FrameRecording::HEADER_SIZE;
+		size_t start = 0;
+		size_t end = 0;
+		bool eof = false;
+		size_t frames = 0;
+
+		frame.clear();
+
+		while (true) {
+			/* Keep enough data in the buffer for a complete record */
+			if (!eof && end - start < FrameRecording::MAX_RECORD_SIZE) {
+				std::memmove(data, data + start, end - start);
+				end -= start;
+				start = 0;
+
+				len = read(offset, data + end, capacity - end);
+				if (len < 0)
+					return false;
+
+				eof = (size_t)len < capacity - end;
+				offset += len;
+				end += len;
+			}
+
+			if (start == end)
+				break;
+
+			uint32_t interval_us;
+			size_t length = FrameRecording::decode(data + start, end - start, interval_us, frame);
+
+			if (!length) {
+				logger_.err(F("Invalid frame %zu in recording file %s"), frames, filename_.c_str());
+				return false;
+			}
+
+			start += length;
+			frames++;
+
+			/* The first frame has no interval, so hold the previous frame for one frame */
+			if (!interval_us) {
+				const unsigned int fps = bus_->default_fps();
+
+				interval_us = 1000000U / (fps ? fps : LEDBusConfig::DEFAULT_DEFAULT_FPS);
+			}
+
+			/* Don't try to catch up if frames are late */
+			next_us = std::max(next_us + interval_us, current_time_us());
+
+			if (!wait_until(next_us))
+				return true;
+
+			output(frame);
+		}
+
+		if (!frames) {
+			logger_.err(F("Recording file %s is empty"), filename_.c_str());
+			return false;
+		}
+	}
+}
+
+int FramePlayer::read(size_t offset, uint8_t *data, size_t size) {
+	std::shared_lock file_lock{App::file_mutex(filename_)};
+	auto file = FS.open(filename_.c_str(), "r");
+
+	if (!file || !file.seek(offset)) {
+		logger_.err(F("Unable to read recording file %s"), filename_.c_str());
+		return -1;
+	}
+
+	return file.read(data, size);
+}
+
+bool FramePlayer::wait_until(uint64_t time_us) {
+	std::unique_lock lock{mutex_};
+	const uint64_t now_us = current_time_us();
+
+	if (time_us > now_us)
+		return !cv_.wait_for(lock, std::chrono::microseconds(time_us - now_us), [this] { return stop_; });
+
+	return !stop_;
+}
+
+void FramePlayer::output(const std::vector<uint8_t> &frame) {
+	if (stage_ == FrameRecording::Stage::OUTPUT) {
+		bus_->write(frame.data(), frame.size(), preset_.reverse());
+		return;
+	}
+
+	auto &snapshot = bus_->profile(LED_PROFILE_NORMAL).snapshot(profile_snapshot_);
+
+	if (pixel_map_.empty()) {
+		output_.assign(frame.begin(), frame.end());
+		snapshot.transform(output_.data(), output_.size(), bus_->format());
+	} else {
+		output_.resize(pixel_map_.lut().size() * LEDBus::BYTES_PER_LED);
+		snapshot.transform(frame.data(), frame.size(), output_.data(),
+			pixel_map_.lut().data(), pixel_map_.lut().size(), bus_->format());
+	}
+
+	bus_->write(output_.data(), output_.size(), preset_.reverse());
+}
+
+} // namespace aurcor
@@ -0,0 +1,421 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aurcor/frame_recorder.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include <uuid/common.h>
+#include <uuid/log.h>
+
+#include "app/fs.h"
+#include "aurcor/app.h"
+#include "aurcor/led_bus.h"
+#include "aurcor/memory_pool.h"
+#include "aurcor/util.h"
+
+#ifndef PSTR_ALIGN
+# define PSTR_ALIGN 4
+#endif
+
+using app::FS;
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "frame-recorder";
+
+namespace aurcor {
+
+static_assert(FrameRecording::MAX_FRAME_SIZE == LEDBus::MAX_BYTES, "Maximum frame size must match the bus");
+
+uuid::log::Logger FrameRecorder::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+std::shared_ptr<MemoryPool> FrameRecording::buffers_ = std::make_shared<MemoryPool>(
+	FrameRecording::BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+void FrameRecording::setup(size_t count) {
+	buffers_->resize(count);
+}
+
+std::unique_ptr<MemoryBlock> FrameRecording::allocate() {
+	return buffers_->allocate();
+}
+
+std::vector<std::string> FrameRecording::names() {
+	return list_filenames(DIRECTORY_NAME, FILENAME_EXT);
+}
+
+/* "stop" can't be used because it's the console command to stop recording */
+bool FrameRecording::valid_name(const std::string &name) {
+	return allowed_file_name(name) && name.length() <= MAX_NAME_LENGTH && name != "stop";
+}
+
+bool FrameRecording::exists(const std::string &name) {
+	if (!valid_name(name))
+		return false;
+
+	auto filename = FrameRecording::filename(name);
+	std::shared_lock file_lock{App::file_mutex(filename)};
+	return FS.exists(filename.c_str());
+}
+
+std::string FrameRecording::filename(const std::string &name) {
+	std::string filename;
+
+	filename.append(DIRECTORY_NAME);
+	filename.append("/");
+	filename.append(name);
+	filename.append(FILENAME_EXT);
+
+	return filename;
+}
+
+void FrameRecording::encode_header(uint8_t *data, Stage stage, LEDBusFormat format) {
+	std::memcpy(data, MAGIC, sizeof(MAGIC));
+	data[4] = VERSION;
+	data[5] = static_cast<uint8_t>(stage);
+	data[6] = static_cast<uint8_t>(format);
+	data[7] = 0;
+}
+
+bool FrameRecording::decode_header(const uint8_t *data, Stage &stage, LEDBusFormat &format) {
+#define LED_BUS_FORMAT(_uc_name, _r_idx, _g_idx, _b_idx) +1
+	static constexpr uint8_t NUM_FORMATS = LED_BUS_FORMATS;
+#undef LED_BUS_FORMAT
+
+	if (std::memcmp(data, MAGIC, sizeof(MAGIC)) || data[4] != VERSION)
+		return false;
+
+	if (data[5] > static_cast<uint8_t>(Stage::SCRIPT) || data[6] >= NUM_FORMATS)
+		return false;
+
+	stage = static_cast<Stage>(data[5]);
+	format = static_cast<LEDBusFormat>(data[6]);
+	return true;
+}
+
+uint8_t *FrameRecording::put_varint(uint8_t *pos, uint32_t value) {
+	while (value >= 0x80) {
+		*pos++ = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+
+	*pos++ = value;
+	return pos;
+}
+
+bool FrameRecording::get_varint(const uint8_t *&pos, const uint8_t *end, uint32_t &value) {
+	value = 0;
+
+	for (unsigned int shift = 0; shift < 32; shift += 7) {
+		if (pos == end)
+			return false;
+
+		uint8_t byte = *pos++;
+
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+size_t FrameRecording::encode(uint32_t interval_us, const uint8_t *frame, size_t size,
+		const uint8_t *previous, size_t previous_size, uint8_t *record) {
+	uint8_t *pos = record;
+	size_t literal = 0;
+	size_t i = 0;
+
+	if (previous_size != size)
+		previous = nullptr;
+
+	pos = put_varint(pos, interval_us);
+	pos = put_varint(pos, size);
+
+	auto flush_literal = [&] (size_t end) {
+		if (end > literal) {
+			pos = put_varint(pos, ((end - literal) << 2) | Op::LITERAL);
+			std::memcpy(pos, &frame[literal], end - literal);
+			pos += end - literal;
+		}
+	};
+
+	while (i < size) {
+		size_t skip = 0;
+		size_t repeat = 0;
+
+		if (previous) {
+			while (i + skip < size && frame[i + skip] == previous[i + skip])
+				skip++;
+		}
+
+		if (i >= REPEAT_DISTANCE) {
+			while (i + repeat < size && frame[i + repeat] == frame[i + repeat - REPEAT_DISTANCE])
+				repeat++;
+		}
+
+		if (std::max(skip, repeat) >= MIN_RUN) {
+			const size_t length = std::max(skip, repeat);
+
+			flush_literal(i);
+			pos = put_varint(pos, (length << 2) | (skip >= repeat ? Op::SKIP : Op::REPEAT));
+			i += length;
+			literal = i;
+		} else {
+			i++;
+		}
+	}
+
+	flush_literal(size);
+	return pos - record;
+}
+
+size_t FrameRecording::decode(const uint8_t *record, size_t available,
+		uint32_t &interval_us, std::vector<uint8_t> &frame) {
+	const uint8_t *pos = record;
+	const uint8_t *end = record + available;
+	uint32_t size;
+	size_t i = 0;
+
+	if (!get_varint(pos, end, interval_us) || !get_varint(pos, end, size)
+			|| size > MAX_FRAME_SIZE)
+		return 0;
+
+	if (frame.size() != size)
+		frame.assign(size, 0);
+
+	while (i < size) {
+		uint32_t value;
+
+		if (!get_varint(pos, end, value))
+			return 0;
+
+		const size_t length = value >> 2;
+
+		if (!length || length > size - i)
+			return 0;
+
+		switch (value & 3) {
+		case Op::SKIP:
+			break;
+
+		case Op::LITERAL:
+			if ((size_t)(end - pos) < length)
+				return 0;
+
+			std::memcpy(&frame[i], pos, length);
+			pos += length;
+			break;
+
+		case Op::REPEAT:
+			if (i < REPEAT_DISTANCE)
+				return 0;
+
+			for (size_t j = i; j < i + length; j++)
+				frame[j] = frame[j - REPEAT_DISTANCE];
+			break;
+
+		default:
+			return 0;
+		}
+
+		i += length;
+	}
+
+	return pos - record;
+}
+
+FrameRecorder::FrameRecorder(const LEDBus &bus) : bus_(bus) {
+}
+
+FrameRecorder::~FrameRecorder() {
+	stop();
+}
+
+Result FrameRecorder::start(const std::string &name, FrameRecording::Stage stage) {
+	if (!FrameRecording::valid_name(name))
+		return Result::OUT_OF_RANGE;
+
+	stop();
+
+	auto buffer = FrameRecording::allocate();
+	if (!buffer) {
+		logger_.err(F("[%s] No buffer available for recording"), bus_.name());
+		return Result::FULL;
+	}
+
+	auto filename = FrameRecording::filename(name);
+	std::array<uint8_t,FrameRecording::HEADER_SIZE> header;
+
+	FrameRecording::encode_header(header.data(), stage, bus_.format());
+
+	{
+		std::unique_lock file_lock{App::file_mutex(filename)};
+		auto file = FS.open(filename.c_str(), "w", true);
+
+		if (!file || file.write(header.data(), header.size()) != header.size()) {
+			logger_.err(F("[%s] Unable to create recording file %s"), bus_.name(), filename.c_str());
+			return Result::IO_ERROR;
+		}
+	}
+
+	logger_.info(F("[%s] Recording %s frames to file %s"), bus_.name(),
+		stage == FrameRecording::Stage::SCRIPT ? "script" : "output", filename.c_str());
+
+	std::lock_guard lock{mutex_};
+
+	buffer_ = std::move(buffer);
+	head_ = 0;
+	used_ = 0;
+	previous_.clear();
+	previous_.reserve(FrameRecording::MAX_FRAME_SIZE);
+	record_.resize(FrameRecording::MAX_RECORD_SIZE);
+	last_us_ = 0;
+	frames_ = 0;
+	dropped_frames_ = 0;
+	name_ = name;
+	filename_ = filename;
+	stage_ = stage;
+	flush_time_ms_ = uuid::get_uptime_ms();
+	active_ = true;
+	return Result::OK;
+}
+
+void FrameRecorder::stop() {
+	if (!active_)
+		return;
+
+	{
+		std::lock_guard lock{mutex_};
+		active_ = false;
+	}
+
+	flush(true);
+
+	logger_.info(F("[%s] Recorded %u frames (%u dropped) to file %s"), bus_.name(),
+		frames_.load(), dropped_frames_.load(), filename_.c_str());
+
+	release();
+}
+
+void FrameRecorder::release() {
+	std::lock_guard lock{mutex_};
+
+	active_ = false;
+	buffer_.reset();
+	std::vector<uint8_t>{}.swap(previous_);
+	std::vector<uint8_t>{}.swap(record_);
+}
+
+void FrameRecorder::capture(const uint8_t *data, size_t size) {
+	std::lock_guard lock{mutex_};
+
+	if (!active_)
+		return;
+
+	const uint64_t now_us = current_time_us();
+	const uint32_t interval_us = last_us_ ? std::min(now_us - last_us_, (uint64_t)UINT32_MAX) : 0;
+
+	size = std::min(size, FrameRecording::MAX_FRAME_SIZE);
+
+	const size_t length = FrameRecording::encode(interval_us, data, size,
+		previous_.data(), previous_.size(), record_.data());
+	const size_t capacity = buffer_->size();
+
+	/* The next frame will be encoded relative to the last one that was kept */
+	if (length > capacity - used_) {
+		dropped_frames_++;
+		return;
+	}
+
+	const size_t first = std::min(length, capacity - head_);
+
+	std::memcpy(buffer_->begin() + head_, record_.data(), first);
+	std::memcpy(buffer_->begin(), record_.data() + first, length - first);
+	head_ = (head_ + length) % capacity;
+	used_ += length;
+
+	previous_.assign(data, data + size);
+	last_us_ = now_us;
+	frames_++;
+}
+
+void FrameRecorder::loop() {
+	if (active_ && !flush(false))
+		release();
+}
+
+/*
+ * Only this function removes data from the buffer and capture() only
+ * writes to the unused part of it, so the file can be written without
+ * holding the mutex.
+ */
+bool FrameRecorder::flush(bool force) {
+	size_t tail;
+	size_t used;
+
+	{
+		std::lock_guard lock{mutex_};
+
+		if (!buffer_)
+			return true;
+
+		used = used_;
+		tail = (head_ + buffer_->size() - used_) % buffer_->size();
+	}
+
+	if (!used)
+		return true;
+
+	if (!force && used < FLUSH_SIZE
+			&& uuid::get_uptime_ms() - flush_time_ms_ < FLUSH_INTERVAL_MS)
+		return true;
+
+	const size_t capacity = buffer_->size();
+	const size_t first = std::min(used, capacity - tail);
+	bool ok;
+
+	{
+		std::unique_lock file_lock{App::file_mutex(filename_)};
+		auto file = FS.open(filename_.c_str(), "a");
+
+		ok = file && file.write(buffer_->begin() + tail, first) == first
+			&& file.write(buffer_->begin(), used - first) == used - first;
+	}
+
+	flush_time_ms_ = uuid::get_uptime_ms();
+
+	if (!ok) {
+		logger_.err(F("[%s] Error writing to recording file %s"), bus_.name(), filename_.c_str());
+		return false;
+	}
+
+	std::lock_guard lock{mutex_};
+	used_ -= used;
+	return true;
+}
+
+} // namespace aurcor
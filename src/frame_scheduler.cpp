@@ -0,0 +1,51 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aurcor/frame_scheduler.h"
+
+namespace aurcor {
+
+void FrameScheduler::reset() {
+	started_ = false;
+	last_deadline_us_ = 0;
+}
+
+uint64_t FrameScheduler::deadline_us(uint32_t interval_us, uint64_t now_us) const {
+	if (!started_ || !interval_us)
+		return now_us;
+
+	return last_deadline_us_ + interval_us;
+}
+
+bool FrameScheduler::output(uint64_t deadline_us, uint32_t interval_us, uint64_t start_us) {
+	if (!started_ || !interval_us || start_us <= deadline_us + latency_us_) {
+		started_ = true;
+		last_deadline_us_ = interval_us ? deadline_us : start_us;
+		return false;
+	}
+
+	/*
+	 * Stay in phase with the original deadlines but don't try to catch up on
+	 * the frames that were missed.
+	 */
+	last_deadline_us_ = deadline_us + (start_us - deadline_us) / interval_us * interval_us;
+	missed_deadlines_++;
+	return true;
+}
+
+} // namespace aurcor
@@ -0,0 +1,205 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aurcor/interpolator.h"
+
+#include <Arduino.h>
+
+#ifndef ENV_NATIVE
+# include <esp_pthread.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <uuid/log.h>
+
+#include "aurcor/led_bus.h"
+#include "aurcor/util.h"
+
+#ifndef PSTR_ALIGN
+# define PSTR_ALIGN 4
+#endif
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "interpolator";
+
+namespace aurcor {
+
+uuid::log::Logger Interpolator::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::LPR};
+
+Interpolation::Interpolation(size_t max_bytes) {
+	from_.reserve(max_bytes);
+	to_.reserve(max_bytes);
+	output_.reserve(max_bytes);
+}
+
+void Interpolation::add(const uint8_t *data, size_t size, uint64_t now_us) {
+	if (!output_.empty()) {
+		/* Start from whatever is currently being output */
+		blend(now_us);
+		from_.assign(output_.begin(), output_.end());
+		interval_us_ = std::min(now_us - start_us_, MAX_INTERVAL_US);
+	}
+
+	to_.assign(data, data + size);
+	from_.resize(size);
+	output_.resize(size);
+	start_us_ = now_us;
+	finished_ = false;
+}
+
+bool Interpolation::blend(uint64_t now_us) {
+	if (finished_)
+		return false;
+
+	const uint64_t elapsed_us = now_us - start_us_;
+
+	if (elapsed_us >= interval_us_) {
+		output_.assign(to_.begin(), to_.end());
+		finished_ = true;
+		return true;
+	}
+
+	const uint32_t alpha = elapsed_us * 256 / interval_us_;
+	const size_t size = output_.size();
+
+	for (size_t i = 0; i < size; i++)
+		output_[i] = from_[i] + (((int)to_[i] - (int)from_[i]) * (int)alpha) / 256;
+
+	return true;
+}
+
+Interpolator::Output::Output(std::shared_ptr<LEDBus> bus) : bus(std::move(bus)),
+		frames(LEDBus::MAX_BYTES) {
+	frame.reserve(LEDBus::MAX_BYTES);
+}
+
+Interpolator::Interpolator(std::shared_ptr<LEDBus> bus, std::vector<std::shared_ptr<LEDBus>> group) {
+	try {
+		outputs_.reserve(1 + group.size());
+		outputs_.push_back(std::make_unique<Output>(std::move(bus)));
+		for (auto &member : group)
+			outputs_.push_back(std::make_unique<Output>(std::move(member)));
+
+#ifndef ENV_NATIVE
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+#endif
+
+		thread_ = std::thread{&Interpolator::run, this};
+	} catch (...) {
+		logger_.emerg("Out of memory");
+		throw;
+	}
+}
+
+Interpolator::~Interpolator() {
+	{
+		std::lock_guard lock{mutex_};
+		stop_ = true;
+	}
+
+	cv_.notify_all();
+
+	if (thread_.joinable())
+		thread_.join();
+}
+
+void Interpolator::add(size_t index, const uint8_t *data, size_t size, bool reverse_order) {
+	uint64_t now_us = current_time_us();
+	std::lock_guard lock{mutex_};
+
+	outputs_.at(index)->frames.add(data, size, now_us);
+	reverse_order_ = reverse_order;
+	cv_.notify_all();
+}
+
+bool Interpolator::finished() const {
+	for (auto &output : outputs_) {
+		if (!output->frames.finished())
+			return false;
+	}
+
+	return true;
+}
+
+void Interpolator::run() {
+	try {
+		uint64_t next_us = current_time_us();
+
+		while (true) {
+			bool reverse_order;
+			bool changed = false;
+
+			{
+				std::unique_lock lock{mutex_};
+
+				if (finished())
+					cv_.wait(lock, [this] { return stop_ || !finished(); });
+
+				if (stop_)
+					return;
+
+				const unsigned int fps = std::max(1U, outputs_[0]->bus->default_fps());
+				const uint64_t now_us = current_time_us();
+
+				/* Don't try to catch up if frames are late */
+				next_us = std::max(next_us + 1000000U / fps, now_us);
+
+				if (next_us > now_us
+						&& cv_.wait_for(lock, std::chrono::microseconds(next_us - now_us),
+							[this] { return stop_; }))
+					return;
+
+				const uint64_t blend_us = current_time_us();
+
+				for (auto &output : outputs_) {
+					output->changed = output->frames.blend(blend_us);
+
+					if (output->changed) {
+						auto &frame = output->frames.output();
+
+						output->frame.assign(frame.begin(), frame.end());
+						changed = true;
+					}
+				}
+
+				reverse_order = reverse_order_;
+			}
+
+			if (!changed)
+				continue;
+
+			/* Output the group together */
+			for (auto &output : outputs_) {
+				if (output->changed)
+					output->bus->write(output->frame.data(), output->frame.size(), reverse_order);
+			}
+		}
+	} catch (...) {
+		logger_.emerg(F("Exception in interpolator thread"));
+	}
+}
+
+} // namespace aurcor
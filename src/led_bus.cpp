@@ -24,7 +24,9 @@
 #include <freertos/semphr.h>
 
 #include <algorithm>
+#include <array>
 #include <cstring>
+#include <mutex>
 
 extern "C" {
 	#include <py/obj.h>
@@ -54,9 +56,30 @@ LEDBus::LEDBus(const char *name, size_t default_length)
 			semaphore_ = nullptr;
 		}
 	}
+
+#ifndef ENV_NATIVE
+	esp_timer_create_args_t timer_args{};
+
+	timer_args.callback = tx_timer_callback;
+	timer_args.arg = this;
+	timer_args.dispatch_method = ESP_TIMER_TASK;
+	timer_args.name = name;
+
+	if (esp_timer_create(&timer_args, &tx_timer_) != ESP_OK) {
+		logger_.emerg(F("[%S] Timer init failed"), name);
+		tx_timer_ = nullptr;
+	}
+#endif
 }
 
 LEDBus::~LEDBus() {
+#ifndef ENV_NATIVE
+	if (tx_timer_) {
+		esp_timer_stop(tx_timer_);
+		esp_timer_delete(tx_timer_);
+	}
+#endif
+
 	if (semaphore_) {
 		vSemaphoreDelete(semaphore_);
 	}
@@ -66,19 +89,95 @@ bool LEDBus::ready() const {
 	return !busy_;
 }
 
-void LEDBus::write(const uint8_t *data, size_t size, bool reverse_order) {
+/*
+ * Returns false if the frame was skipped because the previous frame is still
+ * being transmitted (immediately if wait is false).
+ *
+ * Transmission will start at start_us (if it's in the future) without
+ * blocking.
+ */
+bool LEDBus::write(const uint8_t *data, size_t size, bool reverse_order, bool wait, uint64_t start_us) {
 	if (!semaphore_)
-		return;
+		return false;
 
-	if (xSemaphoreTake(semaphore_, SEMAPHORE_TIMEOUT_TICKS) != pdTRUE) {
-		logger_.emerg(F("[%S] Semaphore take timeout"), name_);
-		return;
+	if (xSemaphoreTake(semaphore_, wait ? SEMAPHORE_TIMEOUT_TICKS : 0) != pdTRUE) {
+		if (wait)
+			logger_.emerg(F("[%S] Semaphore take timeout"), name_);
+
+		skipped_frames_++;
+		return false;
 	}
 
 	busy_ = true;
-	last_update_us_ = current_time_us();
 
+	uint64_t now_us = current_time_us();
+
+	if (last_update_us_) {
+		uint32_t interval_us = std::min(now_us - last_update_us_, (uint64_t)UINT32_MAX);
+
+		frame_interval_us_ = interval_us;
+		if (interval_us > max_frame_interval_us_)
+			max_frame_interval_us_ = interval_us;
+	}
+
+	last_update_us_ = now_us;
+	frames_++;
+
+	if (monitor_)
+		monitor_capture(data, size);
+
+	if (recorder_.recording(FrameRecording::Stage::OUTPUT))
+		recorder_.capture(data, size);
+
+	tx_start_us_ = start_us;
 	start(data, size, reverse_order ^ reverse());
+	return true;
+}
+
+void LEDBus::schedule_tx(uint32_t tx_delay_us) {
+	const uint64_t start_us = std::max(tx_start_us_, next_tx_start_us_);
+
+	next_tx_delay_us_ = tx_delay_us;
+
+#ifndef ENV_NATIVE
+	const uint64_t now_us = current_time_us();
+
+	if (start_us > now_us && tx_timer_
+			&& esp_timer_start_once(tx_timer_, start_us - now_us) == ESP_OK)
+		return;
+#endif
+
+	tx_start();
+}
+
+#ifndef ENV_NATIVE
+void LEDBus::tx_timer_callback(void *arg) {
+	reinterpret_cast<LEDBus*>(arg)->tx_start();
+}
+#endif
+
+void LEDBus::monitor_capture(const uint8_t *data, size_t size) {
+	/* Never wait for a reader of the monitor frame */
+	std::unique_lock lock{monitor_mutex_, std::try_to_lock};
+
+	if (!lock.owns_lock())
+		return;
+
+	const size_t leds = std::min(size / BYTES_PER_LED, length());
+	const size_t step = std::max((size_t)1, (leds + MONITOR_MAX_LEDS - 1) / MONITOR_MAX_LEDS);
+	size_t count = 0;
+
+	for (size_t i = 0; i < leds && count < MONITOR_MAX_LEDS; i += step, count++)
+		std::memcpy(&monitor_frame_[count * BYTES_PER_LED], &data[i * BYTES_PER_LED], BYTES_PER_LED);
+
+	monitor_length_ = count;
+}
+
+size_t LEDBus::monitor_frame(std::array<uint8_t,MONITOR_MAX_BYTES> &buffer) {
+	std::lock_guard lock{monitor_mutex_};
+
+	std::memcpy(buffer.data(), monitor_frame_.data(), monitor_length_ * BYTES_PER_LED);
+	return monitor_length_;
 }
 
 void LEDBus::clear() {
@@ -94,6 +193,7 @@ void LEDBus::finish() {
 IRAM_ATTR void LEDBus::finish_isr() {
 	BaseType_t xHigherPriorityTaskWoken{pdFALSE};
 
+	next_tx_start_us_ = current_time_us() + next_tx_delay_us_;
 	busy_ = false;
 	xSemaphoreGiveFromISR(semaphore_, &xHigherPriorityTaskWoken);
 	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
@@ -101,9 +201,13 @@ IRAM_ATTR void LEDBus::finish_isr() {
 
 void LEDBus::loop() {
 	udp_.loop();
+	recorder_.loop();
+	transition_.loop(current_time_us());
 }
 
 void LEDBus::py_start() {
+	scheduler_.reset();
+	cpu_usage_ = 0;
 	udp_.start();
 }
 
@@ -117,6 +221,7 @@ void LEDBus::py_interrupt() {
 
 void LEDBus::py_stop() {
 	udp_.stop();
+	cpu_usage_ = 0;
 }
 
 NullLEDBus::NullLEDBus(const char *name) : LEDBus(name, MAX_LEDS / 10) {
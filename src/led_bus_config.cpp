@@ -35,6 +35,7 @@
 #include "app/fs.h"
 #include "app/util.h"
 #include "aurcor/app.h"
+#include "aurcor/file_hash_index.h"
 #include "aurcor/led_bus_format.h"
 #include "aurcor/led_bus_udp.h"
 #include "aurcor/modaurcor.h"
@@ -62,8 +63,7 @@ LEDBusConfig::LEDBusConfig(const char *bus_name, size_t default_length)
 }
 
 size_t LEDBusConfig::length() const {
-	std::shared_lock data_lock{data_mutex_};
-	return length_;
+	return snapshot_.load().length;
 }
 
 void LEDBusConfig::length(size_t value) {
@@ -71,6 +71,7 @@ void LEDBusConfig::length(size_t value) {
 	if (length_ != value || !length_set_) {
 		length_constrained(value);
 		length_set_ = true;
+		publish_locked();
 		data_lock.unlock();
 		save();
 	}
@@ -81,8 +82,7 @@ void LEDBusConfig::length_constrained(size_t value) {
 }
 
 LEDBusFormat LEDBusConfig::format() const {
-	std::shared_lock data_lock{data_mutex_};
-	return format_;
+	return snapshot_.load().format;
 }
 
 void LEDBusConfig::format(LEDBusFormat value) {
@@ -90,14 +90,14 @@ void LEDBusConfig::format(LEDBusFormat value) {
 	if (format_ != value || !format_set_) {
 		format_ = value;
 		format_set_ = true;
+		publish_locked();
 		data_lock.unlock();
 		save();
 	}
 }
 
 unsigned int LEDBusConfig::reset_time_us() const {
-	std::shared_lock data_lock{data_mutex_};
-	return reset_time_us_;
+	return snapshot_.load().reset_time_us;
 }
 
 void LEDBusConfig::reset_time_us(unsigned int value) {
@@ -105,6 +105,7 @@ void LEDBusConfig::reset_time_us(unsigned int value) {
 	if (reset_time_us_ != value || !reset_time_us_set_) {
 		reset_time_us_constrained(value);
 		reset_time_us_set_ = true;
+		publish_locked();
 		data_lock.unlock();
 		save();
 	}
@@ -115,14 +116,14 @@ void LEDBusConfig::reset_time_us_constrained(unsigned int value) {
 }
 
 bool LEDBusConfig::reverse() const {
-	std::shared_lock data_lock{data_mutex_};
-	return reverse_;
+	return snapshot_.load().reverse;
 }
 
 void LEDBusConfig::reverse(bool value) {
 	std::unique_lock data_lock{data_mutex_};
 	if (reverse_ != value) {
 		reverse_ = value;
+		publish_locked();
 		data_lock.unlock();
 		save();
 	}
@@ -195,10 +196,55 @@ void LEDBusConfig::udp_queue_size_constrained(unsigned int value) {
 	udp_queue_size_ = uint_constrain(value, LEDBusUDP::MAX_QUEUE_SIZE, LEDBusUDP::MIN_QUEUE_SIZE);
 }
 
+Transition::Type LEDBusConfig::transition_type() const {
+	std::shared_lock data_lock{data_mutex_};
+	return transition_type_;
+}
+
+unsigned int LEDBusConfig::transition_ms() const {
+	std::shared_lock data_lock{data_mutex_};
+	return transition_ms_;
+}
+
+void LEDBusConfig::transition(Transition::Type type, unsigned int duration_ms) {
+	std::unique_lock data_lock{data_mutex_};
+	if (transition_type_ != type || transition_ms_ != duration_ms || !transition_ms_set_) {
+		transition_type_ = type;
+		transition_ms_constrained(duration_ms);
+		transition_ms_set_ = true;
+		data_lock.unlock();
+		save();
+	}
+}
+
+void LEDBusConfig::transition_ms_constrained(unsigned int value) {
+	transition_ms_ = uint_constrain(value, Transition::MAX_DURATION_MS);
+}
+
+unsigned int LEDBusConfig::cpu_limit() const {
+	std::shared_lock data_lock{data_mutex_};
+	return cpu_limit_;
+}
+
+void LEDBusConfig::cpu_limit(unsigned int value) {
+	std::unique_lock data_lock{data_mutex_};
+	if (cpu_limit_ != value || !cpu_limit_set_) {
+		cpu_limit_constrained(value);
+		cpu_limit_set_ = true;
+		data_lock.unlock();
+		save();
+	}
+}
+
+void LEDBusConfig::cpu_limit_constrained(unsigned int value) {
+	cpu_limit_ = uint_constrain(value, MAX_CPU_LIMIT, 1);
+}
+
 void LEDBusConfig::reset() {
 	std::unique_lock data_lock{data_mutex_};
 
 	reset_locked();
+	publish_locked();
 	data_lock.unlock();
 	save();
 }
@@ -218,6 +264,20 @@ void LEDBusConfig::reset_locked() {
 	udp_port_set_ = false;
 	udp_queue_size_ = LEDBusUDP::DEFAULT_QUEUE_SIZE;
 	udp_queue_size_set_ = false;
+	transition_type_ = Transition::DEFAULT_TYPE;
+	transition_ms_ = Transition::DEFAULT_DURATION_MS;
+	transition_ms_set_ = false;
+	cpu_limit_ = DEFAULT_CPU_LIMIT;
+	cpu_limit_set_ = false;
+}
+
+void LEDBusConfig::publish_locked() {
+	snapshot_.store({
+		static_cast<uint16_t>(length_),
+		reset_time_us_,
+		format_,
+		reverse_,
+	});
 }
 
 std::string LEDBusConfig::make_filename(const char *bus_name) {
@@ -234,7 +294,7 @@ std::string LEDBusConfig::make_filename(const char *bus_name) {
 bool LEDBusConfig::load() {
 	auto filename = make_filename(bus_name_);
 	std::unique_lock data_lock{data_mutex_};
-	std::shared_lock file_lock{App::file_mutex()};
+	std::shared_lock file_lock{App::file_mutex(filename)};
 
 	logger_.debug(F("Reading config from file %s"), filename.c_str());
 
@@ -247,12 +307,15 @@ bool LEDBusConfig::load() {
 
 		auto result = load(reader);
 
+		publish_locked();
+
 		if (!result) {
 			logger_.err(F("Config file %s contains invalid data that has been ignored"), filename.c_str());
 		}
 
 		return result;
 	} else {
+		publish_locked();
 		logger_.debug(F("Unable to open config file %s for reading"), filename.c_str());
 		return false;
 	}
@@ -339,6 +402,30 @@ bool inline LEDBusConfig::load(cbor::Reader &reader) {
 
 			udp_queue_size_constrained(value);
 			udp_queue_size_set_ = true;
+		} else if (key == "transition") {
+			std::string value;
+
+			if (!app::read_text(reader, value))
+				return false;
+
+			if (!Transition::type(value, transition_type_))
+				return false;
+		} else if (key == "transition_ms") {
+			uint64_t value;
+
+			if (!cbor::expectUnsignedInt(reader, &value))
+				return false;
+
+			transition_ms_constrained(value);
+			transition_ms_set_ = true;
+		} else if (key == "cpu_limit") {
+			uint64_t value;
+
+			if (!cbor::expectUnsignedInt(reader, &value))
+				return false;
+
+			cpu_limit_constrained(value);
+			cpu_limit_set_ = true;
 		} else if (!reader.isWellFormed()) {
 			return false;
 		}
@@ -350,7 +437,7 @@ bool inline LEDBusConfig::load(cbor::Reader &reader) {
 bool LEDBusConfig::save() {
 	auto filename = make_filename(bus_name_);
 	std::shared_lock data_lock{data_mutex_};
-	std::unique_lock file_lock{App::file_mutex()};
+	std::unique_lock file_lock{App::file_mutex(filename)};
 
 	logger_.notice(F("Writing config to file %s"), filename.c_str());
 
@@ -360,7 +447,8 @@ bool LEDBusConfig::save() {
 		return false;
 	}
 
-	cbor::Writer writer{file};
+	FileHashIndex::Writer hashed{file};
+	cbor::Writer writer{hashed};
 
 	writer.writeTag(cbor::kSelfDescribeTag);
 	save(writer);
@@ -369,8 +457,10 @@ bool LEDBusConfig::save() {
 		logger_.err(F("Failed to write config file %s: %u"), filename.c_str(), file.getWriteError());
 		file.close();
 		FS.remove(filename.c_str());
+		FileHashIndex::remove(filename);
 		return false;
 	} else {
+		FileHashIndex::update(filename, hashed);
 		return true;
 	}
 }
@@ -393,6 +483,12 @@ void LEDBusConfig::save(cbor::Writer &writer) {
 		values++;
 	if (udp_queue_size_set_)
 		values++;
+	if (transition_type_ != Transition::DEFAULT_TYPE)
+		values++;
+	if (transition_ms_set_)
+		values++;
+	if (cpu_limit_set_)
+		values++;
 
 	writer.beginMap(values);
 
@@ -433,6 +529,21 @@ void LEDBusConfig::save(cbor::Writer &writer) {
 		app::write_text(writer, "udp_queue_size");
 		writer.writeUnsignedInt(udp_queue_size_);
 	}
+
+	if (transition_type_ != Transition::DEFAULT_TYPE) {
+		app::write_text(writer, "transition");
+		app::write_text(writer, Transition::name(transition_type_));
+	}
+
+	if (transition_ms_set_) {
+		app::write_text(writer, "transition_ms");
+		writer.writeUnsignedInt(transition_ms_);
+	}
+
+	if (cpu_limit_set_) {
+		app::write_text(writer, "cpu_limit");
+		writer.writeUnsignedInt(cpu_limit_);
+	}
 }
 
 } // namespace aurcor
@@ -204,8 +204,9 @@ void LEDBusUDP::receive(bool wait, mp_obj_t packets) {
 		}
 
 		while (!packets_.empty()) {
-			static const std::array<qstr,3> fields{
+			static const std::array<qstr,4> fields{
 				MP_QSTR_receive_ticks64_us,
+				MP_QSTR_receive_ticks30_us,
 				MP_QSTR_source_address,
 				MP_QSTR_data,
 			};
@@ -228,6 +229,7 @@ void LEDBusUDP::receive(bool wait, mp_obj_t packets) {
 
 			std::array<mp_obj_t,fields.size()> items{
 				mp_obj_new_int_from_ll(packet->receive_time_us),
+				MP_OBJ_NEW_SMALL_INT(packet->receive_time_us & (MICROPY_PY_UTIME_TICKS_PERIOD - 1)),
 				mp_obj_new_tuple(tuple.size(), tuple.begin()),
 				mp_obj_new_bytes(packet->data, packet->length),
 			};
@@ -18,6 +18,7 @@
 
 #include "aurcor/led_profile.h"
 
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
@@ -31,6 +32,7 @@
 
 #include "app/fs.h"
 #include "aurcor/app.h"
+#include "aurcor/file_hash_index.h"
 #include "aurcor/led_bus.h"
 #include "aurcor/util.h"
 
@@ -84,8 +86,20 @@ void LEDProfile::print(uuid::console::Shell &shell, size_t limit) const {
 	shell.printfln(print_row, begin, index - 1, ratio.r, ratio.g, ratio.b);
 }
 
+void LEDProfile::transform(uint8_t *data, size_t size, LEDBusFormat format) const {
+	snapshot_.get()->transform(data, size, format);
+}
+
+void LEDProfile::publish_locked() {
+	auto snapshot = std::make_shared<Snapshot>();
+
+	snapshot->ratios_.assign(ratios_.cbegin(), ratios_.cend());
+	snapshot_.publish(std::move(snapshot));
+}
+
+/* The source and destination may be the same buffer */
 template <int R_IDX,int G_IDX, int B_IDX>
-void LEDProfile::transform(uint8_t *data, size_t size) const {
+void LEDProfile::Snapshot::transform(const uint8_t *src, uint8_t *dst, size_t size) const {
 	index_t index = 0;
 	Ratio ratio = DEFAULT_RATIO;
 
@@ -95,22 +109,25 @@ void LEDProfile::transform(uint8_t *data, size_t size) const {
 			++it;
 		}
 
-		const uint8_t r = data[0];
-		const uint8_t g = data[1];
-		const uint8_t b = data[2];
+		const uint8_t r = src[0];
+		const uint8_t g = src[1];
+		const uint8_t b = src[2];
 
-		data[R_IDX] = r * ratio.r / UINT8_MAX;
-		data[G_IDX] = g * ratio.g / UINT8_MAX;
-		data[B_IDX] = b * ratio.b / UINT8_MAX;
+		dst[R_IDX] = r * ratio.r / UINT8_MAX;
+		dst[G_IDX] = g * ratio.g / UINT8_MAX;
+		dst[B_IDX] = b * ratio.b / UINT8_MAX;
 
-		data += LEDBus::BYTES_PER_LED;
+		src += LEDBus::BYTES_PER_LED;
+		dst += LEDBus::BYTES_PER_LED;
 		size -= LEDBus::BYTES_PER_LED;
 	}
 }
 
-void LEDProfile::transform(uint8_t *data, size_t size, LEDBusFormat format) const {
-	std::shared_lock data_lock{data_mutex_};
+void LEDProfile::Snapshot::transform(uint8_t *data, size_t size, LEDBusFormat format) const {
+	transform(data, data, size, format);
+}
 
+void LEDProfile::Snapshot::transform(const uint8_t *src, uint8_t *dst, size_t size, LEDBusFormat format) const {
 	size /= LEDBus::BYTES_PER_LED;
 	size *= LEDBus::BYTES_PER_LED;
 
@@ -125,7 +142,47 @@ void LEDProfile::transform(uint8_t *data, size_t size, LEDBusFormat format) cons
 	switch (format) {
 #define LED_BUS_FORMAT(_uc_name, _r_idx, _g_idx, _b_idx) \
 	case LEDBusFormat::_uc_name: \
-		transform<_r_idx,_g_idx,_b_idx>(data, size); \
+		transform<_r_idx,_g_idx,_b_idx>(src, dst, size); \
+		break;
+
+LED_BUS_FORMATS
+#undef LED_BUS_FORMAT
+	}
+}
+
+template <int R_IDX,int G_IDX, int B_IDX>
+void LEDProfile::Snapshot::transform(const uint8_t *src, size_t src_size,
+		uint8_t *dst, const index_t *lut, size_t length) const {
+	const size_t src_length = src_size / LEDBus::BYTES_PER_LED;
+	Ratio ratio = DEFAULT_RATIO;
+	auto it = ratios_.cbegin();
+
+	for (size_t index = 0; index < length; index++) {
+		if (it != ratios_.cend() && it->first == index) {
+			ratio = it->second;
+			++it;
+		}
+
+		if (lut[index] < src_length) {
+			const uint8_t *data = &src[lut[index] * LEDBus::BYTES_PER_LED];
+
+			dst[R_IDX] = data[0] * ratio.r / UINT8_MAX;
+			dst[G_IDX] = data[1] * ratio.g / UINT8_MAX;
+			dst[B_IDX] = data[2] * ratio.b / UINT8_MAX;
+		} else {
+			dst[0] = dst[1] = dst[2] = 0;
+		}
+
+		dst += LEDBus::BYTES_PER_LED;
+	}
+}
+
+void LEDProfile::Snapshot::transform(const uint8_t *src, size_t src_size,
+		uint8_t *dst, const index_t *lut, size_t length, LEDBusFormat format) const {
+	switch (format) {
+#define LED_BUS_FORMAT(_uc_name, _r_idx, _g_idx, _b_idx) \
+	case LEDBusFormat::_uc_name: \
+		transform<_r_idx,_g_idx,_b_idx>(src, src_size, dst, lut, length); \
 		break;
 
 LED_BUS_FORMATS
@@ -218,7 +275,10 @@ Result LEDProfile::set(unsigned int index, int r, int g, int b) {
 	Ratio ratio{int_to_u8(r), int_to_u8(g), int_to_u8(b)};
 
 	remove(ratios_.find(index));
-	return add(index, ratio);
+
+	auto result = add(index, ratio);
+	publish_locked();
+	return result;
 }
 
 Result LEDProfile::adjust(unsigned int index, int r, int g, int b) {
@@ -233,7 +293,10 @@ Result LEDProfile::adjust(unsigned int index, int r, int g, int b) {
 	ratio.b = std::min(std::max(0, (int)ratio.b + b), UINT8_MAX);
 
 	remove(ratios_.find(index));
-	return add((index_t)index, ratio);
+
+	auto result = add((index_t)index, ratio);
+	publish_locked();
+	return result;
 }
 
 LEDProfile::Ratio LEDProfile::get(index_t index) const {
@@ -277,7 +340,10 @@ Result LEDProfile::copy(unsigned int src, unsigned int dst, bool move) {
 	}
 
 	remove(ratios_.find((index_t)dst));
-	return add((index_t)dst, dst_ratio);
+
+	auto result = add((index_t)dst, dst_ratio);
+	publish_locked();
+	return result;
 }
 
 Result LEDProfile::remove(unsigned int index) {
@@ -287,6 +353,8 @@ Result LEDProfile::remove(unsigned int index) {
 	std::unique_lock data_lock{data_mutex_};
 
 	auto result = remove(ratios_.find((index_t)index));
+	publish_locked();
+
 	if (index == 0) {
 		return Result::OK;
 	} else {
@@ -300,13 +368,19 @@ void LEDProfile::clear() {
 	if (!ratios_.empty()) {
 		ratios_.clear();
 		modified_ = true;
+		publish_locked();
 	}
 }
 
 bool LEDProfile::compact(size_t limit) {
 	std::unique_lock data_lock{data_mutex_};
 
-	return compact_locked(limit);
+	if (compact_locked(limit)) {
+		publish_locked();
+		return true;
+	}
+
+	return false;
 }
 
 bool LEDProfile::compact_locked(size_t limit) {
@@ -360,7 +434,7 @@ Result LEDProfile::load(const char *bus_name, const char *profile_name,
 		bool automatic) {
 	auto filename = make_filename(bus_name, profile_name);
 	std::unique_lock data_lock{data_mutex_};
-	std::shared_lock file_lock{App::file_mutex()};
+	std::shared_lock file_lock{App::file_mutex(filename)};
 
 	logger_.log(automatic ? Level::DEBUG : Level::NOTICE,
 		F("Reading profile from file %s"), filename.c_str());
@@ -374,6 +448,8 @@ Result LEDProfile::load(const char *bus_name, const char *profile_name,
 
 		auto result = load(reader);
 
+		publish_locked();
+
 		switch (result) {
 		case Result::FULL:
 			logger_.err(F("Profile file %s contains too many entries (truncated)"), filename.c_str());
@@ -520,7 +596,7 @@ Result inline LEDProfile::get_ratio_config_ratio_value(
 Result LEDProfile::save(const char *bus_name, const char *profile_name) {
 	auto filename = make_filename(bus_name, profile_name);
 	std::shared_lock data_lock{data_mutex_};
-	std::unique_lock file_lock{App::file_mutex()};
+	std::unique_lock file_lock{App::file_mutex(filename)};
 
 	logger_.notice(F("Writing profile to file %s"), filename.c_str());
 
@@ -530,7 +606,8 @@ Result LEDProfile::save(const char *bus_name, const char *profile_name) {
 		return Result::IO_ERROR;
 	}
 
-	cbor::Writer writer{file};
+	FileHashIndex::Writer hashed{file};
+	cbor::Writer writer{hashed};
 	bool save_default = !ratios_.empty() && ratios_.begin()->first != 0;
 
 	writer.writeTag(cbor::kSelfDescribeTag);
@@ -546,8 +623,10 @@ Result LEDProfile::save(const char *bus_name, const char *profile_name) {
 		logger_.err(F("Failed to write profile file %s: %u"), filename.c_str(), file.getWriteError());
 		file.close();
 		FS.remove(filename.c_str());
+		FileHashIndex::remove(filename);
 		return Result::IO_ERROR;
 	} else {
+		FileHashIndex::update(filename, hashed);
 		modified_ = false;
 		return Result::OK;
 	}
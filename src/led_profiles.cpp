@@ -20,12 +20,15 @@
 
 #include <Arduino.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <mutex>
 #include <vector>
 
 #include "aurcor/led_bus.h"
 #include "aurcor/led_profile.h"
+#include "aurcor/util.h"
 
 namespace aurcor {
 
@@ -98,6 +101,11 @@ Result LEDProfiles::save(enum led_profile_id id) {
 
 Result LEDProfiles::auto_load(enum led_profile_id id, bool reload) {
 	size_t profile = (size_t)id;
+
+	/* Avoid locking for every frame after the profile has been loaded */
+	if (!reload && available_[profile].load(std::memory_order_acquire))
+		return Result::OK;
+
 	std::unique_lock lock{mutex_};
 
 	if (!loaded_[profile]) {
@@ -108,7 +116,12 @@ Result LEDProfiles::auto_load(enum led_profile_id id, bool reload) {
 		lock.unlock();
 	}
 
-	return profiles_[profile].load(bus_name_, lc_names_[profile], !reload);
+	uint64_t start_us = current_time_us();
+	auto result = profiles_[profile].load(bus_name_, lc_names_[profile], !reload);
+
+	load_time_us_[profile] = std::min(current_time_us() - start_us, (uint64_t)UINT32_MAX);
+	available_[profile].store(true, std::memory_order_release);
+	return result;
 }
 
 } // namespace aurcor
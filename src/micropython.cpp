@@ -29,9 +29,11 @@
 #endif
 
 #include <algorithm>
+#include <condition_variable>
 #include <csetjmp>
 #include <cstring>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <string>
 #include <thread>
@@ -92,21 +94,25 @@ std::shared_ptr<MemoryPool> MicroPython::pystacks_ = std::make_shared<MemoryPool
 	MicroPython::PYSTACK_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
 std::shared_ptr<MemoryPool> MicroPython::ledbufs_ = std::make_shared<MemoryPool>(
 	LEDBus::MAX_BYTES, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+#ifdef ENV_NATIVE
+std::atomic<bool> MicroPython::simulated_clock_{false};
+#endif
 
 void MicroPython::setup(size_t pool_count) {
-	heaps_->resize(pool_count);
-	pystacks_->resize(pool_count);
-	ledbufs_->resize(pool_count);
+	heaps_->resize(pool_count + SPARE_COUNT);
+	pystacks_->resize(pool_count + SPARE_COUNT);
+	ledbufs_->resize(pool_count + SPARE_COUNT);
 }
 
 MicroPython::MicroPython(const std::string &name,
-		std::shared_ptr<LEDBus> bus, std::shared_ptr<Preset> preset)
+		std::shared_ptr<LEDBus> bus, std::shared_ptr<Preset> preset,
+		std::vector<std::shared_ptr<LEDBus>> group)
 		: name_(name + "/" + bus->name()), bus_(bus),
 		heap_(std::move(heaps_->allocate())),
 		pystack_(std::move(pystacks_->allocate())),
 		ledbuf_(std::move(ledbufs_->allocate())),
 		preset_(std::move(preset)),
-		modaurcor_(ledbuf_.get(), std::move(bus), *preset_) {
+		modaurcor_(ledbuf_.get(), std::move(bus), std::move(group), *preset_, clock_) {
 	system_exit_exc_.base.type = &mp_type_SystemExit;
 	system_exit_exc_.traceback_alloc = 0;
 	system_exit_exc_.traceback_len = 0;
@@ -118,6 +124,11 @@ MicroPython::MicroPython(const std::string &name,
 		pystack_.reset();
 		ledbuf_.reset();
 	}
+
+#ifdef ENV_NATIVE
+	if (simulated_clock_)
+		clock_.simulate(current_time_us());
+#endif
 }
 
 bool MicroPython::start() {
@@ -144,8 +155,58 @@ bool MicroPython::start() {
 		return false;
 	}
 
+	if (!held_)
+		bus_->py_start();
+
+	return true;
+}
+
+bool MicroPython::prepare() {
+	held_ = true;
+
+	if (!start()) {
+		held_ = false;
+		return false;
+	}
+
+	return true;
+}
+
+bool MicroPython::release() {
+	if (!started_ || stopped_ || !held_ || !running_)
+		return false;
+
 	bus_->py_start();
 
+	{
+		std::lock_guard lock{release_mutex_};
+		held_ = false;
+	}
+	release_cv_.notify_all();
+
+	return true;
+}
+
+bool MicroPython::wait_released() {
+	std::unique_lock lock{release_mutex_};
+
+	if (held_) {
+		MP_THREAD_GIL_EXIT();
+		release_cv_.wait(lock, [this] { return !held_ || !running_; });
+		MP_THREAD_GIL_ENTER();
+
+		cpu_.start(current_time_us());
+	}
+
+	return running_;
+}
+
+bool MicroPython::outgoing() {
+	if (!running_ || stopping_ || held_ || outgoing_)
+		return false;
+
+	outgoing_ = true;
+	modaurcor_.outgoing();
 	return true;
 }
 
@@ -205,6 +266,9 @@ void MicroPython::running_thread() {
 			if (running_ && !::setjmp(abort_)) {
 				logger_.trace(F("[%s] MicroPython running"), name_.c_str());
 
+				cpu_limit_ = bus_->cpu_limit();
+				cpu_.start(current_time_us());
+
 				where_ = "main";
 				main();
 
@@ -239,7 +303,8 @@ void MicroPython::running_thread() {
 		self_ = nullptr;
 		running_ = false;
 
-		bus_->py_stop();
+		if (!held_ && !outgoing_)
+			bus_->py_stop();
 	} catch (...) {
 		logger_.emerg(F("[%s] Exception in MicroPython thread near %s()"), name_.c_str(), where_);
 	}
@@ -276,7 +341,13 @@ void MicroPython::force_exit() {
 			access.disable();
 		}
 
-		shutdown();
+		{
+			std::lock_guard lock{release_mutex_};
+		}
+		release_cv_.notify_all();
+
+		if (!held_ && !outgoing_)
+			shutdown();
 	}
 }
 
@@ -529,8 +600,9 @@ std::unique_ptr<aurcor::micropython::Print> MicroPythonShell::modulogging_print(
 }
 
 MicroPythonFile::MicroPythonFile(const std::string &name,
-		std::shared_ptr<LEDBus> bus, std::shared_ptr<Preset> preset)
-		: MicroPython(name, bus, preset), name_(name), stdout_prefix_(log_prefix('O')),
+		std::shared_ptr<LEDBus> bus, std::shared_ptr<Preset> preset,
+		std::vector<std::shared_ptr<LEDBus>> group)
+		: MicroPython(name, bus, preset, std::move(group)), name_(name), stdout_prefix_(log_prefix('O')),
 		stdout_(logger_, uuid::log::Level::NOTICE, stdout_prefix_), log_prefix_(log_prefix('L')) {
 }
 
@@ -543,8 +615,9 @@ std::vector<std::string> MicroPythonFile::scripts() {
 }
 
 bool MicroPythonFile::exists(const char *name) {
-	std::shared_lock file_lock{App::file_mutex()};
-	return app::FS.exists(script_filename(filename_ext(name).c_str()).c_str());
+	auto filename = script_filename(filename_ext(name).c_str());
+	std::shared_lock file_lock{App::file_mutex(filename)};
+	return app::FS.exists(filename.c_str());
 }
 
 std::string MicroPythonFile::filename_ext(const char *name) {
@@ -562,7 +635,8 @@ void MicroPythonFile::main() {
 		mp_compiled_module_t cm = mp_raw_code_load_file(filename_ext(name_.c_str()).c_str(), context);
 		mp_obj_t module_fun = mp_make_function_from_raw_code(cm.rc, cm.context, NULL);
 
-		mp_call_function_0(module_fun);
+		if (wait_released())
+			mp_call_function_0(module_fun);
 		mp_handle_pending(true);
 		nlr_pop();
 	} else {
@@ -643,6 +717,57 @@ void aurcor::MicroPython::mp_hal_end_atomic_section() {
 	atomic_section_mutex_.unlock();
 }
 
+extern "C" uint64_t mp_hal_clock_us(void) {
+	return MicroPython::current().clock_.now_us();
+}
+
+extern "C" int mp_hal_clock_delay_us(uint64_t us) {
+	auto &mp = MicroPython::current();
+
+	if (mp.clock_.delay_us(us))
+		return 1;
+
+	if (mp.cpu_.wait(current_time_us(), us))
+		mp.cpu_updated();
+
+	return 0;
+}
+
+extern "C" void mp_hal_clock_timeofday(struct timeval *tv) {
+	MicroPython::current().clock_.timeofday(*tv);
+}
+
+extern "C" void mp_hal_vm_hook(void) {
+	MicroPython::current().vm_hook();
+}
+
+/*
+ * Scripts that exceed their CPU limit are made to wait until the end of the
+ * current window so that they can't starve other threads. This must block
+ * (releasing the GIL) instead of using mp_hal_delay_us(), which busy-waits.
+ */
+void aurcor::MicroPython::vm_hook() {
+	if (clock_.simulated())
+		return;
+
+	const uint64_t now_us = current_time_us();
+
+	if (cpu_.update(now_us))
+		cpu_updated();
+
+	const uint64_t wait_us = cpu_.exceeded_us(now_us, cpu_limit_);
+
+	if (wait_us)
+		mp_hal_delay_ms((wait_us + 999) / 1000);
+}
+
+void aurcor::MicroPython::cpu_updated() {
+	cpu_limit_ = bus_->cpu_limit();
+
+	if (!held_ && !outgoing_)
+		bus_->cpu_usage(cpu_.usage());
+}
+
 extern "C" ::mp_lexer_t *mp_lexer_new_from_file(const char *filename) {
 	return mp_lexer_new(qstr_from_str(filename),
 		aurcor::micropython::Reader::from_file(
@@ -684,8 +809,9 @@ extern "C" ::mp_import_stat_t mp_import_stat(const char *path) {
 	if (aurcor::MicroPython::builtin_filename(path))
 		return MP_IMPORT_STAT_NO_EXIST;
 
-	std::shared_lock file_lock{aurcor::App::file_mutex()};
-	auto file = app::FS.open(aurcor::MicroPython::script_filename(path).c_str());
+	auto filename = aurcor::MicroPython::script_filename(path);
+	std::shared_lock file_lock{aurcor::App::file_mutex(filename)};
+	auto file = app::FS.open(filename.c_str());
 	return !file ? MP_IMPORT_STAT_NO_EXIST
 		: (file.isDirectory() ? MP_IMPORT_STAT_DIR : MP_IMPORT_STAT_FILE);
 }
@@ -19,7 +19,6 @@
 #include "aurcor/modaurcor.h"
 
 #ifndef NO_QSTR
-# include <esp_timer.h>
 # include <py/runtime.h>
 # include <py/obj.h>
 # include <py/qstr.h>
@@ -62,12 +61,17 @@ MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(aurcor_exp_hsv_to_rgb_tuple_obj, 1, 3, aurco
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(aurcor_rgb_to_hsv_tuple_obj, 1, 3, aurcor_rgb_to_hsv_tuple);
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(aurcor_rgb_to_exp_hsv_tuple_obj, 1, 3, aurcor_rgb_to_exp_hsv_tuple);
 
-MP_DEFINE_CONST_FUN_OBJ_0(aurcor_length_obj, aurcor_length);
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(aurcor_length_obj, 0, 1, aurcor_length);
+MP_DEFINE_CONST_FUN_OBJ_0(aurcor_buses_obj, aurcor_buses);
 MP_DEFINE_CONST_FUN_OBJ_0(aurcor_default_fps_obj, aurcor_default_fps);
+MP_DEFINE_CONST_FUN_OBJ_0(aurcor_width_obj, aurcor_width);
+MP_DEFINE_CONST_FUN_OBJ_0(aurcor_height_obj, aurcor_height);
+MP_DEFINE_CONST_FUN_OBJ_2(aurcor_xy_obj, aurcor_xy);
 MP_DEFINE_CONST_FUN_OBJ_1(aurcor_register_config_obj, aurcor_register_config);
 MP_DEFINE_CONST_FUN_OBJ_1(aurcor_config_obj, aurcor_config);
 
 MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_next_ticks30_ms_obj, 0, aurcor_next_ticks30_ms);
+MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_next_ticks30_us_obj, 0, aurcor_next_ticks30_us);
 MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_next_ticks64_ms_obj, 0, aurcor_next_ticks64_ms);
 MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_next_ticks64_us_obj, 0, aurcor_next_ticks64_us);
 MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_next_time_obj, 0, aurcor_next_time);
@@ -79,15 +83,19 @@ MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_output_hsv_obj, 1, aurcor_output_hsv);
 MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_output_exp_hsv_obj, 1, aurcor_output_exp_hsv);
 MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_output_defaults_obj, 0, aurcor_output_defaults);
 
+MP_DEFINE_CONST_FUN_OBJ_0(aurcor_frame_obj, aurcor_frame);
+MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_show_obj, 0, aurcor_show);
+MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_layer_obj, 1, aurcor_layer);
+
 MP_DEFINE_CONST_FUN_OBJ_KW(aurcor_udp_receive_obj, 0, aurcor_udp_receive);
 
 mp_obj_t aurcor_ticks64_ms(void) {
-	return mp_obj_new_int_from_ll(esp_timer_get_time() / 1000ULL);
+	return mp_obj_new_int_from_ll(mp_hal_clock_us() / 1000ULL);
 }
 MP_DEFINE_CONST_FUN_OBJ_0(aurcor_ticks64_ms_obj, aurcor_ticks64_ms);
 
 mp_obj_t aurcor_ticks64_us(void) {
-	return mp_obj_new_int_from_ll(esp_timer_get_time());
+	return mp_obj_new_int_from_ll(mp_hal_clock_us());
 }
 MP_DEFINE_CONST_FUN_OBJ_0(aurcor_ticks64_us_obj, aurcor_ticks64_us);
 
@@ -118,10 +126,22 @@ STATIC const mp_rom_map_elem_t aurcor_module_globals_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_MAX_SATURATION),    MP_ROM_INT(AURCOR_MAX_SATURATION) },
 	{ MP_ROM_QSTR(MP_QSTR_MAX_VALUE),         MP_ROM_INT(AURCOR_MAX_VALUE) },
 
+	{ MP_ROM_QSTR(MP_QSTR_OUTPUT_SENT),       MP_ROM_INT(AURCOR_OUTPUT_SENT) },
+	{ MP_ROM_QSTR(MP_QSTR_OUTPUT_SKIPPED),    MP_ROM_INT(AURCOR_OUTPUT_SKIPPED) },
+	{ MP_ROM_QSTR(MP_QSTR_OUTPUT_QUEUED),     MP_ROM_INT(AURCOR_OUTPUT_QUEUED) },
+
+	{ MP_ROM_QSTR(MP_QSTR_MAX_LAYERS),        MP_ROM_INT(AURCOR_MAX_LAYERS) },
+	{ MP_ROM_QSTR(MP_QSTR_BLEND_NONE),        MP_ROM_INT(AURCOR_BLEND_NONE) },
+	{ MP_ROM_QSTR(MP_QSTR_BLEND_ADD),         MP_ROM_INT(AURCOR_BLEND_ADD) },
+	{ MP_ROM_QSTR(MP_QSTR_BLEND_MULTIPLY),    MP_ROM_INT(AURCOR_BLEND_MULTIPLY) },
+	{ MP_ROM_QSTR(MP_QSTR_BLEND_MAX),         MP_ROM_INT(AURCOR_BLEND_MAX) },
+	{ MP_ROM_QSTR(MP_QSTR_BLEND_ALPHA),       MP_ROM_INT(AURCOR_BLEND_ALPHA) },
+
 	{ MP_ROM_QSTR(MP_QSTR_version),           MP_ROM_PTR(&aurcor_version_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_profiles),          MP_ROM_PTR(&aurcor_profiles_module) },
 
 	{ MP_ROM_QSTR(MP_QSTR_next_ticks30_ms),   MP_ROM_PTR(&aurcor_next_ticks30_ms_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_next_ticks30_us),   MP_ROM_PTR(&aurcor_next_ticks30_us_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_next_ticks64_ms),   MP_ROM_PTR(&aurcor_next_ticks64_ms_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_next_ticks64_us),   MP_ROM_PTR(&aurcor_next_ticks64_us_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_next_time),         MP_ROM_PTR(&aurcor_next_time_obj) },
@@ -131,6 +151,7 @@ STATIC const mp_rom_map_elem_t aurcor_module_globals_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_ticks30_add),       MP_ROM_PTR(&mp_utime_ticks_add_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_ticks30_diff),      MP_ROM_PTR(&mp_utime_ticks_diff_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_ticks30_ms),        MP_ROM_PTR(&mp_utime_ticks_ms_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_ticks30_us),        MP_ROM_PTR(&mp_utime_ticks_us_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_ticks64_ms),        MP_ROM_PTR(&aurcor_ticks64_ms_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_ticks64_us),        MP_ROM_PTR(&aurcor_ticks64_us_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_time),              MP_ROM_PTR(&aurcor_time_obj) },
@@ -138,7 +159,11 @@ STATIC const mp_rom_map_elem_t aurcor_module_globals_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_time_us),           MP_ROM_PTR(&aurcor_time_us_obj) },
 
 	{ MP_ROM_QSTR(MP_QSTR_length),            MP_ROM_PTR(&aurcor_length_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_buses),             MP_ROM_PTR(&aurcor_buses_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_default_fps),       MP_ROM_PTR(&aurcor_default_fps_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_width),             MP_ROM_PTR(&aurcor_width_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_height),            MP_ROM_PTR(&aurcor_height_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_xy),                MP_ROM_PTR(&aurcor_xy_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_register_config),   MP_ROM_PTR(&aurcor_register_config_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_config),            MP_ROM_PTR(&aurcor_config_obj) },
 
@@ -156,6 +181,10 @@ STATIC const mp_rom_map_elem_t aurcor_module_globals_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_output_exp_hsv),    MP_ROM_PTR(&aurcor_output_exp_hsv_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_output_defaults),   MP_ROM_PTR(&aurcor_output_defaults_obj) },
 
+	{ MP_ROM_QSTR(MP_QSTR_frame),             MP_ROM_PTR(&aurcor_frame_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_show),              MP_ROM_PTR(&aurcor_show_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_layer),             MP_ROM_PTR(&aurcor_layer_obj) },
+
 	{ MP_ROM_QSTR(MP_QSTR_udp_receive),       MP_ROM_PTR(&aurcor_udp_receive_obj) },
 };
 
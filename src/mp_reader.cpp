@@ -34,7 +34,7 @@ namespace aurcor {
 namespace micropython {
 
 Reader::Reader(const char *filename)
-	: lock_(App::file_mutex()), file_(app::FS.open(filename)) {
+	: lock_(App::file_mutex(filename)), file_(app::FS.open(filename)) {
 }
 
 mp_reader_t Reader::from_file(const char *filename) {
@@ -0,0 +1,444 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aurcor/native_effect.h"
+
+#include <Arduino.h>
+#include <sys/time.h>
+
+#ifndef ENV_NATIVE
+# include <esp_pthread.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uuid/log.h>
+
+#include "aurcor/led_bus.h"
+#include "aurcor/led_bus_config.h"
+#include "aurcor/modaurcor.h"
+#include "aurcor/preset.h"
+#include "aurcor/util.h"
+
+#ifndef PSTR_ALIGN
+# define PSTR_ALIGN 4
+#endif
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "native-effect";
+
+namespace aurcor {
+
+using micropython::PyModule;
+
+/* MicroPython's time functions use an epoch of 2000-01-01 */
+static constexpr uint64_t EPOCH_2000_S = 946684800ULL;
+
+uuid::log::Logger NativeEffect::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::LPR};
+
+const NativeEffect::Renderer::Effect* NativeEffect::Renderer::find(const std::string &script) {
+	static const std::array<Effect,4> effects{{
+		{"static_rgb", Type::STATIC_RGB, true, true},
+		{"hue_fade", Type::HUE_FADE, true, true},
+		{"hue_scroll", Type::HUE_SCROLL, false, true},
+		{"burst_rgb", Type::BURST_RGB, false, false},
+	}};
+
+	for (auto &effect : effects) {
+		if (script == effect.script)
+			return &effect;
+	}
+
+	return nullptr;
+}
+
+bool NativeEffect::Renderer::supported(const std::string &script, const ScriptConfig &config) {
+	const Effect *effect = find(script);
+	bool enabled;
+
+	if (!effect)
+		return false;
+
+	if (effect->sweep && config.get("sweep.enabled", enabled) && enabled)
+		return false;
+
+	if (effect->twinkle && config.get("twinkle.enabled", enabled) && enabled)
+		return false;
+
+	return true;
+}
+
+NativeEffect::NativeEffect(std::shared_ptr<LEDBus> bus, Preset &preset, const std::string &script)
+		: bus_(std::move(bus)), preset_(preset), renderer_(script) {
+	pixel_map_.load(bus_->name());
+	preset_.register_config([this] (ScriptConfig &config) { renderer_.register_config(config); });
+
+	try {
+#ifndef ENV_NATIVE
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+#endif
+
+		thread_ = std::thread{&NativeEffect::run, this};
+	} catch (...) {
+		logger_.emerg("Out of memory");
+		running_ = false;
+	}
+}
+
+NativeEffect::~NativeEffect() {
+	{
+		std::lock_guard lock{mutex_};
+		stop_ = true;
+	}
+
+	cv_.notify_all();
+
+	if (thread_.joinable())
+		thread_.join();
+}
+
+NativeEffect::Renderer::Renderer(const std::string &script) : effect_(*find(script)) {
+}
+
+void NativeEffect::Renderer::register_config(ScriptConfig &config) const {
+	using Type = ScriptConfig::Type;
+
+	switch (effect_.type) {
+	case Type::STATIC_RGB:
+		config.register_property("colours", Type::LIST_RGB).as_s32_list().defaults() = {0};
+		config.register_property("profile", Type::PROFILE).as_profile().set_default(LED_PROFILE_NORMAL);
+		break;
+
+	case Type::HUE_FADE:
+		config.register_property("duration", Type::S32).as_s32().set_default(25000);
+		config.register_property("real_time", Type::BOOL).as_bool().set_default(false);
+		break;
+
+	case Type::HUE_SCROLL:
+		config.register_property("repeat", Type::FLOAT).as_float().set_default(1);
+		config.register_property("duration", Type::S32).as_s32().set_default(25000);
+		config.register_property("real_time", Type::BOOL).as_bool().set_default(false);
+		break;
+
+	case Type::BURST_RGB:
+		config.register_property("colours", Type::LIST_RGB).as_s32_list().defaults() = {0};
+		config.register_property("number", Type::S32).as_s32().set_default(3);
+		config.register_property("fade_rate1", Type::FLOAT).as_float().set_default(0.5);
+		config.register_property("fade_rateN", Type::FLOAT).as_float().set_default(0.75);
+		config.register_property("speed", Type::FLOAT).as_float().set_default(1);
+		config.register_property("duration", Type::S32);
+		config.register_property("real_time", Type::BOOL).as_bool().set_default(false);
+		break;
+	}
+
+	if (effect_.sweep)
+		config.register_property("sweep.enabled", Type::BOOL).as_bool().set_default(false);
+
+	if (effect_.twinkle)
+		config.register_property("twinkle.enabled", Type::BOOL).as_bool().set_default(false);
+}
+
+void NativeEffect::Renderer::read_config(const ScriptConfig &config) {
+	fallback_ = !supported(effect_.script, config);
+
+	if (!config.get("colours", colours_))
+		colours_ = {0};
+
+	if (effect_.type != Type::STATIC_RGB || !config.get("profile", profile_))
+		profile_ = LED_PROFILE_NORMAL;
+
+	has_duration_ = config.get("duration", duration_);
+	if (!has_duration_)
+		duration_ = 25000;
+
+	if (!config.get("real_time", real_time_))
+		real_time_ = false;
+
+	if (!config.get("repeat", repeat_))
+		repeat_ = 1;
+
+	if (!config.get("number", number_))
+		number_ = 3;
+
+	if (!config.get("fade_rate1", fade_rate1_))
+		fade_rate1_ = 0.5;
+
+	if (!config.get("fade_rateN", fade_rateN_))
+		fade_rateN_ = 0.75;
+
+	if (!config.get("speed", speed_))
+		speed_ = 1;
+
+	switch (effect_.type) {
+	case Type::HUE_FADE:
+		duration_ = std::max<int32_t>(2, duration_);
+		break;
+
+	case Type::HUE_SCROLL:
+	case Type::BURST_RGB:
+		if (duration_ == 1)
+			duration_ = 2;
+		break;
+
+	case Type::STATIC_RGB:
+		break;
+	}
+
+	burst_colours_.resize(colours_.size());
+	for (size_t i = 0; i < colours_.size(); i++) {
+		mp_int_t hsv[3];
+
+		PyModule::rgb_to_hsv((colours_[i] >> 16) & 0xFF, (colours_[i] >> 8) & 0xFF,
+			colours_[i] & 0xFF, hsv);
+		burst_colours_[i] = {(int32_t)hsv[0], (int32_t)hsv[1], (int32_t)hsv[2]};
+	}
+
+	burst_fades_.clear();
+}
+
+uint64_t NativeEffect::real_time_us() {
+	struct timeval tv;
+
+	gettimeofday(&tv, nullptr);
+	return (tv.tv_sec - EPOCH_2000_S) * 1000000ULL + tv.tv_usec;
+}
+
+void NativeEffect::run() {
+	try {
+		std::vector<uint8_t> frame;
+		std::vector<uint8_t> mapped;
+		uint64_t next_us = current_time_us();
+
+		frame.reserve(LEDBus::MAX_BYTES);
+		if (!pixel_map_.empty())
+			mapped.resize(pixel_map_.lut().size() * LEDBus::BYTES_PER_LED);
+
+		while (true) {
+			{
+				std::unique_lock lock{mutex_};
+				const unsigned int fps = bus_->default_fps();
+				const uint64_t now_us = current_time_us();
+
+				/* Don't try to catch up if frames are late */
+				next_us = std::max(next_us + 1000000U / (fps ? fps : LEDBusConfig::DEFAULT_DEFAULT_FPS), now_us);
+
+				if (next_us > now_us
+						&& cv_.wait_for(lock, std::chrono::microseconds(next_us - now_us),
+							[this] { return stop_; }))
+					return;
+
+				if (stop_)
+					return;
+			}
+
+			preset_.populate_config([this] (const ScriptConfig &config) { renderer_.read_config(config); });
+
+			if (renderer_.fallback()) {
+				logger_.trace(F("Config for \"%s\" on %s[%s] needs the script"),
+					renderer_.script(), bus_->type(), bus_->name());
+				running_ = false;
+				return;
+			}
+
+			const size_t length = std::min(pixel_map_.empty() ? bus_->length() : pixel_map_.length(), MAX_LEDS);
+			const uint8_t *buffer;
+			size_t size;
+
+			frame.resize(length * LEDBus::BYTES_PER_LED);
+			renderer_.render(frame.data(), length, renderer_.real_time() ? real_time_us() : current_time_us());
+
+			if (bus_->recorder().recording(FrameRecording::Stage::SCRIPT))
+				bus_->recorder().capture(frame.data(), frame.size());
+
+			const auto profile = renderer_.profile();
+			auto &snapshot = bus_->profile(profile).snapshot(profile_snapshots_[profile]);
+
+			if (pixel_map_.empty()) {
+				snapshot.transform(frame.data(), frame.size(), bus_->format());
+				buffer = frame.data();
+				size = frame.size();
+			} else {
+				snapshot.transform(frame.data(), frame.size(), mapped.data(),
+					pixel_map_.lut().data(), pixel_map_.lut().size(), bus_->format());
+				buffer = mapped.data();
+				size = mapped.size();
+			}
+
+			bus_->write(buffer, size, preset_.reverse());
+		}
+	} catch (...) {
+		logger_.emerg(F("Exception in native effect thread"));
+		running_ = false;
+	}
+}
+
+void NativeEffect::Renderer::render(uint8_t *buffer, size_t length, uint64_t now_us) {
+	if (!length)
+		return;
+
+	switch (effect_.type) {
+	case Type::STATIC_RGB:
+		render_static(buffer, length);
+		break;
+
+	case Type::HUE_FADE:
+		render_hue_fade(buffer, length, now_us / 1000U);
+		break;
+
+	case Type::HUE_SCROLL:
+		render_hue_scroll(buffer, length, now_us / 1000U);
+		break;
+
+	case Type::BURST_RGB:
+		render_burst(buffer, length, now_us);
+		break;
+	}
+}
+
+void NativeEffect::Renderer::render_static(uint8_t *buffer, size_t length) const {
+	const size_t count = colours_.size();
+
+	for (size_t i = 0; i < length; i++) {
+		const int32_t colour = colours_[i % count];
+
+		buffer[i * LEDBus::BYTES_PER_LED] = colour >> 16;
+		buffer[i * LEDBus::BYTES_PER_LED + 1] = colour >> 8;
+		buffer[i * LEDBus::BYTES_PER_LED + 2] = colour;
+	}
+}
+
+void NativeEffect::Renderer::render_hue_fade(uint8_t *buffer, size_t length, uint64_t time_ms) const {
+	const mp_int_t hue = PyModule::EXPANDED_HUE_RANGE * (time_ms % duration_) / duration_;
+
+	PyModule::exp_hsv_to_rgb(hue, PyModule::MAX_SATURATION, PyModule::MAX_VALUE, buffer);
+
+	for (size_t i = 1; i < length; i++)
+		std::memcpy(&buffer[i * LEDBus::BYTES_PER_LED], buffer, LEDBus::BYTES_PER_LED);
+}
+
+void NativeEffect::Renderer::render_hue_scroll(uint8_t *buffer, size_t length, uint64_t time_ms) const {
+	const float step = repeat_ / length;
+	const float start = duration_ > 0 ? (float)(time_ms % duration_) / duration_ : 0;
+
+	for (size_t i = 0; i < length; i++) {
+		float hue = start + step * i;
+
+		hue -= std::floor(hue);
+		PyModule::exp_hsv_to_rgb(std::lround(hue * PyModule::EXPANDED_HUE_RANGE) % PyModule::EXPANDED_HUE_RANGE,
+			PyModule::MAX_SATURATION, PyModule::MAX_VALUE, &buffer[i * LEDBus::BYTES_PER_LED]);
+	}
+}
+
+/*
+ * Bursts of each colour move along the LEDs followed by a blank space, with
+ * the output filled from the end.
+ */
+void NativeEffect::Renderer::render_burst(uint8_t *buffer, size_t length, uint64_t time_us) {
+	const size_t burst_count = std::max<int32_t>(1, std::min<int32_t>(length, number_));
+	const size_t colour_count = burst_colours_.size();
+	const size_t active_length = length / (2 + burst_count) / 3;
+	const size_t fade_length = length / (2 + burst_count) / 6;
+	const size_t fade_active_length = fade_length + active_length + 1 + active_length;
+	const size_t fade_active_fade_length = fade_active_length + fade_length;
+	const size_t burst_length = std::max((size_t)1, (fade_length + active_length + length) / burst_count);
+	const size_t blank_length = 1 + length / 9 + length / 18;
+	uint64_t interval_us;
+
+	if (has_duration_) {
+		const size_t total_length = burst_length * burst_count + blank_length;
+
+		interval_us = std::max(1LL, std::llround(duration_ * 1000.0 / total_length));
+	} else {
+		interval_us = std::max(1LL, std::llround(BURST_DURATION_PER_LED_US / std::max(1e-10, (double)speed_)));
+	}
+
+	if (burst_fades_.size() != fade_length) {
+		burst_fades_.resize(fade_length);
+
+		for (size_t n = 0; n < fade_length; n++)
+			burst_fades_[n] = fade_rate1_ * std::pow(fade_rateN_, n);
+	}
+
+	const uint64_t burst_duration_us = burst_length * interval_us;
+	const uint64_t blank_duration_us = blank_length * interval_us;
+	const uint64_t total_burst_duration_us = burst_duration_us * burst_count;
+	const uint64_t total_duration_us = total_burst_duration_us + blank_duration_us;
+	const uint64_t current_us = time_us % total_duration_us;
+	size_t burst_idx = current_us / burst_duration_us;
+	size_t colour_idx = ((time_us / total_duration_us) * burst_count) % colour_count;
+	size_t current_pos;
+
+	if (burst_idx >= burst_count) {
+		current_pos = std::lround(blank_length * ((current_us - total_burst_duration_us) % blank_duration_us)
+			/ (double)blank_duration_us);
+	} else {
+		current_pos = std::lround(burst_length * (current_us % burst_duration_us)
+			/ (double)burst_duration_us);
+	}
+
+	size_t i = length;
+
+	while (i > 0) {
+		if (burst_idx >= burst_count) {
+			for (size_t pos = current_pos; pos < blank_length && i > 0; pos++) {
+				i--;
+				std::memset(&buffer[i * LEDBus::BYTES_PER_LED], 0, LEDBus::BYTES_PER_LED);
+			}
+
+			burst_idx = 0;
+			colour_idx = (colour_idx + burst_count) % colour_count;
+		} else {
+			const auto &colour = burst_colours_[(colour_idx + burst_idx) % colour_count];
+
+			for (size_t pos = current_pos; pos < burst_length && i > 0; pos++) {
+				int32_t value;
+
+				if (pos < fade_length) {
+					value = std::lround(colour[2] * burst_fades_[fade_length - pos - 1]);
+				} else if (pos < fade_active_length) {
+					value = colour[2];
+				} else if (pos < fade_active_fade_length) {
+					value = std::lround(colour[2] * burst_fades_[pos - fade_active_length]);
+				} else {
+					value = 0;
+				}
+
+				i--;
+				PyModule::hsv_to_rgb(colour[0], colour[1], int_constrain(value, PyModule::MAX_VALUE),
+					&buffer[i * LEDBus::BYTES_PER_LED]);
+			}
+
+			burst_idx++;
+		}
+
+		current_pos = 0;
+	}
+}
+
+} // namespace aurcor
@@ -0,0 +1,265 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aurcor/pixel_map.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+
+#include <uuid/log.h>
+
+#include "app/fs.h"
+#include "app/util.h"
+#include "aurcor/app.h"
+#include "aurcor/util.h"
+
+#ifndef PSTR_ALIGN
+# define PSTR_ALIGN 4
+#endif
+
+namespace cbor = qindesign::cbor;
+using app::FS;
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "pixel-map";
+
+namespace aurcor {
+
+uuid::log::Logger PixelMap::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+std::string PixelMap::make_filename(const char *bus_name) {
+	std::string filename;
+
+	filename.append(DIRECTORY_NAME);
+	filename.append("/");
+	filename.append(bus_name);
+	filename.append(FILENAME_EXT);
+
+	return filename;
+}
+
+void PixelMap::clear() {
+	width_ = 0;
+	height_ = 0;
+	lut_.clear();
+	lut_.shrink_to_fit();
+}
+
+Result PixelMap::load(const char *bus_name) {
+	auto filename = make_filename(bus_name);
+	std::shared_lock file_lock{App::file_mutex(filename)};
+
+	clear();
+
+	if (!FS.exists(filename.c_str()))
+		return Result::NOT_FOUND;
+
+	logger_.debug(F("Reading pixel map from file %s"), filename.c_str());
+
+	auto file = FS.open(filename.c_str(), "r");
+	if (file) {
+		cbor::Reader reader{file};
+
+		if (!cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag))
+			file.seek(0);
+
+		auto result = load(reader);
+
+		if (result != Result::OK) {
+			logger_.err(F("Pixel map file %s contains invalid data that has been ignored"), filename.c_str());
+			clear();
+		}
+
+		return result;
+	} else {
+		logger_.err(F("Unable to open pixel map file %s for reading"), filename.c_str());
+		return Result::IO_ERROR;
+	}
+}
+
+Result PixelMap::load(cbor::Reader &reader) {
+	uint64_t entries;
+	bool indefinite;
+	uint64_t width = 0;
+	uint64_t height = 1;
+	bool vertical = false;
+	bool serpentine = false;
+	std::vector<Segment> segments;
+
+	if (!cbor::expectMap(reader, &entries, &indefinite) || indefinite) {
+		if (VERBOSE)
+			logger_.trace(F("File does not contain a definite length map"));
+		return Result::PARSE_ERROR;
+	}
+
+	while (entries-- > 0) {
+		std::string key;
+
+		if (!app::read_text(reader, key))
+			return Result::PARSE_ERROR;
+
+		if (key == "width") {
+			if (!cbor::expectUnsignedInt(reader, &width))
+				return Result::PARSE_ERROR;
+		} else if (key == "height") {
+			if (!cbor::expectUnsignedInt(reader, &height))
+				return Result::PARSE_ERROR;
+		} else if (key == "vertical") {
+			if (!cbor::expectBoolean(reader, &vertical))
+				return Result::PARSE_ERROR;
+		} else if (key == "serpentine") {
+			if (!cbor::expectBoolean(reader, &serpentine))
+				return Result::PARSE_ERROR;
+		} else if (key == "segments") {
+			auto result = load_segments(reader, segments);
+
+			if (result != Result::OK)
+				return result;
+		} else if (!reader.isWellFormed()) {
+			return Result::PARSE_ERROR;
+		}
+	}
+
+	if (!width) {
+		/* A linear mapping of segments */
+		for (auto &segment : segments)
+			width += segment.length;
+	}
+
+	if (width > MAX_LEDS || height > MAX_LEDS)
+		return Result::OUT_OF_RANGE;
+
+	return compile(width, height, vertical, serpentine, segments);
+}
+
+Result PixelMap::load_segments(cbor::Reader &reader, std::vector<Segment> &segments) {
+	uint64_t entries;
+	bool indefinite;
+
+	if (!cbor::expectArray(reader, &entries, &indefinite) || indefinite) {
+		if (VERBOSE)
+			logger_.trace(F("Segments are not a definite length array"));
+		return Result::PARSE_ERROR;
+	}
+
+	if (entries > MAX_LEDS)
+		return Result::FULL;
+
+	segments.reserve(entries);
+
+	while (entries-- > 0) {
+		Segment segment;
+		auto result = load_segment(reader, segment);
+
+		if (result != Result::OK)
+			return result;
+
+		segments.push_back(segment);
+	}
+
+	return Result::OK;
+}
+
+Result PixelMap::load_segment(cbor::Reader &reader, Segment &segment) {
+	uint64_t entries;
+	bool indefinite;
+	uint64_t offset;
+	uint64_t length;
+	bool reverse = false;
+
+	if (!cbor::expectArray(reader, &entries, &indefinite) || indefinite
+			|| entries < 2 || entries > 3) {
+		if (VERBOSE)
+			logger_.trace(F("Segment is not an array of 2 or 3 elements"));
+		return Result::PARSE_ERROR;
+	}
+
+	if (!cbor::expectUnsignedInt(reader, &offset)
+			|| !cbor::expectUnsignedInt(reader, &length)
+			|| (entries == 3 && !cbor::expectBoolean(reader, &reverse)))
+		return Result::PARSE_ERROR;
+
+	if (offset > MAX_LEDS || length > MAX_LEDS - offset) {
+		if (VERBOSE)
+			logger_.trace(F("Segment %" PRIu64 "+%" PRIu64 " is out of range"), offset, length);
+		return Result::OUT_OF_RANGE;
+	}
+
+	segment.offset = offset;
+	segment.length = length;
+	segment.reverse = reverse;
+	return Result::OK;
+}
+
+Result PixelMap::compile(size_t width, size_t height, bool vertical, bool serpentine,
+		const std::vector<Segment> &segments) {
+	const size_t length = width * height;
+	std::vector<index_t> strip;
+
+	clear();
+
+	if (!width || !height || width > MAX_LEDS || height > MAX_LEDS || length > MAX_LEDS)
+		return Result::OUT_OF_RANGE;
+
+	/* Physical index for each position in strip order */
+	if (segments.empty()) {
+		strip.resize(length);
+		for (size_t i = 0; i < length; i++)
+			strip[i] = i;
+	} else {
+		for (auto &segment : segments) {
+			for (size_t i = 0; i < segment.length && strip.size() < length; i++)
+				strip.push_back(segment.reverse
+					? segment.offset + segment.length - 1 - i
+					: segment.offset + i);
+		}
+	}
+
+	if (strip.empty())
+		return Result::OUT_OF_RANGE;
+
+	lut_.assign(*std::max_element(strip.cbegin(), strip.cend()) + 1, UNMAPPED);
+
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			size_t position;
+
+			if (vertical) {
+				position = x * height + ((serpentine && (x & 1)) ? height - 1 - y : y);
+			} else {
+				position = y * width + ((serpentine && (y & 1)) ? width - 1 - x : x);
+			}
+
+			if (position < strip.size())
+				lut_[strip[position]] = y * width + x;
+		}
+	}
+
+	width_ = width;
+	height_ = height;
+	return Result::OK;
+}
+
+} // namespace aurcor
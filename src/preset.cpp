@@ -18,12 +18,15 @@
 
 #include "aurcor/preset.h"
 
+#include <algorithm>
 #include <bitset>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include <CBOR.h>
 #include <CBOR_parsing.h>
@@ -34,7 +37,11 @@
 #include "app/fs.h"
 #include "app/util.h"
 #include "aurcor/app.h"
+#include "aurcor/file_hash_index.h"
+#include "aurcor/frame_player.h"
+#include "aurcor/frame_recorder.h"
 #include "aurcor/micropython.h"
+#include "aurcor/native_effect.h"
 #include "aurcor/util.h"
 
 #ifndef PSTR_ALIGN
@@ -56,6 +63,8 @@ Preset::Preset(App &app, std::shared_ptr<LEDBus> bus, std::string name)
 	reset();
 }
 
+Preset::~Preset() = default;
+
 std::vector<std::string> Preset::names() {
 	return list_filenames(DIRECTORY_NAME, FILENAME_EXT);
 }
@@ -149,6 +158,39 @@ void Preset::reverse(bool reverse) {
 	}
 }
 
+bool Preset::interpolate() const {
+	std::shared_lock data_lock{data_mutex_};
+	return interpolate_;
+}
+
+void Preset::interpolate(bool interpolate) {
+	std::unique_lock data_lock{data_mutex_};
+
+	if (interpolate_ != interpolate) {
+		interpolate_ = interpolate;
+		modified_ = true;
+	}
+}
+
+std::vector<std::string> Preset::group() const {
+	std::shared_lock data_lock{data_mutex_};
+	return group_;
+}
+
+void Preset::group(std::vector<std::string> group) {
+	std::unique_lock data_lock{data_mutex_};
+
+	if (group_ != group) {
+		group_ = std::move(group);
+		modified_ = true;
+		if (running_) {
+			script_changed_ = true;
+		} else {
+			stop_time_ms_ = 0;
+		}
+	}
+}
+
 void Preset::register_config(mp_obj_t dict) {
 	micropython_nlr_begin();
 
@@ -184,6 +226,25 @@ bool Preset::populate_config(mp_obj_t dict) {
 	return ret;
 }
 
+void Preset::register_config(const std::function<void(ScriptConfig&)> &func) {
+	std::unique_lock data_lock{data_mutex_};
+
+	func(config_);
+	config_changed_ = true;
+}
+
+bool Preset::populate_config(const std::function<void(const ScriptConfig&)> &func) {
+	std::shared_lock data_lock{data_mutex_};
+
+	if (config_changed_) {
+		func(config_);
+		config_changed_ = false;
+		return true;
+	}
+
+	return false;
+}
+
 std::vector<std::string> Preset::config_keys(std::bitset<ScriptConfig::Type::INVALID> types) const {
 	std::shared_lock data_lock{data_mutex_};
 	return config_.keys(types);
@@ -242,6 +303,11 @@ Result Preset::set_config(const std::string &key, const std::string &value, size
 	return config_modified(config_.modify(key, value, ScriptConfig::ContainerOp::SET_POSITION, position));
 }
 
+Result Preset::check_config(const std::string &key, const std::string &value) const {
+	std::shared_lock data_lock{data_mutex_};
+	return config_.check(key, value);
+}
+
 Result Preset::unset_config(const std::string &key) {
 	std::unique_lock data_lock{data_mutex_};
 	return config_modified(config_.unset(key));
@@ -315,13 +381,15 @@ void Preset::reset() {
 	description_ = "";
 	script_ = "";
 	reverse_ = false;
+	interpolate_ = false;
+	group_.clear();
 	modified_ = false;
 }
 
 Result Preset::load() {
 	auto filename = make_filename();
 	std::unique_lock data_lock{data_mutex_};
-	std::shared_lock file_lock{App::file_mutex()};
+	std::shared_lock file_lock{App::file_mutex(filename)};
 
 	if (bus_)
 		logger_.info(F("Reading preset from file %s to bus %s"), filename.c_str(), bus_->name());
@@ -373,6 +441,7 @@ Result Preset::load(cbor::Reader &reader) {
 	}
 
 	auto old_script = script_;
+	auto old_group = group_;
 	reset();
 	modified_ = true;
 
@@ -400,6 +469,24 @@ Result Preset::load(cbor::Reader &reader) {
 		} else if (key == "reverse") {
 			if (!cbor::expectBoolean(reader, &reverse_))
 				return Result::PARSE_ERROR;
+		} else if (key == "interpolate") {
+			if (!cbor::expectBoolean(reader, &interpolate_))
+				return Result::PARSE_ERROR;
+		} else if (key == "group") {
+			uint64_t length;
+			bool indefinite;
+
+			if (!cbor::expectArray(reader, &length, &indefinite) || indefinite)
+				return Result::PARSE_ERROR;
+
+			while (length-- > 0) {
+				std::string value;
+
+				if (!app::read_text(reader, value))
+					return Result::PARSE_ERROR;
+
+				group_.push_back(std::move(value));
+			}
 		} else if (key == "config") {
 			result = config_.load(reader);
 			switch (result) {
@@ -418,7 +505,7 @@ Result Preset::load(cbor::Reader &reader) {
 		}
 	}
 
-	if (script_ == old_script)
+	if (script_ == old_script && group_ == old_group)
 		script_changed_ = false;
 
 	if (result == Result::OK)
@@ -432,7 +519,7 @@ Result Preset::save() {
 	if (name_.empty())
 		return Result::NOT_FOUND;
 	auto filename = make_filename();
-	std::unique_lock file_lock{App::file_mutex()};
+	std::unique_lock file_lock{App::file_mutex(filename)};
 
 	logger_.notice(F("Writing preset from bus %s to file %s"), bus_->name(), filename.c_str());
 
@@ -442,7 +529,8 @@ Result Preset::save() {
 		return Result::IO_ERROR;
 	}
 
-	cbor::Writer writer{file};
+	FileHashIndex::Writer hashed{file};
+	cbor::Writer writer{hashed};
 
 	writer.writeTag(cbor::kSelfDescribeTag);
 	save(writer);
@@ -451,8 +539,10 @@ Result Preset::save() {
 		logger_.err(F("Failed to write preset file %s: %u"), filename.c_str(), file.getWriteError());
 		file.close();
 		FS.remove(filename.c_str());
+		FileHashIndex::remove(filename);
 		return Result::IO_ERROR;
 	} else {
+		FileHashIndex::update(filename, hashed);
 		modified_ = false;
 		app_.add_preset_description(*this);
 		return Result::OK;
@@ -460,7 +550,7 @@ Result Preset::save() {
 }
 
 void Preset::save(cbor::Writer &writer) {
-	writer.beginMap(4);
+	writer.beginMap(6);
 
 	app::write_text(writer, "desc");
 	app::write_text(writer, description_);
@@ -471,6 +561,14 @@ void Preset::save(cbor::Writer &writer) {
 	app::write_text(writer, "reverse");
 	writer.writeBoolean(reverse_);
 
+	app::write_text(writer, "interpolate");
+	writer.writeBoolean(interpolate_);
+
+	app::write_text(writer, "group");
+	writer.beginArray(group_.size());
+	for (auto &name : group_)
+		app::write_text(writer, name);
+
 	app::write_text(writer, "config");
 	config_.save(writer);
 }
@@ -484,7 +582,7 @@ Result Preset::rename(const Preset &destination) {
 
 	auto filename_from = make_filename();
 	auto filename_to = destination.make_filename();
-	std::unique_lock file_lock{App::file_mutex()};
+	std::unique_lock file_lock{App::file_mutex(filename_from)};
 
 	if (FS.exists(filename_from.c_str())) {
 		if (FS.exists(filename_to.c_str())) {
@@ -495,6 +593,7 @@ Result Preset::rename(const Preset &destination) {
 
 		logger_.notice(F("Renaming preset file from %s to %s"), filename_from.c_str(), filename_to.c_str());
 		if (FS.rename(filename_from.c_str(), filename_to.c_str())) {
+			FileHashIndex::rename(filename_from, filename_to);
 			name_ = destination.name_;
 			file_lock.unlock();
 			app_.add_preset_description(name_);
@@ -514,11 +613,12 @@ Result Preset::remove() {
 		return Result::NOT_FOUND;
 
 	auto filename = make_filename();
-	std::unique_lock file_lock{App::file_mutex()};
+	std::unique_lock file_lock{App::file_mutex(filename)};
 
 	if (FS.exists(filename.c_str())) {
 		logger_.notice(F("Deleting preset file %s"), filename.c_str());
 		if (FS.remove(filename.c_str())) {
+			FileHashIndex::remove(filename);
 			modified_ = true;
 			app_.remove_preset_description(name_);
 			return Result::OK;
@@ -531,17 +631,102 @@ Result Preset::remove() {
 }
 
 void Preset::loop() {
-	if (running_ && !mp_->running()) {
-		stop_time_ms_ = uuid::get_uptime_ms();
-		running_ = false;
+	if (running_) {
+		if (effect_) {
+			/* Restart immediately if the config now needs the script */
+			if (!effect_->running() || app_.grouped(bus_)) {
+				effect_.reset();
+				stop_time_ms_ = 0;
+				running_ = false;
+			}
+		} else if (player_) {
+			if (!player_->running() || app_.grouped(bus_)) {
+				player_.reset();
+				stop_time_ms_ = uuid::get_uptime_ms();
+				running_ = false;
+			}
+		} else if (!mp_->running()) {
+			stop_time_ms_ = uuid::get_uptime_ms();
+			running_ = false;
+		}
 	}
 
 	if (!restart())
 		return;
 
+	if (!switch_time_ms_)
+		switch_time_ms_ = uuid::get_uptime_ms();
+
+	effect_.reset();
+	player_.reset();
+
+	/* Another preset is using this bus as part of its group */
+	if (app_.grouped(bus_))
+		return;
+
+	/*
+	 * Keep the previous script running in the background while the next
+	 * script starts, if the bus has a transition and there's enough memory
+	 * to run both of them.
+	 */
+	prepare_script();
+	if (next_mp_)
+		app_.transition(bus_);
+
 	if (!app_.detach(bus_))
 		return;
 
+	if (FramePlayer::supported(script_)) {
+		script_changed_ = false;
+
+		logger_.trace(F("Play recording \"%s\" on %s[%s]"),
+			script_.c_str() + FrameRecording::SCRIPT_PREFIX_LEN, bus_->type(), bus_->name());
+
+		scripts_imported_.clear();
+		mp_.reset();
+		player_ = std::make_unique<FramePlayer>(bus_, *this, script_);
+		running_ = true;
+		switch_time_ms_ = 0;
+		return;
+	}
+
+	if (group_.empty() && native_effect_supported()) {
+		script_changed_ = false;
+
+		logger_.trace(F("Run built-in effect \"%s\" on %s[%s]"),
+			script_.c_str(), bus_->type(), bus_->name());
+
+		scripts_imported_.clear();
+		mp_.reset();
+		effect_ = std::make_unique<NativeEffect>(bus_, *this, script_);
+		running_ = true;
+		switch_time_ms_ = 0;
+		return;
+	}
+
+	std::vector<std::shared_ptr<LEDBus>> group;
+	bool members_detached = true;
+
+	/* Stop all of the members concurrently instead of one at a time */
+	for (auto &name : group_) {
+		auto member = app_.bus(name);
+
+		if (!member || member == bus_
+				|| std::find(group.cbegin(), group.cend(), member) != group.cend()) {
+			logger_.warning(F("Ignoring invalid group bus \"%s\" on %s[%s]"),
+				name.c_str(), bus_->type(), bus_->name());
+			continue;
+		}
+
+		if (!app_.detach(member))
+			members_detached = false;
+
+		group.push_back(std::move(member));
+	}
+
+	if (!members_detached)
+		return;
+
 	if (script_changed_) {
 		script_changed_ = false;
 
@@ -552,12 +737,30 @@ void Preset::loop() {
 			script_.c_str(), bus_->type(), bus_->name());
 	}
 
+	const bool prepared = next_mp_ && next_script_ == script_ && group.empty();
+
 	scripts_imported_.clear();
-	mp_ = std::make_shared<MicroPythonFile>(script_, bus_, shared_from_this());
+	if (prepared) {
+		mp_ = std::move(next_mp_);
+	} else {
+		if (next_mp_)
+			app_.dispose(std::move(next_mp_));
+
+		mp_ = std::make_shared<MicroPythonFile>(script_, bus_, shared_from_this(), group);
+	}
+	next_script_.clear();
+
 	app_.attach(bus_, mp_);
+	for (auto &member : group)
+		app_.attach(member, mp_);
 
-	if (mp_->start()) {
+	if (prepared ? mp_->release() : mp_->start()) {
 		running_ = true;
+
+		logger_.debug(F("Started script \"%s\" on %s[%s] after %" PRIu64 "ms%S"),
+			script_.c_str(), bus_->type(), bus_->name(),
+			uuid::get_uptime_ms() - switch_time_ms_, prepared ? F(" (prepared)") : F(""));
+		switch_time_ms_ = 0;
 	} else {
 		running_ = false;
 		app_.detach(bus_, mp_);
@@ -566,6 +769,32 @@ void Preset::loop() {
 	}
 }
 
+/*
+ * Initialise the interpreter for the next script and load it while the
+ * previous script is stopping (or transitioning out), so that it can start
+ * running immediately.
+ */
+void Preset::prepare_script() {
+	if (next_mp_ || next_script_ == script_ || !group_.empty()
+			|| FramePlayer::supported(script_)
+			|| native_effect_supported())
+		return;
+
+	logger_.trace(F("Prepare script \"%s\" on %s[%s]"),
+		script_.c_str(), bus_->type(), bus_->name());
+
+	next_script_ = script_;
+	next_mp_ = std::make_shared<MicroPythonFile>(script_, bus_, shared_from_this());
+	if (!next_mp_->prepare())
+		next_mp_.reset();
+}
+
+bool Preset::native_effect_supported() const {
+	std::shared_lock data_lock{data_mutex_};
+
+	return NativeEffect::supported(script_, config_);
+}
+
 bool Preset::restart() const {
 	if (script_changed_)
 		return true;
@@ -580,9 +809,15 @@ bool Preset::restart() const {
 }
 
 void Preset::restart_script() {
-	if (running_ && mp_->running())
+	if (running_ && mp_ && mp_->running())
 		mp_->stop();
 
+	effect_.reset();
+	player_.reset();
+	if (next_mp_)
+		app_.dispose(std::move(next_mp_));
+	next_script_.clear();
+
 	stop_time_ms_ = 0;
 	running_ = false;
 }
@@ -626,6 +861,11 @@ bool Preset::uses_scripts(const std::unordered_set<std::string> &scripts) const
 void Preset::detach() {
 	running_ = false;
 	mp_.reset();
+	effect_.reset();
+	player_.reset();
+	if (next_mp_)
+		app_.dispose(std::move(next_mp_));
+	next_script_.clear();
 	stop_time_ms_ = uuid::get_uptime_ms();
 }
 
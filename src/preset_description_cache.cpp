@@ -18,7 +18,12 @@
 
 #include "aurcor/preset.h"
 
+#ifndef ENV_NATIVE
+# include <esp_random.h>
+#endif
+
 #include <memory>
+#include <random>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -41,6 +46,11 @@ PresetDescriptionCache::PresetDescriptionCache(App &app) : app_(app) {
 	logger_.trace(F("Creating preset description cache"));
 
 	start_ = current_time_us();
+#ifdef ENV_NATIVE
+	id_ = std::random_device{}();
+#else
+	id_ = esp_random();
+#endif
 	presets_ = std::make_unique<std::vector<std::string>>(Preset::names());
 
 	for (auto &name : *presets_)
@@ -55,8 +65,18 @@ void PresetDescriptionCache::loop() {
 		auto &name = presets_->back();
 		auto preset = std::make_shared<Preset>(app_, nullptr, name);
 
-		if (preset->load() == Result::OK)
-			descriptions_.insert_or_assign(name, preset->description());
+		if (preset->load() == Result::OK) {
+			auto description = preset->description();
+			auto it = descriptions_.find(name);
+
+			if (it == descriptions_.end()) {
+				descriptions_.emplace(name, std::move(description));
+				generation_++;
+			} else if (it->second != description) {
+				it->second = std::move(description);
+				generation_++;
+			}
+		}
 
 		presets_->pop_back();
 	}
@@ -78,6 +98,8 @@ void PresetDescriptionCache::loop() {
 void PresetDescriptionCache::add(const Preset &preset) {
 	auto res = descriptions_.insert_or_assign(preset.name(), preset.description());
 
+	generation_++;
+
 	if (res.second) {
 		logger_.trace(F("Added description of preset %s to cache"), preset.name().c_str());
 	} else {
@@ -109,6 +131,7 @@ void PresetDescriptionCache::remove(const std::string &name) {
 
 	if (it != descriptions_.end()) {
 		descriptions_.erase(it);
+		generation_++;
 		logger_.trace(F("Removed description of preset %s from cache"), name.c_str());
 	}
 }
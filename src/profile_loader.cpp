@@ -0,0 +1,122 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "aurcor/profile_loader.h"
+
+#include <Arduino.h>
+
+#ifndef ENV_NATIVE
+# include <esp_pthread.h>
+#endif
+
+#include <cinttypes>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <uuid/log.h>
+
+#include "aurcor/led_bus.h"
+#include "aurcor/led_profiles.h"
+
+#ifndef PSTR_ALIGN
+# define PSTR_ALIGN 4
+#endif
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "profile-loader";
+
+namespace aurcor {
+
+uuid::log::Logger ProfileLoader::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+ProfileLoader::~ProfileLoader() {
+	if (thread_.joinable())
+		thread_.join();
+}
+
+void ProfileLoader::add(const std::shared_ptr<LEDBus> &bus, enum led_profile_id id, bool reload) {
+	std::lock_guard lock{mutex_};
+
+	pending_.push_back({bus, id, reload});
+}
+
+void ProfileLoader::loop() {
+	if (thread_.joinable()) {
+		if (!done_)
+			return;
+
+		thread_.join();
+	}
+
+	{
+		std::lock_guard lock{mutex_};
+
+		if (pending_.empty())
+			return;
+	}
+
+	try {
+#ifndef ENV_NATIVE
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+#endif
+
+		done_ = false;
+		thread_ = std::thread{&ProfileLoader::run, this};
+	} catch (...) {
+		logger_.emerg("Out of memory");
+	}
+}
+
+void ProfileLoader::run() {
+	try {
+		while (true) {
+			Entry entry;
+
+			{
+				std::lock_guard lock{mutex_};
+
+				if (pending_.empty()) {
+					done_ = true;
+					return;
+				}
+
+				entry = std::move(pending_.front());
+				pending_.pop_front();
+			}
+
+			if (entry.reload) {
+				entry.bus->load_profile(entry.id);
+			} else {
+				entry.bus->profile(entry.id);
+			}
+
+			logger_.trace(F("Loaded profile \"%s\" on %s[%s] in %" PRIu32 "us"),
+				LEDProfiles::lc_name(entry.id), entry.bus->type(), entry.bus->name(),
+				entry.bus->profile_load_time_us(entry.id));
+		}
+	} catch (...) {
+		done_ = true;
+		logger_.emerg(F("Exception in profile loader thread"));
+	}
+}
+
+} // namespace aurcor
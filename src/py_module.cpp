@@ -26,11 +26,14 @@
 # include <cassert>
 # include <cmath>
 # include <cstring>
+# include <new>
+# include <system_error>
 
 extern "C" {
 	# include <py/binary.h>
 	# include <py/runtime.h>
 	# include <py/obj.h>
+	# include <py/objarray.h>
 	# include <py/objtuple.h>
 	# include <py/qstr.h>
 	# include <py/smallint.h>
@@ -38,11 +41,15 @@ extern "C" {
 	# include <shared/timeutils/timeutils.h>
 }
 
+# include "aurcor/clock.h"
+# include "aurcor/compositor.h"
+# include "aurcor/interpolator.h"
 # include "aurcor/led_bus_format.h"
 # include "aurcor/led_profile.h"
 # include "aurcor/led_profiles.h"
 # include "aurcor/memory_pool.h"
 # include "aurcor/micropython.h"
+# include "aurcor/pixel_map.h"
 # include "aurcor/preset.h"
 # include "aurcor/util.h"
 #endif
@@ -56,14 +63,30 @@ using aurcor::micropython::PyModule;
 
 extern "C" {
 
-mp_obj_t aurcor_length() {
-	return PyModule::current().length();
+mp_obj_t aurcor_length(size_t n_args, const mp_obj_t *args) {
+	return PyModule::current().length(n_args, args);
+}
+
+mp_obj_t aurcor_buses() {
+	return PyModule::current().buses();
 }
 
 mp_obj_t aurcor_default_fps() {
 	return PyModule::current().default_fps();
 }
 
+mp_obj_t aurcor_width() {
+	return PyModule::current().width();
+}
+
+mp_obj_t aurcor_height() {
+	return PyModule::current().height();
+}
+
+mp_obj_t aurcor_xy(mp_obj_t x, mp_obj_t y) {
+	return PyModule::current().xy(x, y);
+}
+
 mp_obj_t aurcor_register_config(mp_obj_t dict) {
 	return PyModule::current().register_config(dict);
 }
@@ -76,6 +99,10 @@ mp_obj_t aurcor_next_ticks30_ms(size_t n_args, const mp_obj_t *args, mp_map_t *k
 	return PyModule::current().next_ticks30_ms(n_args, args, kwargs);
 }
 
+mp_obj_t aurcor_next_ticks30_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
+	return PyModule::current().next_ticks30_us(n_args, args, kwargs);
+}
+
 mp_obj_t aurcor_next_ticks64_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
 	return PyModule::current().next_ticks64_ms(n_args, args, kwargs);
 }
@@ -146,6 +173,18 @@ mp_obj_t aurcor_output_defaults(size_t n_args, const mp_obj_t *args, mp_map_t *k
 	return PyModule::current().output_leds(n_args, args, kwargs, PyModule::OutputType::RGB, true);
 }
 
+mp_obj_t aurcor_frame() {
+	return PyModule::current().frame();
+}
+
+mp_obj_t aurcor_show(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
+	return PyModule::current().show(n_args, args, kwargs);
+}
+
+mp_obj_t aurcor_layer(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
+	return PyModule::current().layer(n_args, args, kwargs);
+}
+
 mp_obj_t aurcor_udp_receive(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
 	return PyModule::current().udp_receive(n_args, args, kwargs);
 }
@@ -157,23 +196,64 @@ namespace aurcor {
 namespace micropython {
 
 PyModule::PyModule(MemoryBlock *led_buffer, std::shared_ptr<LEDBus> bus,
-		Preset &preset) : led_buffer_(led_buffer), bus_(std::move(bus)),
+		std::vector<std::shared_ptr<LEDBus>> group, Preset &preset, Clock &clock)
+		: led_buffer_(led_buffer), bus_(std::move(bus)),
 		bus_length_(bus_->length()), bus_format_(bus_->format()),
-		bus_default_fps_(bus_->default_fps()), preset_(preset) {
+		bus_default_fps_(bus_->default_fps()), preset_(preset), clock_(clock),
+		pixel_map_(std::make_unique<PixelMap>()),
+		output_buffer_(led_buffer_ ? led_buffer_->size() : 0) {
+	if (pixel_map_->load(bus_->name()) == Result::OK)
+		map_buffer_.resize(pixel_map_->lut().size() * BYTES_PER_LED);
+
+	group_.reserve(group.size());
+	for (auto &member : group)
+		group_.push_back(std::make_unique<GroupMember>(std::move(member)));
+}
+
+PyModule::~PyModule() {
 }
 
 inline PyModule& PyModule::current() {
 	return MicroPython::current().modaurcor_;
 }
 
-mp_obj_t PyModule::length() {
-	return MP_OBJ_NEW_SMALL_INT(bus_length_);
+mp_obj_t PyModule::length(size_t n_args, const mp_obj_t *args) {
+	size_t index = n_args > 0 ? group_index(mp_obj_get_int(args[0])) : 0;
+
+	if (index > 0)
+		return MP_OBJ_NEW_SMALL_INT(group_[index - 1]->bus->length());
+
+	return MP_OBJ_NEW_SMALL_INT(led_count());
+}
+
+mp_obj_t PyModule::buses() {
+	return MP_OBJ_NEW_SMALL_INT(1 + group_.size());
 }
 
 mp_obj_t PyModule::default_fps() {
 	return MP_OBJ_NEW_SMALL_INT(bus_default_fps_);
 }
 
+mp_obj_t PyModule::width() {
+	return MP_OBJ_NEW_SMALL_INT(pixel_map_->empty() ? led_count() : pixel_map_->width());
+}
+
+mp_obj_t PyModule::height() {
+	return MP_OBJ_NEW_SMALL_INT(pixel_map_->empty() ? 1 : pixel_map_->height());
+}
+
+mp_obj_t PyModule::xy(mp_obj_t x_obj, mp_obj_t y_obj) {
+	const mp_int_t x = mp_obj_get_int(x_obj);
+	const mp_int_t y = mp_obj_get_int(y_obj);
+	const mp_int_t width = pixel_map_->empty() ? led_count() : pixel_map_->width();
+	const mp_int_t height = pixel_map_->empty() ? 1 : pixel_map_->height();
+
+	if (x < 0 || x >= width || y < 0 || y >= height)
+		mp_raise_msg(&mp_type_IndexError, MP_ERROR_TEXT("position out of range"));
+
+	return MP_OBJ_NEW_SMALL_INT(y * width + x);
+}
+
 mp_obj_t PyModule::register_config(mp_obj_t dict) {
 	preset_.register_config(dict);
 	return MP_ROM_NONE;
@@ -220,9 +300,11 @@ mp_obj_t PyModule::output_leds(size_t n_args, const mp_obj_t *args, mp_map_t *kw
 		ARG_reverse,
 
 		ARG_rotate,
+		ARG_block,
+		ARG_bus,
 	};
 	static constexpr size_t N_BEFORE_DEFAULTS = 1;
-	static constexpr size_t N_AFTER_DEFAULTS = 1;
+	static constexpr size_t N_AFTER_DEFAULTS = 3;
 	static const mp_arg_t allowed_args[] = {
 		// BEFORE_DEFAULTS
 		{MP_QSTR_values,      MP_ARG_REQUIRED | MP_ARG_OBJ,   {u_obj: MP_OBJ_NULL}},
@@ -236,6 +318,8 @@ mp_obj_t PyModule::output_leds(size_t n_args, const mp_obj_t *args, mp_map_t *kw
 
 		// AFTER_DEFAULTS
 		{MP_QSTR_rotate,      MP_ARG_KW_ONLY | MP_ARG_INT,    {u_int: 0}},
+		{MP_QSTR_block,       MP_ARG_KW_ONLY | MP_ARG_BOOL,   {u_bool: true}},
+		{MP_QSTR_bus,         MP_ARG_KW_ONLY | MP_ARG_INT,    {u_int: 0}},
 	};
 	const size_t n_allowed_args = MP_ARRAY_SIZE(allowed_args)
 		- (set_defaults ? (N_BEFORE_DEFAULTS + N_AFTER_DEFAULTS) : 0);
@@ -249,17 +333,8 @@ mp_obj_t PyModule::output_leds(size_t n_args, const mp_obj_t *args, mp_map_t *kw
 	auto repeat = set_defaults ? DEFAULT_REPEAT : repeat_;
 	auto reverse = set_defaults ? DEFAULT_REPEAT : reverse_;
 
-	if (parsed_args[ARG_profile].u_obj != MP_ROM_NONE) {
-		if (!mp_obj_is_int(parsed_args[ARG_profile].u_obj))
-			mp_raise_TypeError(MP_ERROR_TEXT("profile must be an int"));
-
-		mp_int_t value = mp_obj_get_int(parsed_args[ARG_profile].u_obj);
-
-		if (!LEDProfiles::valid_id(static_cast<enum led_profile_id>(value)))
-			mp_raise_ValueError(MP_ERROR_TEXT("invalid profile"));
-
-		profile = (enum led_profile_id)value;
-	}
+	if (parsed_args[ARG_profile].u_obj != MP_ROM_NONE)
+		profile = profile_obj_to_id(parsed_args[ARG_profile].u_obj);
 
 	long wait_us = calc_wait_us(parsed_args[ARG_fps].u_obj,
 		parsed_args[ARG_wait_ms].u_obj, parsed_args[ARG_wait_us].u_obj,
@@ -287,10 +362,19 @@ mp_obj_t PyModule::output_leds(size_t n_args, const mp_obj_t *args, mp_map_t *kw
 		return MP_ROM_NONE;
 	}
 
+	const size_t bus_index = group_index(parsed_args[ARG_bus].u_int);
+
+	/* Don't convert the values if they're not going to be used */
+	if (bus_index == 0 && !parsed_args[ARG_block].u_bool && !frame_ready(wait_us)) {
+		skip_frame();
+		return MP_OBJ_NEW_SMALL_INT(AURCOR_OUTPUT_SKIPPED);
+	}
+
 	ssize_t signed_rotate_length = parsed_args[ARG_rotate].u_int;
 	auto values = parsed_args[ARG_values].u_obj;
 	uint8_t *buffer = led_buffer_->begin();
-	const size_t max_bytes = std::min(bus_length_ * BYTES_PER_LED, led_buffer_->size());
+	const size_t max_bytes = bus_index == 0 ? frame_bytes()
+		: std::min(group_[bus_index - 1]->bus->length() * BYTES_PER_LED, led_buffer_->size());
 	size_t in_bytes = max_bytes;
 	size_t out_bytes = 0;
 
@@ -488,18 +572,260 @@ mp_obj_t PyModule::output_leds(size_t n_args, const mp_obj_t *args, mp_map_t *kw
 		out_bytes = max_bytes;
 	}
 
-	bus_->profile(profile).transform(buffer, out_bytes, bus_format_);
+	if (bus_index > 0)
+		return MP_OBJ_NEW_SMALL_INT(stage_leds(bus_index, buffer, out_bytes, profile));
+
+	return MP_OBJ_NEW_SMALL_INT(write_leds(buffer, out_bytes, profile, wait_us,
+		parsed_args[ARG_block].u_bool));
+}
+
+mp_obj_t PyModule::frame() {
+	return mp_obj_new_memoryview('B' | MP_OBJ_ARRAY_TYPECODE_FLAG_RW,
+		frame_bytes(), led_buffer_->begin());
+}
+
+mp_obj_t PyModule::show(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
+	enum {
+		ARG_profile,
+		ARG_fps,
+		ARG_wait_ms,
+		ARG_wait_us,
+		ARG_block,
+	};
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_profile,     MP_ARG_KW_ONLY | MP_ARG_OBJ,    {u_obj: MP_ROM_NONE}},
+		{MP_QSTR_fps,         MP_ARG_KW_ONLY | MP_ARG_OBJ,    {u_obj: MP_ROM_NONE}},
+		{MP_QSTR_wait_ms,     MP_ARG_KW_ONLY | MP_ARG_OBJ,    {u_obj: MP_ROM_NONE}},
+		{MP_QSTR_wait_us,     MP_ARG_KW_ONLY | MP_ARG_OBJ,    {u_obj: MP_ROM_NONE}},
+		{MP_QSTR_block,       MP_ARG_KW_ONLY | MP_ARG_BOOL,   {u_bool: true}},
+	};
+	mp_arg_val_t parsed_args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all(n_args, args, kwargs, MP_ARRAY_SIZE(allowed_args),
+		allowed_args, parsed_args);
+
+	auto profile = profile_;
+
+	if (parsed_args[ARG_profile].u_obj != MP_ROM_NONE)
+		profile = profile_obj_to_id(parsed_args[ARG_profile].u_obj);
+
+	long wait_us = calc_wait_us(parsed_args[ARG_fps].u_obj,
+		parsed_args[ARG_wait_ms].u_obj, parsed_args[ARG_wait_us].u_obj, false);
+
+	return MP_OBJ_NEW_SMALL_INT(write_leds(led_buffer_->begin(), frame_bytes(),
+		profile, wait_us, parsed_args[ARG_block].u_bool));
+}
+
+mp_obj_t PyModule::layer(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
+	enum {
+		ARG_index,
+		ARG_mode,
+		ARG_opacity,
+	};
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_index,       MP_ARG_REQUIRED | MP_ARG_INT,   {u_int: 0}},
+		{MP_QSTR_mode,        MP_ARG_KW_ONLY | MP_ARG_INT,    {u_int: AURCOR_BLEND_ADD}},
+		{MP_QSTR_opacity,     MP_ARG_KW_ONLY | MP_ARG_INT,    {u_int: Compositor::MAX_OPACITY}},
+	};
+	mp_arg_val_t parsed_args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all(n_args, args, kwargs, MP_ARRAY_SIZE(allowed_args),
+		allowed_args, parsed_args);
+
+	const mp_int_t index = parsed_args[ARG_index].u_int;
+	const mp_int_t mode = parsed_args[ARG_mode].u_int;
+
+	if (index < 0 || index >= (mp_int_t)Compositor::MAX_LAYERS)
+		mp_raise_msg(&mp_type_IndexError, MP_ERROR_TEXT("layer index out of range"));
+
+	if (!Compositor::valid(mode))
+		mp_raise_ValueError(MP_ERROR_TEXT("invalid blend mode"));
+
+	uint8_t *data = nullptr;
+
+	try {
+		if (!compositor_)
+			compositor_ = std::make_unique<Compositor>(LEDBus::MAX_BYTES);
+
+		data = compositor_->layer(index, static_cast<Compositor::Blend>(mode),
+			int_to_u8(parsed_args[ARG_opacity].u_int));
+	} catch (const std::bad_alloc&) {}
+
+	if (!data)
+		mp_raise_msg(&mp_type_MemoryError, MP_ERROR_TEXT("not enough memory for layer"));
+
+	return mp_obj_new_memoryview('B' | MP_OBJ_ARRAY_TYPECODE_FLAG_RW,
+		frame_bytes(), data);
+}
+
+/*
+ * The outgoing script of a transition no longer has access to the bus, so
+ * it paces itself independently of the incoming script.
+ */
+const FrameScheduler& PyModule::scheduler() const {
+	return outgoing_ ? outgoing_scheduler_ : bus_->scheduler();
+}
+
+uint32_t PyModule::frame_interval_us(long wait_us) const {
+	if (outgoing_)
+		return wait_us > 0 ? wait_us : default_interval_us();
+
+	return std::max(0L, wait_us);
+}
+
+uint64_t PyModule::frame_deadline_us(long wait_us, uint64_t now_us) const {
+	return scheduler().deadline_us(frame_interval_us(wait_us), now_us);
+}
+
+bool PyModule::frame_ready(long wait_us) const {
+	uint64_t now_us = clock_.now_us();
+
+	return frame_deadline_us(wait_us, now_us) <= now_us + latency_us()
+		&& (outgoing_ || interpolator_ || (bus_->ready() && group_ready()));
+}
+
+/* Frames skipped by the outgoing script aren't counted against the bus */
+void PyModule::skip_frame() {
+	if (!outgoing_)
+		bus_->skip_frame();
+}
+
+bool PyModule::group_ready() const {
+	for (auto &member : group_) {
+		if (member->pending && !member->bus->ready())
+			return false;
+	}
+
+	return true;
+}
+
+size_t PyModule::group_index(mp_int_t index) const {
+	if (index < 0 || (size_t)index > group_.size())
+		mp_raise_msg(&mp_type_IndexError, MP_ERROR_TEXT("bus index out of range"));
+
+	return index;
+}
+
+/* Number of LEDs rendered by the script, which may be mapped to the bus */
+size_t PyModule::led_count() const {
+	return pixel_map_->empty() ? bus_length_ : pixel_map_->length();
+}
+
+size_t PyModule::frame_bytes() const {
+	return std::min(led_count() * BYTES_PER_LED, led_buffer_->size());
+}
+
+/*
+ * The layers, transition and profile are applied to a separate output buffer,
+ * so that the script's frame is not modified.
+ */
+mp_int_t PyModule::write_leds(uint8_t *buffer, size_t out_bytes, enum led_profile_id profile, long wait_us, bool block) {
+	if (!block && !frame_ready(wait_us)) {
+		skip_frame();
+		return AURCOR_OUTPUT_SKIPPED;
+	}
+
+	if (outgoing_)
+		return write_outgoing(buffer, out_bytes, wait_us);
+
+	uint64_t now_us = clock_.now_us();
+	const uint64_t deadline_us = frame_deadline_us(wait_us, now_us);
+	const uint64_t write_us = deadline_us - std::min(deadline_us, (uint64_t)latency_us());
+	mp_int_t status;
+
+	if (compositor_) {
+		compositor_->apply(buffer, output_buffer_.data(), out_bytes);
+		buffer = output_buffer_.data();
+	}
+
+	/*
+	 * Transitions run in real time so they can't be used with a simulated
+	 * clock.
+	 */
+	if (!clock_.simulated() && bus_->transition().blend(buffer,
+			output_buffer_.data(), out_bytes, current_time_us()))
+		buffer = output_buffer_.data();
+
+	if (bus_->recorder().recording(FrameRecording::Stage::SCRIPT))
+		bus_->recorder().capture(buffer, out_bytes);
+
+	auto &snapshot = bus_->profile(profile).snapshot(profile_snapshots_[profile]);
+
+	if (pixel_map_->empty()) {
+		snapshot.transform(buffer, output_buffer_.data(), out_bytes, bus_format_);
+		buffer = output_buffer_.data();
+	} else {
+		snapshot.transform(buffer, out_bytes, map_buffer_.data(),
+			pixel_map_->lut().data(), pixel_map_->lut().size(), bus_format_);
+		buffer = map_buffer_.data();
+		out_bytes = map_buffer_.size();
+	}
+
+	if (write_us > now_us) {
+		mp_hal_delay_us(write_us - now_us);
+		now_us = clock_.now_us();
+	}
+
+	/*
+	 * Interpolation runs in real time so it can't be used with a simulated
+	 * clock.
+	 */
+	if (preset_.interpolate() && !clock_.simulated()) {
+		/* Output directly if there's not enough memory (logged by the interpolator) */
+		if (!interpolator_ && !interpolator_failed_) {
+			try {
+				std::vector<std::shared_ptr<LEDBus>> group;
+
+				group.reserve(group_.size());
+				for (auto &member : group_)
+					group.push_back(member->bus);
+
+				interpolator_ = std::make_unique<Interpolator>(bus_, std::move(group));
+			} catch (const std::bad_alloc&) {
+				interpolator_failed_ = true;
+			} catch (const std::system_error&) {
+				interpolator_failed_ = true;
+			}
+		}
+	} else {
+		interpolator_.reset();
+		interpolator_failed_ = false;
+	}
+
+	if (interpolator_) {
+		/* The interpolator outputs the group together with this bus */
+		for (size_t i = 0; i < group_.size(); i++) {
+			auto &member = *group_[i];
+
+			if (member.pending) {
+				interpolator_->add(1 + i, member.frame.data(), member.frame.size(), preset_.reverse());
+				member.pending = false;
+			}
+		}
+
+		interpolator_->add(0, buffer, out_bytes, preset_.reverse());
+		bus_->scheduler().output(deadline_us, std::max(0L, wait_us), now_us);
+		status = AURCOR_OUTPUT_SENT;
+	} else {
+		/* Let the bus start transmission at the deadline instead of waiting for it */
+		const bool queue = deadline_us > now_us;
+
+		const bool group_written = write_group(block, queue ? deadline_us : 0);
 
-	if (wait_us > 0 && bus_written_) {
-		uint64_t start_us = bus_->last_update_us() + wait_us - TIMING_DELAY_US;
-		uint64_t now_us = current_time_us();
+		if (bus_->write(buffer, out_bytes, preset_.reverse(), block, queue ? deadline_us : 0)) {
+			bus_->scheduler().output(deadline_us, std::max(0L, wait_us),
+				queue ? deadline_us : clock_.now_us());
 
-		if (start_us > now_us)
-			mp_hal_delay_us(start_us - now_us);
+			if (group_written) {
+				status = queue ? AURCOR_OUTPUT_QUEUED : AURCOR_OUTPUT_SENT;
+			} else {
+				status = AURCOR_OUTPUT_SKIPPED;
+			}
+		} else {
+			status = AURCOR_OUTPUT_SKIPPED;
+		}
 	}
 
-	bus_->write(buffer, out_bytes, preset_.reverse());
-	bus_written_ = true;
+	if (status != AURCOR_OUTPUT_SKIPPED)
+		MicroPython::current().frame_written();
 
 	if (!config_used_) {
 		bus_length_ = bus_->length();
@@ -507,7 +833,65 @@ mp_obj_t PyModule::output_leds(size_t n_args, const mp_obj_t *args, mp_map_t *kw
 		bus_default_fps_ = bus_->default_fps();
 	}
 
-	return MP_ROM_NONE;
+	return status;
+}
+
+mp_int_t PyModule::write_outgoing(uint8_t *buffer, size_t out_bytes, long wait_us) {
+	const uint32_t interval_us = frame_interval_us(wait_us);
+	uint64_t now_us = clock_.now_us();
+	const uint64_t deadline_us = outgoing_scheduler_.deadline_us(interval_us, now_us);
+
+	if (compositor_) {
+		compositor_->apply(buffer, output_buffer_.data(), out_bytes);
+		buffer = output_buffer_.data();
+	}
+
+	if (deadline_us > now_us) {
+		mp_hal_delay_us(deadline_us - now_us);
+		now_us = clock_.now_us();
+	}
+
+	bus_->transition().outgoing(buffer, out_bytes);
+	outgoing_scheduler_.output(deadline_us, interval_us, now_us);
+
+	return AURCOR_OUTPUT_SENT;
+}
+
+uint32_t PyModule::default_interval_us() const {
+	return 1000000U / (bus_default_fps_ ? bus_default_fps_ : LEDBusConfig::DEFAULT_DEFAULT_FPS);
+}
+
+/*
+ * Frames for other buses in the group are held until the next frame is
+ * written to this bus, so that they're all output together.
+ */
+mp_int_t PyModule::stage_leds(size_t index, const uint8_t *buffer, size_t out_bytes, enum led_profile_id profile) {
+	auto &member = *group_[index - 1];
+
+	member.frame.assign(buffer, buffer + out_bytes);
+	member.bus->profile(profile).snapshot(member.profile_snapshots[profile])
+		.transform(member.frame.data(), member.frame.size(), member.bus->format());
+	member.pending = true;
+
+	return AURCOR_OUTPUT_QUEUED;
+}
+
+/* Members that couldn't be written remain pending until the next frame */
+bool PyModule::write_group(bool block, uint64_t start_us) {
+	bool written = true;
+
+	for (auto &member : group_) {
+		if (member->pending) {
+			if (member->bus->write(member->frame.data(), member->frame.size(),
+					preset_.reverse(), block, start_us)) {
+				member->pending = false;
+			} else {
+				written = false;
+			}
+		}
+	}
+
+	return written;
 }
 
 void PyModule::append_led(OutputType type, uint8_t *buffer, size_t offset, mp_obj_t item) {
@@ -852,6 +1236,18 @@ inline mp_int_t PyModule::value_obj_to_int(mp_obj_t value) {
 	}
 }
 
+enum led_profile_id PyModule::profile_obj_to_id(mp_obj_t profile) {
+	if (!mp_obj_is_int(profile))
+		mp_raise_TypeError(MP_ERROR_TEXT("profile must be an int"));
+
+	mp_int_t value = mp_obj_get_int(profile);
+
+	if (!LEDProfiles::valid_id(static_cast<enum led_profile_id>(value)))
+		mp_raise_ValueError(MP_ERROR_TEXT("invalid profile"));
+
+	return (enum led_profile_id)value;
+}
+
 long PyModule::calc_wait_us(mp_obj_t fps_obj, mp_obj_t wait_ms_obj, mp_obj_t wait_us_obj, bool set_defaults) {
 	auto wait_us = set_defaults ? DEFAULT_WAIT_US : wait_us_;
 	unsigned int set = 0;
@@ -905,37 +1301,65 @@ long PyModule::calc_wait_us(mp_obj_t fps_obj, mp_obj_t wait_ms_obj, mp_obj_t wai
 }
 
 void PyModule::next_wait_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs,
-		uint64_t &now_us, uint64_t &start_us) {
+		uint64_t &now_us, uint64_t &start_us, mp_int_t &mod) {
 	enum {
 		ARG_fps,
 		ARG_wait_ms,
 		ARG_wait_us,
+		ARG_mod,
 	};
 	static const mp_arg_t allowed_args[] = {
 		{MP_QSTR_fps,         MP_ARG_KW_ONLY | MP_ARG_OBJ,    {u_obj: MP_ROM_NONE}},
 		{MP_QSTR_wait_ms,     MP_ARG_KW_ONLY | MP_ARG_OBJ,    {u_obj: MP_ROM_NONE}},
 		{MP_QSTR_wait_us,     MP_ARG_KW_ONLY | MP_ARG_OBJ,    {u_obj: MP_ROM_NONE}},
+		{MP_QSTR_mod,         MP_ARG_KW_ONLY | MP_ARG_OBJ,    {u_obj: MP_ROM_NONE}},
 	};
 	mp_arg_val_t parsed_args[MP_ARRAY_SIZE(allowed_args)];
 	mp_arg_parse_all(n_args, args, kwargs, MP_ARRAY_SIZE(allowed_args),
 		allowed_args, parsed_args);
 
+	mod = 0;
+
+	if (parsed_args[ARG_mod].u_obj != MP_ROM_NONE) {
+		mod = mp_obj_get_int(parsed_args[ARG_mod].u_obj);
+
+		if (mod <= 0)
+			mp_raise_ValueError(MP_ERROR_TEXT("mod must be positive"));
+	}
+
 	long wait_us = calc_wait_us(parsed_args[ARG_fps].u_obj,
 		parsed_args[ARG_wait_ms].u_obj, parsed_args[ARG_wait_us].u_obj, false);
 
-	if (wait_us && bus_written_) {
-		start_us = bus_->last_update_us() + wait_us - TIMING_DELAY_US;
-		now_us = current_time_us();
+	now_us = clock_.now_us();
+	start_us = std::max(now_us, frame_deadline_us(wait_us, now_us));
+}
 
-		if (now_us > start_us)
-			start_us = now_us;
-	} else {
-		start_us = now_us = current_time_us();
-	}
+/*
+ * Returning the remainder instead of the whole 64-bit value avoids allocating
+ * a long int object on 32-bit platforms when the script only needs the
+ * position within a cycle.
+ */
+mp_obj_t PyModule::int_mod(int64_t value, mp_int_t mod) {
+	if (!mod)
+		return mp_obj_new_int_from_ll(value);
+
+	value %= mod;
+	if (value < 0)
+		value += mod;
+
+	return mp_obj_new_int(value);
+}
+
+/*
+ * Frames are given to the bus before their deadline so that transmission can
+ * start on time, but the bus can't do that using a simulated clock.
+ */
+uint32_t PyModule::latency_us() const {
+	return clock_.simulated() ? 0 : scheduler().latency_us();
 }
 
 void PyModule::next_timeofday(struct timeval &tv, uint64_t offset_us) {
-	gettimeofday(&tv, NULL);
+	clock_.timeofday(tv);
 
 	while (offset_us >= 1000000ULL) {
 		tv.tv_sec++;
@@ -952,51 +1376,72 @@ void PyModule::next_timeofday(struct timeval &tv, uint64_t offset_us) {
 mp_obj_t PyModule::next_ticks30_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
 	uint64_t now_us;
 	uint64_t start_us;
+	mp_int_t mod;
+
+	next_wait_us(n_args, args, kwargs, now_us, start_us, mod);
+
+	if (mod)
+		return int_mod(start_us / 1000ULL, mod);
+
+	return mp_obj_new_int((start_us / 1000ULL) & (MICROPY_PY_UTIME_TICKS_PERIOD - 1));
+}
+
+mp_obj_t PyModule::next_ticks30_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
+	uint64_t now_us;
+	uint64_t start_us;
+	mp_int_t mod;
+
+	next_wait_us(n_args, args, kwargs, now_us, start_us, mod);
 
-	next_wait_us(n_args, args, kwargs, now_us, start_us);
+	if (mod)
+		return int_mod(start_us, mod);
 
-	return MP_OBJ_NEW_SMALL_INT((start_us / 1000ULL) & (MICROPY_PY_UTIME_TICKS_PERIOD - 1));
+	return mp_obj_new_int(start_us & (MICROPY_PY_UTIME_TICKS_PERIOD - 1));
 }
 
 mp_obj_t PyModule::next_ticks64_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
 	uint64_t now_us;
 	uint64_t start_us;
+	mp_int_t mod;
 
-	next_wait_us(n_args, args, kwargs, now_us, start_us);
+	next_wait_us(n_args, args, kwargs, now_us, start_us, mod);
 
-	return mp_obj_new_int_from_ll(start_us / 1000ULL);
+	return int_mod(start_us / 1000ULL, mod);
 }
 
 mp_obj_t PyModule::next_ticks64_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
 	uint64_t now_us;
 	uint64_t start_us;
+	mp_int_t mod;
 
-	next_wait_us(n_args, args, kwargs, now_us, start_us);
+	next_wait_us(n_args, args, kwargs, now_us, start_us, mod);
 
-	return mp_obj_new_int_from_ll(start_us);
+	return int_mod(start_us, mod);
 }
 
 mp_obj_t PyModule::next_time(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
 	uint64_t now_us;
 	uint64_t start_us;
+	mp_int_t mod;
 	struct timeval tv;
 
-	next_wait_us(n_args, args, kwargs, now_us, start_us);
+	next_wait_us(n_args, args, kwargs, now_us, start_us, mod);
 	next_timeofday(tv, start_us - now_us);
 
 	int32_t seconds = tv.tv_sec;
 #if !MICROPY_EPOCH_IS_1970
 	seconds = (uint32_t)seconds - TIMEUTILS_SECONDS_1970_TO_2000;
 #endif
-	return mp_obj_new_int(seconds);
+	return int_mod(seconds, mod);
 }
 
 mp_obj_t PyModule::next_time_ms(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
 	uint64_t now_us;
 	uint64_t start_us;
+	mp_int_t mod;
 	struct timeval tv;
 
-	next_wait_us(n_args, args, kwargs, now_us, start_us);
+	next_wait_us(n_args, args, kwargs, now_us, start_us, mod);
 	next_timeofday(tv, start_us - now_us);
 
 	int32_t seconds = tv.tv_sec;
@@ -1005,15 +1450,16 @@ mp_obj_t PyModule::next_time_ms(size_t n_args, const mp_obj_t *args, mp_map_t *k
 #endif
 	int64_t ms = seconds * 1000LL;
 	ms += tv.tv_usec / 1000LL;
-	return mp_obj_new_int_from_ll(ms);
+	return int_mod(ms, mod);
 }
 
 mp_obj_t PyModule::next_time_us(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
 	uint64_t now_us;
 	uint64_t start_us;
+	mp_int_t mod;
 	struct timeval tv;
 
-	next_wait_us(n_args, args, kwargs, now_us, start_us);
+	next_wait_us(n_args, args, kwargs, now_us, start_us, mod);
 	next_timeofday(tv, start_us - now_us);
 
 	int32_t seconds = tv.tv_sec;
@@ -1022,7 +1468,7 @@ mp_obj_t PyModule::next_time_us(size_t n_args, const mp_obj_t *args, mp_map_t *k
 #endif
 	int64_t us = seconds * 1000000LL;
 	us += tv.tv_usec;
-	return mp_obj_new_int_from_ll(us);
+	return int_mod(us, mod);
 }
 
 mp_obj_t PyModule::udp_receive(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
@@ -1047,7 +1493,11 @@ mp_obj_t PyModule::udp_receive(size_t n_args, const mp_obj_t *args, mp_map_t *kw
 
 	mp_obj_t packets = mp_obj_new_list(0, nullptr);
 
-	bus_->udp_receive(wait, packets);
+	if (!outgoing_) {
+		bus_->udp_receive(wait, packets);
+	} else if (wait) {
+		mp_hal_delay_us(default_interval_us());
+	}
 
 	return packets;
 }
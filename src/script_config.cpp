@@ -648,6 +648,85 @@ void ScriptConfig::populate_dict(mp_obj_t dict) {
 	micropython_nlr_end();
 }
 
+/*
+ * Native properties have a fixed set of keys with small default values, so
+ * they aren't checked against the maximum defaults size.
+ */
+ScriptConfig::Property& ScriptConfig::register_property(const std::string &key, Type type) {
+	auto it = properties_.find(key);
+
+	if (it != properties_.end() && it->second->type() != type) {
+		properties_.erase(it);
+		it = properties_.end();
+	}
+
+	if (it == properties_.end())
+		it = properties_.emplace(key, std::move(Property::create(type, true))).first;
+
+	auto &property = *it->second;
+
+	property.registered(true);
+	Property::clear_default(property);
+	return property;
+}
+
+bool ScriptConfig::get(const std::string &key, bool &value) const {
+	auto it = properties_.find(key);
+
+	if (it == properties_.end() || it->second->type() != Type::BOOL
+			|| !it->second->as_bool().has_any())
+		return false;
+
+	value = it->second->as_bool().get_any();
+	return true;
+}
+
+bool ScriptConfig::get(const std::string &key, int32_t &value) const {
+	auto it = properties_.find(key);
+
+	if (it == properties_.end()
+			|| (it->second->type() != Type::S32 && it->second->type() != Type::RGB)
+			|| !it->second->as_s32().has_any())
+		return false;
+
+	value = it->second->as_s32().get_any();
+	return true;
+}
+
+bool ScriptConfig::get(const std::string &key, float &value) const {
+	auto it = properties_.find(key);
+
+	if (it == properties_.end() || it->second->type() != Type::FLOAT
+			|| !it->second->as_float().has_any())
+		return false;
+
+	value = it->second->as_float().get_any();
+	return true;
+}
+
+bool ScriptConfig::get(const std::string &key, enum led_profile_id &value) const {
+	auto it = properties_.find(key);
+
+	if (it == properties_.end() || it->second->type() != Type::PROFILE
+			|| !it->second->as_profile().has_any())
+		return false;
+
+	value = it->second->as_profile().get_any();
+	return true;
+}
+
+bool ScriptConfig::get(const std::string &key, std::vector<int32_t> &values) const {
+	auto it = properties_.find(key);
+
+	if (it == properties_.end()
+			|| (it->second->type() != Type::LIST_S32 && it->second->type() != Type::LIST_RGB)
+			|| it->second->as_s32_list().get_any().empty())
+		return false;
+
+	values = it->second->as_s32_list().get_any();
+	return true;
+}
+
 std::vector<std::string> ScriptConfig::keys(types_bitset types) const {
 	std::vector<std::string> keys;
 
@@ -1104,6 +1183,60 @@ Result ScriptConfig::set(const std::string &key, const std::string &value) {
 	return Result::OK;
 }
 
+Result ScriptConfig::check(const std::string &key, const std::string &value) const {
+	auto it = properties_.find(key);
+
+	if (it == properties_.end())
+		return Result::NOT_FOUND;
+
+	if (value.empty())
+		return Result::OK;
+
+	int32_t int_value;
+	float float_value;
+	enum led_profile_id profile_value;
+
+	switch (it->second->type()) {
+	case Type::BOOL:
+		if (value == "true" || value == "t" || value == "1"
+				|| value == "false" || value == "f" || value == "0")
+			return Result::OK;
+		break;
+
+	case Type::S32:
+		if (parse_s32(ContainerOp::ADD, value, int_value))
+			return Result::OK;
+		break;
+
+	case Type::RGB:
+		if (parse_rgb(ContainerOp::ADD, value, int_value))
+			return Result::OK;
+		break;
+
+	case Type::FLOAT:
+		if (parse_float(ContainerOp::ADD, value, float_value))
+			return Result::OK;
+		break;
+
+	case Type::PROFILE:
+		if (parse_profile(ContainerOp::ADD, value, profile_value))
+			return Result::OK;
+		break;
+
+	case Type::LIST_U16:
+	case Type::LIST_S32:
+	case Type::LIST_RGB:
+	case Type::SET_U16:
+	case Type::SET_S32:
+	case Type::SET_RGB:
+	case Type::INVALID:
+	default:
+		break;
+	}
+
+	return Result::OUT_OF_RANGE;
+}
+
 Result ScriptConfig::unset(const std::string &key) {
 	auto it = properties_.find(key);
 
@@ -170,12 +170,10 @@ void SPILEDBus::start(const uint8_t *data, size_t size, bool reverse_order) {
 	 */
 	trans_.length = max_bytes * TX_WORDS_PER_BYTE * TX_BITS_PER_WORD;
 
-	next_tx_delay_us_ = reset_time_us() + 1U;
-
-	while (current_time_us() < next_tx_start_us_) {
-		asm volatile ("nop");
-	}
+	schedule_tx(reset_time_us() + 1U);
+}
 
+void SPILEDBus::tx_start() {
 	esp_err_t err = spi_device_queue_trans(device_.get(), &trans_, 0);
 	if (err) {
 		finish();
@@ -185,7 +183,6 @@ void SPILEDBus::start(const uint8_t *data, size_t size, bool reverse_order) {
 IRAM_ATTR void SPILEDBus::completion_handler(spi_transaction_t *trans) {
 	auto *self = reinterpret_cast<SPILEDBus*>(trans->user);
 
-	self->next_tx_start_us_ = current_time_us() + self->next_tx_delay_us_;
 	self->finish_isr();
 }
 #endif
@@ -0,0 +1,170 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aurcor/transition.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "aurcor/led_bus.h"
+#include "aurcor/memory_pool.h"
+#include "aurcor/util.h"
+
+namespace aurcor {
+
+std::shared_ptr<MemoryPool> Transition::buffers_ = std::make_shared<MemoryPool>(
+	LEDBus::MAX_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+void Transition::setup(size_t count) {
+	buffers_->resize(count);
+}
+
+const char *Transition::name(Type type) {
+	switch (type) {
+	case Type::NONE:
+		break;
+
+	case Type::CROSSFADE:
+		return "crossfade";
+
+	case Type::WIPE:
+		return "wipe";
+	}
+
+	return "none";
+}
+
+bool Transition::type(const std::string &name, Type &type) {
+	for (auto value : {Type::NONE, Type::CROSSFADE, Type::WIPE}) {
+		if (name == Transition::name(value)) {
+			type = value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Transition::start(Type type, unsigned int duration_ms, uint64_t now_us) {
+	std::lock_guard lock{mutex_};
+
+	if (active_ || type == Type::NONE || !duration_ms)
+		return false;
+
+	buffer_ = buffers_->allocate();
+	if (!buffer_)
+		return false;
+
+	type_ = type;
+	start_us_ = now_us;
+	duration_us_ = std::min(duration_ms, MAX_DURATION_MS) * 1000U;
+	size_ = 0;
+	active_ = true;
+	return true;
+}
+
+void Transition::stop() {
+	std::lock_guard lock{mutex_};
+
+	stop_locked();
+}
+
+void Transition::stop_locked() {
+	active_ = false;
+	buffer_.reset();
+	size_ = 0;
+}
+
+void Transition::outgoing(const uint8_t *data, size_t size) {
+	std::lock_guard lock{mutex_};
+
+	if (!buffer_)
+		return;
+
+	size_ = std::min(size, buffer_->size());
+	std::memcpy(buffer_->begin(), data, size_);
+}
+
+/*
+ * Parts of the frame that the outgoing script hasn't rendered (yet) are
+ * treated as black.
+ */
+bool Transition::blend(const uint8_t *src, uint8_t *dst, size_t size, uint64_t now_us) {
+	if (!active_)
+		return false;
+
+	std::lock_guard lock{mutex_};
+
+	if (!buffer_)
+		return false;
+
+	const uint64_t elapsed_us = now_us - std::min(now_us, start_us_);
+
+	if (elapsed_us >= duration_us_) {
+		stop_locked();
+		return false;
+	}
+
+	/* Weight of the incoming frame (0 to 255) */
+	const unsigned int weight = elapsed_us * 256 / duration_us_;
+	const uint8_t *previous = buffer_->begin();
+
+	switch (type_) {
+	case Type::NONE:
+		if (dst != src)
+			std::memcpy(dst, src, size);
+		break;
+
+	case Type::CROSSFADE:
+		for (size_t i = 0; i < size; i++) {
+			const unsigned int value = i < size_ ? previous[i] : 0;
+
+			dst[i] = (src[i] * weight + value * (256 - weight)) >> 8;
+		}
+		break;
+
+	case Type::WIPE: {
+			const size_t boundary = size / LEDBus::BYTES_PER_LED * weight / 256 * LEDBus::BYTES_PER_LED;
+
+			if (dst != src)
+				std::memcpy(dst, src, boundary);
+
+			for (size_t i = boundary; i < size; i++)
+				dst[i] = i < size_ ? previous[i] : 0;
+			break;
+		}
+	}
+
+	return true;
+}
+
+void Transition::loop(uint64_t now_us) {
+	if (active_) {
+		std::lock_guard lock{mutex_};
+
+		if (active_ && now_us - std::min(now_us, start_us_) >= duration_us_)
+			stop_locked();
+	}
+}
+
+} // namespace aurcor
@@ -371,15 +371,13 @@ void UARTDMALEDBus::start(const uint8_t *data, size_t size, bool reverse_order)
 		}
 	}
 
-	next_tx_delay_us_ = reset_time_us() + std::min(TX_FIFO_MAX_US, TX_BYTE_US * max_bytes) + 1U;
-
-	while (current_time_us() < next_tx_start_us_) {
-		asm volatile ("nop");
-	}
+	schedule_tx(reset_time_us() + std::min(TX_FIFO_MAX_US, TX_BYTE_US * max_bytes) + 1U);
+}
 
+void UARTDMALEDBus::tx_start() {
 	tx_link_->owner = 1;
 #if UHCI_USES_GDMA
-	esp_err_t err = gdma_start(tx_channel_, (intptr_t)&tx_link[0]);
+	esp_err_t err = gdma_start(tx_channel_, (intptr_t)tx_link_.get());
 	if (err != ESP_OK) {
 		logger_.emerg(F("[%S] DMA start failed: %d"), name(), err);
 		cleanup();
@@ -395,7 +393,6 @@ IRAM_ATTR bool UARTDMALEDBus::completion_handler(gdma_channel_handle_t dma_chan,
 		gdma_event_data_t *event_data, void *user_data) {
 	auto *self = reinterpret_cast<UARTDMALEDBus*>(user_data);
 
-	self->next_tx_start_us_ = current_time_us() + self->next_tx_delay_us_;
 	self->finish_isr();
 
 	return false;
@@ -409,11 +406,9 @@ IRAM_ATTR void UARTDMALEDBus::interrupt_handler(void *arg) {
 	uhci.int_clr.val = status;
 
 	if (status & UHCI_OUT_TOTAL_EOF_INT_ST) {
-		self->next_tx_start_us_ = current_time_us() + self->next_tx_delay_us_;
 		self->finish_isr();
 	} else if (status & UHCI_OUT_DSCR_ERR_INT_ST) {
 		self->tx_link_->owner = 0;
-		self->next_tx_start_us_ = 0;
 		self->finish_isr();
 	}
 }
@@ -108,12 +108,10 @@ void UARTLEDBus::transmit() {
 		return;
 	}
 
-	next_tx_delay_us_ = reset_time_us() + std::min(TX_FIFO_MAX_US, TX_BYTE_US * bytes_) + 1U;
-
-	while (current_time_us() < next_tx_start_us_) {
-		asm volatile ("nop");
-	}
+	schedule_tx(reset_time_us() + std::min(TX_FIFO_MAX_US, TX_BYTE_US * bytes_) + 1U);
+}
 
+void UARTLEDBus::tx_start() {
 	uart_ll_ena_intr_mask(&hw_, UART_INTR_TXFIFO_EMPTY);
 }
 
@@ -145,7 +143,6 @@ IRAM_ATTR void UARTLEDBus::interrupt_handler(void *arg) {
 	}
 
 	if (bytes == 0) {
-		self->next_tx_start_us_ = current_time_us() + self->next_tx_delay_us_;
 		uart_ll_disable_intr_mask(&self->hw_, UART_INTR_TXFIFO_EMPTY);
 		self->finish_isr();
 	} else {
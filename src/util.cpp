@@ -60,7 +60,7 @@ bool allowed_text(const std::string &text) {
 std::vector<std::string> list_filenames(const char *directory_name, const char *extension) {
 	std::vector<std::string> names;
 	const size_t extension_len = std::char_traits<char>::length(extension);
-	std::shared_lock file_lock{App::file_mutex()};
+	std::shared_lock file_lock{App::file_mutex(directory_name)};
 	auto dir = app::FS.open(directory_name);
 
 	if (dir && dir.isDirectory()) {
@@ -18,10 +18,11 @@
 
 #include "aurcor/web_client.h"
 
+#include <Arduino.h>
+
 #ifdef ENV_NATIVE
 # include <curl/curl.h>
 #else
-# include <Arduino.h>
 # include <esp_http_client.h>
 # pragma GCC diagnostic push
 # pragma GCC diagnostic ignored "-Wswitch-enum"
@@ -30,6 +31,7 @@
 #endif
 
 #include <cstdlib>
+#include <cstring>
 #include <iterator>
 #include <memory>
 #include <string>
@@ -54,8 +56,12 @@ void WebClient::init() {
 }
 #endif
 
-bool WebClient::open(const std::string &url) {
+bool WebClient::open(const std::string &url, const std::string &if_none_match) {
 	long status_code;
+
+	etag_.clear();
+	not_modified_ = false;
+
 #ifdef ENV_NATIVE
 	CURLcode res;
 
@@ -87,6 +93,37 @@ bool WebClient::open(const std::string &url) {
 			curl_.reset();
 			return false;
 		}
+
+		res = curl_easy_setopt(curl_.get(), CURLOPT_HEADERDATA, this);
+		if (res != CURLE_OK) {
+			logger_.err(F("CURLOPT_HEADERDATA error: %s"), curl_easy_strerror(res));
+			curl_.reset();
+			return false;
+		}
+
+		res = curl_easy_setopt(curl_.get(), CURLOPT_HEADERFUNCTION, curl_header);
+		if (res != CURLE_OK) {
+			logger_.err(F("CURLOPT_HEADERFUNCTION error: %s"), curl_easy_strerror(res));
+			curl_.reset();
+			return false;
+		}
+	}
+
+	std::unique_ptr<struct curl_slist,decltype(&curl_slist_free_all)> headers{nullptr, curl_slist_free_all};
+
+	if (!if_none_match.empty()) {
+		headers.reset(curl_slist_append(nullptr, ("If-None-Match: " + if_none_match).c_str()));
+
+		if (!headers) {
+			logger_.err(F("CURL error"));
+			return false;
+		}
+	}
+
+	res = curl_easy_setopt(curl_.get(), CURLOPT_HTTPHEADER, headers.get());
+	if (res != CURLE_OK) {
+		logger_.err(F("CURLOPT_HTTPHEADER error: %s"), curl_easy_strerror(res));
+		return false;
 	}
 
 	res = curl_easy_setopt(curl_.get(), CURLOPT_URL, url.c_str());
@@ -98,6 +135,7 @@ bool WebClient::open(const std::string &url) {
 	data_.clear();
 
 	res = curl_easy_perform(curl_.get());
+	curl_easy_setopt(curl_.get(), CURLOPT_HTTPHEADER, nullptr);
 	if (res != CURLE_OK) {
 		logger_.debug(F("GET %s failed: %s"), url.c_str(),curl_easy_strerror(res));
 		return false;
@@ -124,6 +162,8 @@ bool WebClient::open(const std::string &url) {
 		config.crt_bundle_attach = arduino_esp_crt_bundle_attach;
 		config.keep_alive_enable = true;
 		config.disable_auto_redirect = true;
+		config.event_handler = http_event;
+		config.user_data = this;
 		config.url = url.c_str();
 
 		handle_ = std::unique_ptr<struct esp_http_client,HandleDeleter>{esp_http_client_init(&config)};
@@ -133,6 +173,16 @@ bool WebClient::open(const std::string &url) {
 		}
 	}
 
+	if (if_none_match.empty()) {
+		esp_http_client_delete_header(handle_.get(), "If-None-Match");
+	} else {
+		err = esp_http_client_set_header(handle_.get(), "If-None-Match", if_none_match.c_str());
+		if (err != ESP_OK) {
+			logger_.err(F("Unable to set header for GET %s: %d"), url.c_str(), err);
+			return false;
+		}
+	}
+
 	err = esp_http_client_open(handle_.get(), 0);
 	if (err != ESP_OK) {
 		logger_.debug(F("GET %s failed: %d"), url.c_str(), err);
@@ -148,14 +198,65 @@ bool WebClient::open(const std::string &url) {
 	status_code = esp_http_client_get_status_code(handle_.get());
 #endif
 
-	logger_.log(status_code != 200 ? uuid::log::Level::DEBUG : uuid::log::Level::TRACE,
+	logger_.log((status_code != 200 && status_code != 304) ? uuid::log::Level::DEBUG : uuid::log::Level::TRACE,
 		F("Status code %ld for GET %s"), status_code, url.c_str());
+
+	if (status_code == 304 && !if_none_match.empty()) {
+		not_modified_ = true;
+		return false;
+	}
+
 	if (status_code != 200)
 		return false;
 
 	return true;
 }
 
+void WebClient::header(const char *name, size_t name_len, const char *value, size_t value_len) {
+	static constexpr size_t MAX_ETAG_LENGTH = 128;
+
+	if (name_len == 4 && !strncasecmp(name, "ETag", name_len)) {
+		while (value_len > 0 && (value[0] == ' ' || value[0] == '\t')) {
+			value++;
+			value_len--;
+		}
+
+		while (value_len > 0 && (value[value_len - 1] == ' ' || value[value_len - 1] == '\t'
+				|| value[value_len - 1] == '\r' || value[value_len - 1] == '\n'))
+			value_len--;
+
+		if (value_len <= MAX_ETAG_LENGTH)
+			etag_.assign(value, value_len);
+	}
+}
+
+#ifdef ENV_NATIVE
+size_t WebClient::curl_header(char *buffer, size_t size, size_t nitems, void *userdata) {
+	WebClient *client = reinterpret_cast<WebClient*>(userdata);
+	size_t len = size * nitems;
+	const char *colon = reinterpret_cast<const char*>(std::memchr(buffer, ':', len));
+
+	if (colon) {
+		size_t name_len = colon - buffer;
+
+		client->header(buffer, name_len, colon + 1, len - name_len - 1);
+	}
+
+	return len;
+}
+#else
+esp_err_t WebClient::http_event(esp_http_client_event_t *evt) {
+	if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+		WebClient *client = reinterpret_cast<WebClient*>(evt->user_data);
+
+		client->header(evt->header_key, std::strlen(evt->header_key),
+			evt->header_value, std::strlen(evt->header_value));
+	}
+
+	return ESP_OK;
+}
+#endif
+
 #ifdef ENV_NATIVE
 size_t WebClient::curl_append(char *ptr, size_t size, size_t nmemb, void *userdata) {
 	WebClient *client = reinterpret_cast<WebClient*>(userdata);
@@ -424,4 +525,55 @@ bool WebClient::normalise_url(std::string base, std::string url,
 	return true;
 }
 
+bool WebClientStream::fill() {
+	if (pos_ < len_)
+		return true;
+
+	ssize_t len = client_.read(buffer_, sizeof(buffer_));
+
+	pos_ = 0;
+	len_ = len > 0 ? len : 0;
+	return len_ > 0;
+}
+
+int WebClientStream::available() {
+	return fill() ? len_ - pos_ : 0;
+}
+
+int WebClientStream::read() {
+	if (!fill())
+		return -1;
+
+	return (uint8_t)buffer_[pos_++];
+}
+
+int WebClientStream::peek() {
+	if (!fill())
+		return -1;
+
+	return (uint8_t)buffer_[pos_];
+}
+
+size_t WebClientStream::readBytes(char *buffer, size_t length) {
+	size_t total = 0;
+
+	while (total < length && fill()) {
+		size_t len = std::min(length - total, len_ - pos_);
+
+		std::memcpy(buffer + total, &buffer_[pos_], len);
+		pos_ += len;
+		total += len;
+	}
+
+	return total;
+}
+
+size_t WebClientStream::write(uint8_t c) {
+	return 0;
+}
+
+size_t WebClientStream::write(const uint8_t *buffer, size_t size) {
+	return 0;
+}
+
 } // namespace aurcor
@@ -18,14 +18,28 @@
 
 #include "aurcor/web_interface.h"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+
 #include "app/config.h"
+#include "app/util.h"
 #include "aurcor/app.h"
 #include "aurcor/led_bus.h"
+#include "aurcor/led_bus_format.h"
+#include "aurcor/led_profiles.h"
+#include "aurcor/modaurcor.h"
 #include "aurcor/preset.h"
 #include "aurcor/util.h"
 #include "aurcor/web_server.h"
@@ -35,6 +49,8 @@
 # define PSTR_ALIGN 4
 #endif
 
+namespace cbor = qindesign::cbor;
+
 static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "web-interface";
 
 namespace aurcor {
@@ -52,18 +68,145 @@ WebInterface::WebInterface(App &app) : app_(app) {
 
 	server_.add_get_handler("/", std::bind(&WebInterface::list_presets, this, _1));
 	server_.add_post_handler("/preset", std::bind(&WebInterface::set_preset, this, _1));
+	server_.add_post_handler("/batch", std::bind(&WebInterface::batch, this, _1), MAX_BATCH_SIZE);
 	server_.add_static_content("/" + app_.immutable_id() + "/list_presets.xml",
 		"application/xslt+xml", gzip_immutable_headers, htdocs_list_presets_xml_gz);
+	server_.add_event_handler("/events", std::bind(&WebInterface::add_event_stream, this, _1, false));
+	server_.add_event_handler("/events/frames", std::bind(&WebInterface::add_event_stream, this, _1, true));
 }
 
-bool WebInterface::list_presets(WebServer::Request &req) {
-	req.set_status(200);
-	req.set_type("application/xml");
-	req.add_header("Cache-Control", "no-cache");
+void WebInterface::loop() {
+	uint64_t now_us = current_time_us();
+
+	if (now_us - last_event_us_ < EVENT_INTERVAL_MS * 1000)
+		return;
+
+	last_event_us_ = now_us;
+
+	std::lock_guard lock{event_streams_mutex_};
+	bool frames = false;
+
+	for (auto it = event_streams_.begin(); it != event_streams_.end(); ) {
+		if (it->first->closed()) {
+			logger_.trace(F("Event stream closed (%lu dropped)"), it->first->dropped());
+			it = event_streams_.erase(it);
+		} else {
+			frames |= it->second;
+			it++;
+		}
+	}
+
+	for (auto &bus_name : app_.bus_names()) {
+		auto bus = app_.bus(bus_name);
+
+		bus->monitor(frames);
+
+		if (event_streams_.empty())
+			continue;
+
+		auto status = bus_status(bus, now_us);
+		std::string status_frames;
+
+		if (frames)
+			status_frames = status + bus_frame(bus);
+
+		status.append("}");
+
+		for (auto &stream : event_streams_)
+			stream.first->send("bus", stream.second ? status_frames : status);
+	}
+}
+
+bool WebInterface::add_event_stream(const std::shared_ptr<WebServer::EventStream> &stream, bool frames) {
+	std::lock_guard lock{event_streams_mutex_};
+
+	if (event_streams_.size() >= MAX_EVENT_STREAMS)
+		return false;
+
+	event_streams_.emplace_back(stream, frames);
+	return true;
+}
+
+std::string WebInterface::bus_status(const std::shared_ptr<LEDBus> &bus, uint64_t now_us) {
+	auto &previous = bus_frames_[bus->name()];
+	uint32_t bus_frames = bus->frames();
+	unsigned int fps_x10 = 0;
+	char buffer[224];
+
+	if (previous.second && now_us > previous.second)
+		fps_x10 = (uint64_t)(bus_frames - previous.first) * 10000000U / (now_us - previous.second);
+
+	previous = {bus_frames, now_us};
+
+	snprintf(buffer, sizeof(buffer),
+		"\",\"length\":%zu,\"frames\":%" PRIu32 ",\"skipped_frames\":%" PRIu32
+		",\"missed_deadlines\":%" PRIu32 ",\"fps\":%u.%u"
+		",\"frame_interval_us\":%" PRIu32 ",\"max_frame_interval_us\":%" PRIu32,
+		bus->length(), bus_frames, bus->skipped_frames(), bus->missed_deadlines(),
+		fps_x10 / 10, fps_x10 % 10,
+		bus->frame_interval_us(), bus->max_frame_interval_us(true));
+
+	std::string data{"{\"bus\":\""};
+
+	append_json_string(data, bus->name());
+	data.append("\",\"preset\":\"");
+	append_json_string(data, app_.current_preset_name(bus));
+	data.append(buffer);
+	data.append(",\"profile_load_us\":{");
+
+	for (size_t profile = LEDProfiles::MIN_ID; profile <= LEDProfiles::MAX_ID; profile++) {
+		auto id = static_cast<enum led_profile_id>(profile);
+
+		if (profile > LEDProfiles::MIN_ID)
+			data.append(",");
+
+		data.append("\"");
+		data.append(LEDProfiles::lc_name(id));
+		data.append("\":");
+		data.append(std::to_string(bus->profile_load_time_us(id)));
+	}
+
+	data.append("}");
+	return data;
+}
+
+std::string WebInterface::bus_frame(const std::shared_ptr<LEDBus> &bus) {
+	static constexpr const char *hex = "0123456789abcdef";
+	std::array<uint8_t,LEDBus::MONITOR_MAX_BYTES> frame;
+	size_t leds = bus->monitor_frame(frame);
+	std::string data{",\"leds\":\""};
+
+	for (size_t i = 0; i < leds * LEDBus::BYTES_PER_LED; i++) {
+		data.push_back(hex[frame[i] >> 4]);
+		data.push_back(hex[frame[i] & 0xF]);
+	}
+
+	data.append("\"}");
+	return data;
+}
 
+void WebInterface::append_json_string(std::string &data, std::string_view text) {
+	static constexpr const char *hex = "0123456789abcdef";
+
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			data.push_back('\\');
+			data.push_back(c);
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			data.append("\\u00");
+			data.push_back(hex[c >> 4]);
+			data.push_back(hex[c & 0xF]);
+		} else {
+			data.push_back(c);
+		}
+	}
+}
+
+bool WebInterface::list_presets(WebServer::Request &req) {
 	app::Config config;
 	std::string default_preset;
 	std::string current_preset;
+	bool default_flag = req.uri() == "/?default";
 
 	if (!config.default_bus().empty()) {
 		auto bus = app_.bus(config.default_bus());
@@ -74,12 +217,52 @@ bool WebInterface::list_presets(WebServer::Request &req) {
 		}
 	}
 
-	req.printf(
-			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
-			"<?xml-stylesheet type=\"text/xsl\" href=\"/%s/list_presets.xml\"?>"
-			"<l%s>", app_.immutable_id().c_str(),
-			(req.uri() == "/?default") ? " f=\"d\"" : ""
-	);
+	/*
+	 * The list only depends on the preset descriptions (tracked by the cache
+	 * version) and the current/default preset names, so use those to
+	 * avoid regenerating it for clients that already have the same content.
+	 */
+	const std::string names = current_preset + '/' + default_preset;
+	char etag_buffer[48];
+
+	snprintf(etag_buffer, sizeof(etag_buffer), "-%016" PRIx64 "-%016" PRIx64 "%s\"",
+		app_.preset_descriptions_version(),
+		content_hash(reinterpret_cast<const uint8_t*>(names.data()), names.length()),
+		default_flag ? "-d" : "");
+
+	std::string etag = "\"" + app_.immutable_id() + etag_buffer;
+
+	req.set_type("application/xml");
+	req.add_header("Cache-Control", "no-cache");
+	req.add_header("ETag", etag);
+
+	if (etag_matches(req.get_header("If-None-Match"), etag)) {
+		req.set_status(304);
+		return true;
+	}
+
+	req.set_status(200);
+
+	std::lock_guard lock{list_presets_mutex_};
+
+	if (list_presets_etag_ != etag) {
+		list_presets_data_ = render_presets(default_flag, current_preset, default_preset);
+		list_presets_etag_ = etag;
+	}
+
+	req.write(reinterpret_cast<const uint8_t*>(list_presets_data_.data()), list_presets_data_.length());
+	return true;
+}
+
+std::string WebInterface::render_presets(bool default_flag,
+		const std::string &current_preset, const std::string &default_preset) {
+	std::string data;
+
+	data.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+		"<?xml-stylesheet type=\"text/xsl\" href=\"/");
+	data.append(app_.immutable_id());
+	data.append("/list_presets.xml\"?>");
+	data.append(default_flag ? "<l f=\"d\">" : "<l>");
 
 	auto presets = app_.preset_descriptions();
 
@@ -87,15 +270,45 @@ bool WebInterface::list_presets(WebServer::Request &req) {
 		bool is_current = preset.first == current_preset;
 		bool is_default = preset.first == default_preset;
 
-		req.printf("<p n=\"%s\" d=\"%s\"", preset.first.c_str(), preset.second.c_str());
+		data.append("<p n=\"").append(preset.first);
+		data.append("\" d=\"").append(preset.second).append("\"");
 		if (is_current || is_default) {
-			req.printf(" f=\"%s%s\"", is_current ? "r" : "", is_default ? "d" : "");
+			data.append(" f=\"");
+			if (is_current)
+				data.append("r");
+			if (is_default)
+				data.append("d");
+			data.append("\"");
 		}
-		req.print("/>");
+		data.append("/>");
 	}
 
-	req.print("</l>");
-	return true;
+	data.append("</l>");
+	return data;
+}
+
+bool WebInterface::etag_matches(std::string_view if_none_match, std::string_view etag) {
+	while (!if_none_match.empty()) {
+		auto comma_pos = if_none_match.find(',');
+		auto value = if_none_match.substr(0, comma_pos);
+
+		if_none_match.remove_prefix(comma_pos == std::string_view::npos
+			? if_none_match.length() : comma_pos + 1);
+
+		while (!value.empty() && value.front() == ' ')
+			value.remove_prefix(1);
+
+		while (!value.empty() && value.back() == ' ')
+			value.remove_suffix(1);
+
+		if (value.substr(0, 2) == "W/")
+			value.remove_prefix(2);
+
+		if (value == "*" || value == etag)
+			return true;
+	}
+
+	return false;
 }
 
 bool WebInterface::set_preset(WebServer::Request &req) {
@@ -210,6 +423,255 @@ bool WebInterface::set_preset(WebServer::Request &req) {
 	return true;
 }
 
+bool WebInterface::batch(WebServer::Request &req) {
+	req.add_header("Cache-Control", "no-cache");
+
+	if (req.get_header("Content-Type") != "application/cbor") {
+		req.set_status(400);
+		return true;
+	}
+
+	cbor::Reader reader{req};
+	std::vector<BusOperation> operations;
+	const char *message = parse_batch(reader, operations);
+
+	if (!message)
+		message = apply_batch(operations);
+
+	if (!message) {
+		logger_.info("Applied batch of %zu operations from %s",
+			operations.size(), req.client_address().c_str());
+
+		req.set_status(204);
+	} else {
+		logger_.trace("Failed to apply batch from %s (%s)",
+			req.client_address().c_str(), message);
+
+		req.set_status(400);
+		req.set_type("text/plain");
+		req.print(message);
+	}
+	return true;
+}
+
+const char *WebInterface::parse_batch(cbor::Reader &reader, std::vector<BusOperation> &operations) {
+	auto type = reader.readDataType();
+
+	if (type == cbor::DataType::kTag) {
+		if (reader.getTag() != cbor::kSelfDescribeTag)
+			return "Invalid CBOR data";
+
+		type = reader.readDataType();
+	}
+
+	if (type != cbor::DataType::kArray || reader.isIndefiniteLength())
+		return "Expected a definite length array of operations";
+
+	uint64_t length = reader.getLength();
+
+	while (length-- > 0) {
+		operations.emplace_back();
+
+		auto message = parse_operation(reader, operations.back());
+		if (message)
+			return message;
+	}
+
+	for (size_t i = 0; i < operations.size(); i++) {
+		for (size_t j = i + 1; j < operations.size(); j++) {
+			if (operations[i].bus == operations[j].bus)
+				return "Duplicate bus";
+		}
+	}
+
+	return nullptr;
+}
+
+const char *WebInterface::parse_operation(cbor::Reader &reader, BusOperation &operation) {
+	std::string preset_name;
+	uint64_t entries;
+	bool indefinite;
+
+	if (!cbor::expectMap(reader, &entries, &indefinite) || indefinite)
+		return "Expected a definite length map for each operation";
+
+	while (entries-- > 0) {
+		std::string key;
+
+		if (!app::read_text(reader, key))
+			return "Invalid operation key";
+
+		if (key == "bus") {
+			std::string value;
+
+			if (!app::read_text(reader, value))
+				return "Invalid bus name";
+
+			operation.bus = app_.bus(value);
+			if (!operation.bus)
+				return "Bus not found";
+		} else if (key == "preset") {
+			if (!app::read_text(reader, preset_name))
+				return "Invalid preset name";
+		} else if (key == "default") {
+			if (!cbor::expectBoolean(reader, &operation.set_default))
+				return "Invalid default flag";
+		} else if (key == "fps") {
+			uint64_t value;
+
+			if (!cbor::expectUnsignedInt(reader, &value)
+					|| value > (uint64_t)micropython::PyModule::MAX_FPS)
+				return "Invalid fps";
+
+			operation.fps = value;
+			operation.fps_set = true;
+		} else if (key == "length") {
+			uint64_t value;
+
+			if (!cbor::expectUnsignedInt(reader, &value)
+					|| value < MIN_LEDS || value > MAX_LEDS)
+				return "Invalid length";
+
+			operation.length = value;
+			operation.length_set = true;
+		} else if (key == "format") {
+			std::string value;
+
+			if (!app::read_text(reader, value)
+					|| !LEDBusFormats::uc_id(value, operation.format))
+				return "Invalid format";
+
+			operation.format_set = true;
+		} else if (key == "reverse") {
+			if (!cbor::expectBoolean(reader, &operation.reverse))
+				return "Invalid reverse flag";
+
+			operation.reverse_set = true;
+		} else if (key == "config") {
+			uint64_t config_entries;
+
+			if (!cbor::expectMap(reader, &config_entries, &indefinite) || indefinite)
+				return "Expected a definite length map for config";
+
+			while (config_entries-- > 0) {
+				std::string config_key;
+				std::string config_value;
+
+				if (!app::read_text(reader, config_key)
+						|| !app::read_text(reader, config_value))
+					return "Invalid config property";
+
+				operation.config.emplace_back(std::move(config_key), std::move(config_value));
+			}
+		} else if (!reader.isWellFormed()) {
+			return "Invalid CBOR data";
+		}
+	}
+
+	if (!operation.bus)
+		return "No bus specified";
+
+	if (!preset_name.empty()) {
+		operation.preset = std::make_shared<Preset>(app_, operation.bus);
+
+		if (!operation.preset->name(preset_name))
+			return "Invalid preset name";
+
+		switch (operation.preset->load()) {
+		case Result::OK:
+			break;
+
+		case Result::NOT_FOUND:
+			return "Preset not found";
+
+		case Result::FULL:
+		case Result::OUT_OF_RANGE:
+			return "Preset too large or invalid";
+
+		case Result::PARSE_ERROR:
+		case Result::IO_ERROR:
+		default:
+			return "Failed to load preset";
+		}
+
+		/* The preset isn't running yet so changes can be discarded */
+		for (auto &config : operation.config) {
+			if (operation.preset->set_config(config.first, config.second) != Result::OK)
+				return "Invalid config property or value";
+		}
+
+		operation.config.clear();
+	} else if (operation.set_default) {
+		return "No preset specified for default";
+	} else if (!operation.config.empty() && !app_.current_preset(operation.bus)) {
+		return "Preset not running";
+	}
+
+	return nullptr;
+}
+
+const char *WebInterface::apply_batch(std::vector<BusOperation> &operations) {
+	std::vector<std::shared_ptr<Preset>> running(operations.size());
+
+	/*
+	 * Validate every operation before changing anything so that a batch
+	 * that fails is not partially applied.
+	 */
+	for (size_t i = 0; i < operations.size(); i++) {
+		auto &operation = operations[i];
+
+		if (operation.preset && app_.unsaved_preset(operation.bus))
+			return "Access denied: current preset is unsaved";
+
+		if (!operation.config.empty()) {
+			running[i] = app_.current_preset(operation.bus);
+
+			if (!running[i])
+				return "Preset not running";
+
+			for (auto &config : operation.config) {
+				if (running[i]->check_config(config.first, config.second) != Result::OK)
+					return "Invalid config property or value";
+			}
+		}
+	}
+
+	const char *message = nullptr;
+
+	for (size_t i = 0; i < operations.size(); i++) {
+		auto &operation = operations[i];
+		auto &bus = operation.bus;
+
+		if (operation.length_set)
+			bus->length(operation.length);
+
+		if (operation.format_set)
+			bus->format(operation.format);
+
+		if (operation.reverse_set)
+			bus->reverse(operation.reverse);
+
+		if (operation.fps_set)
+			bus->default_fps(operation.fps);
+
+		/* Unsaved presets have already been rejected, so this can't fail */
+		if (operation.preset) {
+			app_.start(bus, operation.preset);
+
+			if (operation.set_default)
+				bus->default_preset(operation.preset->name());
+		}
+
+		for (auto &config : operation.config) {
+			/* Only fails if the script changes its config concurrently */
+			if (running[i]->set_config(config.first, config.second) != Result::OK)
+				message = "Invalid config property or value";
+		}
+	}
+
+	return message;
+}
+
 std::unordered_map<std::string_view,std::string_view>
 		WebInterface::parse_form(std::string_view text) {
 	std::unordered_map<std::string_view,std::string_view> params;
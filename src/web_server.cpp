@@ -29,14 +29,20 @@
 #else
 # include <arpa/inet.h>
 # include <esp_http_server.h>
+# include <esp_idf_version.h>
+# include <esp_pthread.h>
 # include <sys/socket.h>
 #endif
 
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #ifndef PSTR_ALIGN
@@ -57,7 +63,13 @@ WebServer::WebServer(uint16_t port) {
 	if (port_env)
 		port = std::strtol(port_env, nullptr, 0);
 
-	daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD, port, nullptr,
+	/*
+	 * Event streams wait for the next event in the content reader callback,
+	 * which would stall all other connections if they shared one polling
+	 * thread. Native builds are only used for development so a thread for
+	 * every connection is acceptable.
+	 */
+	daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_THREAD_PER_CONNECTION, port, nullptr,
 		nullptr, &handle_connection, this,
 		MHD_OPTION_NOTIFY_COMPLETED, &cleanup_connection, nullptr,
 		MHD_OPTION_URI_LOG_CALLBACK, &log_connection, nullptr,
@@ -124,7 +136,8 @@ bool WebServer::add_get_handler(const std::string &uri, get_function handler) {
 #endif
 }
 
-bool WebServer::add_post_handler(const std::string &uri, get_function handler) {
+bool WebServer::add_post_handler(const std::string &uri, get_function handler,
+		size_t max_length) {
 #ifdef ENV_NATIVE
 	if (!daemon_)
 		return false;
@@ -133,7 +146,7 @@ bool WebServer::add_post_handler(const std::string &uri, get_function handler) {
 		return false;
 #endif
 
-	uri_handlers_.push_back(std::make_unique<PostURIHandler>(uri, std::move(handler)));
+	uri_handlers_.push_back(std::make_unique<PostURIHandler>(uri, std::move(handler), max_length));
 
 #ifdef ENV_NATIVE
 	return true;
@@ -174,6 +187,35 @@ bool WebServer::add_static_content(const std::string &uri, const char *content_t
 #endif
 }
 
+bool WebServer::add_event_handler(const std::string &uri, event_function handler) {
+#ifdef ENV_NATIVE
+	if (!daemon_)
+		return false;
+#else
+	if (!handle_)
+		return false;
+
+# if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 0)
+	logger_.crit("Event streams not supported for URI %s", uri.c_str());
+	return false;
+# endif
+#endif
+
+	uri_handlers_.push_back(std::make_unique<EventURIHandler>(uri, std::move(handler)));
+
+#ifdef ENV_NATIVE
+	return true;
+#else
+	if (uri_handlers_.back()->server_register(handle_.get()))
+		return true;
+
+	logger_.crit("Failed to register GET handler for URI %s", uri.c_str());
+
+	uri_handlers_.pop_back();
+	return false;
+#endif
+}
+
 WebServer::URIHandler::URIHandler(const std::string &uri) : uri_(uri) {
 }
 
@@ -201,8 +243,8 @@ WebServer::GetURIHandler::GetURIHandler(const std::string &uri, get_function han
 		: URIHandler(uri), function_(handler) {
 }
 
-WebServer::PostURIHandler::PostURIHandler(const std::string &uri, post_function handler)
-		: URIHandler(uri), function_(handler) {
+WebServer::PostURIHandler::PostURIHandler(const std::string &uri, post_function handler,
+		size_t max_length) : URIHandler(uri), function_(handler), max_length_(max_length) {
 }
 
 WebServer::StaticContentURIHandler::StaticContentURIHandler(const std::string &uri,
@@ -212,6 +254,10 @@ WebServer::StaticContentURIHandler::StaticContentURIHandler(const std::string &u
 		data_(data) {
 }
 
+WebServer::EventURIHandler::EventURIHandler(const std::string &uri, event_function handler)
+		: URIHandler(uri), function_(handler) {
+}
+
 #ifdef ENV_NATIVE
 std::string WebServer::GetURIHandler::method() {
 	return "GET";
@@ -230,6 +276,11 @@ std::string WebServer::PostURIHandler::method() {
 }
 
 MHD_Result WebServer::PostURIHandler::handle_connection(Request &req) {
+	if (req.too_large()) {
+		req.set_status(413);
+		return req.finish();
+	}
+
 	if (function_(req)) {
 		return req.finish();
 	} else {
@@ -257,6 +308,40 @@ MHD_Result WebServer::StaticContentURIHandler::handle_connection(Request &req) {
 	req.write(reinterpret_cast<const uint8_t*>(data_.begin()), data_.length());
 	return req.finish();
 }
+
+std::string WebServer::EventURIHandler::method() {
+	return "GET";
+}
+
+MHD_Result WebServer::EventURIHandler::handle_connection(Request &req) {
+	auto stream = std::make_shared<EventStream>();
+
+	if (!function_(stream)) {
+		req.set_status(503);
+		req.set_type("text/plain");
+		return req.finish();
+	}
+
+	auto response = wrap_response(MHD_create_response_from_callback(
+			MHD_SIZE_UNKNOWN, 1024, &EventURIHandler::read_events,
+			new std::shared_ptr<EventStream>{stream}, &EventURIHandler::free_events));
+
+	MHD_add_response_header(response.get(), MHD_HTTP_HEADER_CONTENT_TYPE, "text/event-stream");
+	MHD_add_response_header(response.get(), MHD_HTTP_HEADER_CACHE_CONTROL, "no-cache");
+
+	return MHD_queue_response(req.connection_, 200, response.get());
+}
+
+ssize_t WebServer::EventURIHandler::read_events(void *cls, uint64_t pos, char *buf, size_t max) {
+	return (**reinterpret_cast<std::shared_ptr<EventStream>*>(cls)).read(buf, max);
+}
+
+void WebServer::EventURIHandler::free_events(void *cls) {
+	auto *stream = reinterpret_cast<std::shared_ptr<EventStream>*>(cls);
+
+	(**stream).close();
+	delete stream;
+}
 #else
 httpd_method_t WebServer::GetURIHandler::method() {
 	return HTTP_GET;
@@ -280,6 +365,13 @@ httpd_method_t WebServer::PostURIHandler::method() {
 esp_err_t WebServer::PostURIHandler::handler_function(httpd_req_t *req) {
 	Request ws_req{req};
 
+	/* Chunked requests are not supported so the length is always known */
+	if (req->content_len > max_length_) {
+		ws_req.set_status(413);
+		ws_req.finish();
+		return ESP_OK;
+	}
+
 	if (function_(ws_req)) {
 		ws_req.finish();
 		return ESP_OK;
@@ -307,6 +399,152 @@ esp_err_t WebServer::StaticContentURIHandler::handler_function(httpd_req_t *req)
 
 	return httpd_resp_send(req, data_.begin(), data_.length());
 }
+
+httpd_method_t WebServer::EventURIHandler::method() {
+	return HTTP_GET;
+}
+
+esp_err_t WebServer::EventURIHandler::handler_function(httpd_req_t *req) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+	auto stream = std::make_shared<EventStream>();
+
+	if (!function_(stream)) {
+		Request ws_req{req};
+
+		ws_req.set_status(503);
+		ws_req.set_type("text/plain");
+		ws_req.finish();
+		return ESP_OK;
+	}
+
+	/*
+	 * Streaming responses would block the server task, so continue the
+	 * request asynchronously on its own thread.
+	 */
+	httpd_req_t *async_req{nullptr};
+
+	if (httpd_req_async_handler_begin(req, &async_req) != ESP_OK) {
+		stream->close();
+		return ESP_FAIL;
+	}
+
+	try {
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+
+		std::thread{&EventURIHandler::stream_events, async_req, stream}.detach();
+		return ESP_OK;
+	} catch (...) {
+		logger_.emerg("Out of memory");
+		stream->close();
+		httpd_req_async_handler_complete(async_req);
+		return ESP_FAIL;
+	}
+#else
+	return ESP_FAIL;
+#endif
+}
+
+void WebServer::EventURIHandler::stream_events(httpd_req_t *req, std::shared_ptr<EventStream> stream) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+	std::string text;
+
+	httpd_resp_set_status(req, HTTPD_200);
+	httpd_resp_set_type(req, "text/event-stream");
+	httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+	while (true) {
+		if (!stream->receive(text, EventStream::KEEPALIVE_MS)) {
+			if (stream->closed())
+				break;
+
+			text = ":\n\n";
+		}
+
+		if (httpd_resp_send_chunk(req, text.data(), text.length()) != ESP_OK)
+			break;
+	}
+
+	stream->close();
+	httpd_resp_send_chunk(req, nullptr, 0);
+	httpd_req_async_handler_complete(req);
+#endif
+}
+#endif
+
+bool WebServer::EventStream::send(const char *event, const std::string &data) {
+	std::lock_guard lock{mutex_};
+
+	if (closed_)
+		return false;
+
+	if (events_.size() >= MAX_QUEUED_EVENTS) {
+		events_.pop_front();
+		dropped_++;
+	}
+
+	events_.emplace_back(std::string{"event: "}.append(event)
+		.append("\ndata: ").append(data).append("\n\n"));
+	cv_.notify_all();
+	return true;
+}
+
+bool WebServer::EventStream::closed() {
+	std::lock_guard lock{mutex_};
+	return closed_;
+}
+
+unsigned long WebServer::EventStream::dropped() {
+	std::lock_guard lock{mutex_};
+	return dropped_;
+}
+
+bool WebServer::EventStream::receive(std::string &text, unsigned long timeout_ms) {
+	std::unique_lock lock{mutex_};
+
+	cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] {
+		return closed_ || !events_.empty();
+	});
+
+	if (closed_ || events_.empty())
+		return false;
+
+	text = std::move(events_.front());
+	events_.pop_front();
+	return true;
+}
+
+void WebServer::EventStream::close() {
+	std::lock_guard lock{mutex_};
+
+	closed_ = true;
+	events_.clear();
+	cv_.notify_all();
+}
+
+#ifdef ENV_NATIVE
+ssize_t WebServer::EventStream::read(char *buffer, size_t max) {
+	if (pending_pos_ == pending_.length()) {
+		pending_pos_ = 0;
+
+		if (!receive(pending_, KEEPALIVE_MS)) {
+			if (closed()) {
+				pending_.clear();
+				return MHD_CONTENT_READER_END_OF_STREAM;
+			}
+
+			pending_ = ":\n\n";
+		}
+	}
+
+	size_t len = std::min(max, pending_.length() - pending_pos_);
+
+	std::memcpy(buffer, &pending_[pending_pos_], len);
+	pending_pos_ += len;
+	return len;
+}
 #endif
 
 #ifdef ENV_NATIVE
@@ -329,7 +567,14 @@ bool WebServer::Request::first() {
 	}
 }
 
-void WebServer::Request::upload(const char *data, size_t len) {
+/* Stop storing the request body as soon as it's too long */
+void WebServer::Request::upload(const char *data, size_t len, size_t max_length) {
+	if (too_large_ || len > max_length - upload_data_.size()) {
+		too_large_ = true;
+		upload_data_.clear();
+		return;
+	}
+
 	upload_data_.resize(upload_data_.size() + len);
 	std::memcpy(&upload_data_[upload_data_.size() - len], data, len);
 }
@@ -476,14 +721,20 @@ void WebServer::Request::set_status(unsigned int status) {
 #else
 	if (status == 200) {
 		httpd_resp_set_status(req_, HTTPD_200);
+	} else if (status == 204) {
+		httpd_resp_set_status(req_, HTTPD_204);
 	} else if (status == 303) {
 		httpd_resp_set_status(req_, "303 See Other");
+	} else if (status == 304) {
+		httpd_resp_set_status(req_, "304 Not Modified");
 	} else if (status == 400) {
 		httpd_resp_set_status(req_, HTTPD_400);
 	} else if (status == 404) {
 		httpd_resp_set_status(req_, HTTPD_404);
 	} else if (status == 413) {
 		httpd_resp_set_status(req_, "413 Request Entity Too Large");
+	} else if (status == 503) {
+		httpd_resp_set_status(req_, "503 Service Unavailable");
 	} else {
 		httpd_resp_set_status(req_, HTTPD_500);
 	}
@@ -633,7 +884,7 @@ MHD_Result WebServer::handle_connection(struct MHD_Connection *connection,
 			if ((**req).first()) {
 				return MHD_YES;
 			} else if (upload_data && *upload_data_size) {
-				(**req).upload(upload_data, *upload_data_size);
+				(**req).upload(upload_data, *upload_data_size, uri_handler->max_length());
 				*upload_data_size = 0;
 				return MHD_YES;
 			} else {
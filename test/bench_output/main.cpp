@@ -0,0 +1,197 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <unity.h>
+#include <Arduino.h>
+
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "aurcor/led_bus.h"
+#include "aurcor/led_profiles.h"
+#include "test_micropython.h"
+
+/*
+ * Measures the throughput of output_leds() for each type of input and the
+ * allocations made by the timing functions. Results are printed as one JSON
+ * object per line (prefixed with "BENCH ") so that they can be extracted and
+ * compared between builds.
+ */
+
+static constexpr std::array<size_t,3> lengths{100, 500, 1000};
+static constexpr unsigned long MIN_DURATION_US = 1000000;
+static constexpr unsigned int ALLOC_FRAMES = 10;
+
+static std::string bench = R"python(
+import aurcor
+import gc
+
+def bench(values, output):
+	output(values)
+
+	gc.collect()
+	gc.disable()
+	before = gc.mem_alloc()
+	for i in range()python" + std::to_string(ALLOC_FRAMES) + R"python():
+		output(values)
+	alloc = gc.mem_alloc() - before
+	gc.enable()
+
+	gc.collect()
+	frames = 0
+	start = aurcor.ticks64_us()
+	now = start
+	while now - start < )python" + std::to_string(MIN_DURATION_US) + R"python(:
+		output(values)
+		frames += 1
+		now = aurcor.ticks64_us()
+
+	print(frames, now - start, alloc)
+)python";
+
+static void run_bench(const char *input, const std::string &script) {
+	for (size_t length : lengths) {
+		auto bus = std::make_shared<aurcor::NullLEDBus>("bench");
+		TestMicroPython mp{bus};
+		unsigned long frames = 0;
+		unsigned long elapsed_us = 0;
+		unsigned long alloc_bytes = 0;
+
+		auto &profile = bus->profile(LED_PROFILE_NORMAL);
+		profile.clear();
+		profile.set(0, 255, 255, 255);
+		bus->length(length);
+
+		mp.run(bench + script);
+
+		TEST_ASSERT_EQUAL_INT_MESSAGE(0, mp.ret_, mp.output_.c_str());
+		TEST_ASSERT_EQUAL_INT(3, std::sscanf(mp.output_.c_str(), "%lu %lu %lu",
+			&frames, &elapsed_us, &alloc_bytes));
+		TEST_ASSERT_GREATER_THAN_UINT32(0, frames);
+
+		std::printf("BENCH {\"input\": \"%s\", \"leds\": %zu, \"frames\": %lu,"
+			" \"fps\": %.1f, \"ns_per_led\": %.1f, \"alloc_bytes_per_frame\": %.1f}\n",
+			input, length, frames,
+			frames * 1000000.0 / elapsed_us,
+			elapsed_us * 1000.0 / frames / length,
+			alloc_bytes / (double)ALLOC_FRAMES);
+	}
+}
+
+static void bench_bytearray() {
+	run_bench("bytearray", R"python(
+bench(bytearray(aurcor.length() * 3), lambda values: aurcor.output_rgb(values, wait_us=0))
+)python");
+}
+
+static void bench_int_array() {
+	run_bench("int_array", R"python(
+import array
+bench(array.array('i', range(aurcor.length())), lambda values: aurcor.output_rgb(values, wait_us=0))
+)python");
+}
+
+static void bench_hue_array() {
+	run_bench("hue_array", R"python(
+import array
+bench(array.array('H', [x % aurcor.EXP_HUE_RANGE for x in range(aurcor.length())]),
+	lambda values: aurcor.output_exp_hsv(values, wait_us=0))
+)python");
+}
+
+static void bench_list_tuple() {
+	run_bench("list_tuple", R"python(
+bench([(x & 0xFF, 0, 0) for x in range(aurcor.length())], lambda values: aurcor.output_rgb(values, wait_us=0))
+)python");
+}
+
+static void bench_generator() {
+	run_bench("generator", R"python(
+bench(aurcor.length(), lambda n: aurcor.output_rgb(((x & 0xFF, 0, 0) for x in range(n)), wait_us=0))
+)python");
+}
+
+/*
+ * The clock starts beyond the small int range of the host so that 64-bit
+ * timestamps allocate a long int here in the same way as they do on the
+ * device (where small ints are only 31 bits).
+ */
+static constexpr uint64_t TIMING_START_US = 1ULL << 62;
+
+static void run_timing_bench(const char *function, const char *call) {
+	auto bus = std::make_shared<aurcor::NullLEDBus>("bench");
+	TestMicroPython mp{bus};
+	unsigned long alloc_bytes = 0;
+
+	mp.simulate_clock(TIMING_START_US);
+	mp.run(std::string{R"python(
+import aurcor
+import gc
+
+)python"} + "call = lambda: " + call + R"python(
+call()
+
+gc.collect()
+gc.disable()
+before = gc.mem_alloc()
+for i in range()python" + std::to_string(ALLOC_FRAMES) + R"python():
+	call()
+alloc = gc.mem_alloc() - before
+gc.enable()
+
+print(alloc)
+)python");
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, mp.ret_, mp.output_.c_str());
+	TEST_ASSERT_EQUAL_INT(1, std::sscanf(mp.output_.c_str(), "%lu", &alloc_bytes));
+
+	std::printf("BENCH {\"timing\": \"%s\", \"alloc_bytes_per_frame\": %.1f}\n",
+		function, alloc_bytes / (double)ALLOC_FRAMES);
+}
+
+static void bench_timing() {
+	run_timing_bench("ticks64_us", "aurcor.ticks64_us()");
+	run_timing_bench("ticks30_us", "aurcor.ticks30_us()");
+	run_timing_bench("ticks30_diff", "aurcor.ticks30_diff(aurcor.ticks30_us(), 0)");
+	run_timing_bench("next_ticks64_us", "aurcor.next_ticks64_us(wait_us=0)");
+	run_timing_bench("next_ticks64_us_mod", "aurcor.next_ticks64_us(wait_us=0, mod=25000000)");
+	run_timing_bench("next_ticks30_us", "aurcor.next_ticks30_us(wait_us=0)");
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(bench_bytearray);
+	RUN_TEST(bench_int_array);
+	RUN_TEST(bench_hue_array);
+	RUN_TEST(bench_list_tuple);
+	RUN_TEST(bench_generator);
+	RUN_TEST(bench_timing);
+
+	return UNITY_END();
+}
@@ -0,0 +1,292 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <unity.h>
+#include <Arduino.h>
+#include <dirent.h>
+#include <time.h>
+
+extern "C" {
+	#include <py/gc.h>
+	#include <py/persistentcode.h>
+	#include <py/runtime.h>
+}
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "app/fs.h"
+#include "aurcor/app.h"
+#include "aurcor/led_bus.h"
+#include "aurcor/led_profiles.h"
+#include "aurcor/micropython.h"
+#include "aurcor/preset.h"
+#include "test_micropython.h"
+
+/*
+ * Runs every preset headless, with a simulated clock so that waiting for the
+ * next frame takes no time, and measures how long each frame takes to
+ * generate. Results are printed as one JSON object per line (prefixed with
+ * "BENCH ") so that they can be extracted and compared between builds.
+ *
+ * The presets and compiled scripts are copied from the host "data" directory
+ * (built by "make fs").
+ */
+
+#ifndef BENCH_PRESETS_DATA
+# define BENCH_PRESETS_DATA "data"
+#endif
+
+#ifndef BENCH_PRESETS_LENGTH
+# define BENCH_PRESETS_LENGTH 300
+#endif
+
+static constexpr size_t FRAMES = 500;
+static constexpr unsigned long MAX_DURATION_MS = 5000;
+
+using app::FS;
+
+static uint64_t thread_cpu_time_ns() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+class BenchLEDBus: public aurcor::LEDBus {
+public:
+	BenchLEDBus() : aurcor::LEDBus("bench") {}
+	virtual ~BenchLEDBus() = default;
+
+	const char *type() const override { return "BenchLEDBus"; }
+
+protected:
+	void start(const uint8_t *data, size_t size, bool reverse_order) override {
+		finish();
+	}
+};
+
+class BenchMicroPython: public TestMicroPython {
+public:
+	BenchMicroPython(std::shared_ptr<BenchLEDBus> bus, std::shared_ptr<aurcor::Preset> preset)
+			: TestMicroPython(bus, preset), bench_bus_(bus), script_(preset->script()) {
+		clock().simulate(0);
+	}
+
+	void run() {
+		TEST_ASSERT_TRUE(MicroPython::start());
+
+		unsigned long start = millis();
+		while (running() && bench_bus_->frames() <= FRAMES
+				&& millis() - start < MAX_DURATION_MS)
+			yield();
+
+		while (!stop())
+			yield();
+	}
+
+	std::vector<uint64_t> frame_ns_;
+	std::vector<uint64_t> gc_frame_ns_;
+	size_t heap_peak_{0};
+	uint64_t first_us_{0};
+	uint64_t last_us_{0};
+
+protected:
+	void main() override {
+		nlr_buf_t nlr;
+		nlr.ret_val = nullptr;
+		if (!nlr_push(&nlr)) {
+			std::string filename = script_ + aurcor::MicroPython::FILENAME_EXT;
+			mp_module_context_t *context = m_new_obj(mp_module_context_t);
+			context->module.globals = mp_globals_get();
+			mp_compiled_module_t cm = mp_raw_code_load_file(filename.c_str(), context);
+			mp_obj_t module_fun = mp_make_function_from_raw_code(cm.rc, cm.context, NULL);
+
+			mp_call_function_0(module_fun);
+			mp_handle_pending(true);
+			nlr_pop();
+
+			ret_ = 0;
+		} else {
+			mp_handle_pending(false);
+			if (!stopping())
+				mp_obj_print_exception(&mp_plat_print, MP_OBJ_FROM_PTR(nlr.ret_val));
+
+			ret_ = 1;
+		}
+	}
+
+	/*
+	 * Called on the interpreter thread when the script writes a frame,
+	 * regardless of when the bus transmits it.
+	 */
+	void frame_written() override {
+		uint64_t now_ns = thread_cpu_time_ns();
+		gc_info_t info;
+
+		gc_info(&info);
+		heap_peak_ = std::max(heap_peak_, info.used);
+		last_us_ = mp_hal_clock_us();
+
+		if (started_) {
+			frame_ns_.push_back(now_ns - last_ns_);
+
+			/* Less heap in use than last frame means a collection has happened */
+			if (info.used < heap_used_)
+				gc_frame_ns_.push_back(now_ns - last_ns_);
+		} else {
+			first_us_ = last_us_;
+			started_ = true;
+		}
+
+		heap_used_ = info.used;
+		last_ns_ = thread_cpu_time_ns();
+	}
+
+private:
+	std::shared_ptr<BenchLEDBus> bench_bus_;
+	std::string script_;
+	bool started_{false};
+	uint64_t last_ns_{0};
+	size_t heap_used_{0};
+};
+
+static std::vector<std::string> host_filenames(const std::string &directory, const std::string &ext) {
+	std::vector<std::string> filenames;
+	DIR *dir = opendir((std::string{BENCH_PRESETS_DATA} + directory).c_str());
+
+	if (dir) {
+		struct dirent *entry;
+
+		while ((entry = readdir(dir))) {
+			std::string name = entry->d_name;
+
+			if (name.length() > ext.length()
+					&& name.compare(name.length() - ext.length(), ext.length(), ext) == 0)
+				filenames.push_back(name.substr(0, name.length() - ext.length()));
+		}
+
+		closedir(dir);
+	}
+
+	std::sort(filenames.begin(), filenames.end());
+	return filenames;
+}
+
+static void copy_host_files(const std::string &directory, const std::string &ext) {
+	for (auto &name : host_filenames(directory, ext)) {
+		std::string filename = directory + "/" + name + ext;
+		std::ifstream input{BENCH_PRESETS_DATA + filename, std::ios::binary};
+		std::vector<char> data{std::istreambuf_iterator<char>{input}, {}};
+		auto file = FS.open(filename.c_str(), "w", true);
+
+		TEST_ASSERT_TRUE_MESSAGE(file, filename.c_str());
+		TEST_ASSERT_EQUAL_INT_MESSAGE(data.size(),
+			file.write(reinterpret_cast<const uint8_t *>(data.data()), data.size()),
+			filename.c_str());
+	}
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, unsigned int pct) {
+	return sorted[std::min(sorted.size() - 1, sorted.size() * pct / 100)];
+}
+
+static void bench_presets() {
+	auto presets = host_filenames(aurcor::Preset::DIRECTORY_NAME, aurcor::Preset::FILENAME_EXT);
+
+	TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, presets.size(), "No presets in " BENCH_PRESETS_DATA ", run \"make fs\"");
+
+	copy_host_files(aurcor::MicroPython::DIRECTORY_NAME, aurcor::MicroPython::FILENAME_EXT);
+	copy_host_files(aurcor::Preset::DIRECTORY_NAME, aurcor::Preset::FILENAME_EXT);
+
+	for (auto &name : presets) {
+		auto bus = std::make_shared<BenchLEDBus>();
+		auto preset = std::make_shared<aurcor::Preset>(TestMicroPython::app(), bus);
+
+		auto &profile = bus->profile(LED_PROFILE_NORMAL);
+		profile.clear();
+		profile.set(0, 255, 255, 255);
+		bus->length(BENCH_PRESETS_LENGTH);
+
+		TEST_ASSERT_TRUE_MESSAGE(preset->name(name), name.c_str());
+		TEST_ASSERT_EQUAL_INT_MESSAGE(static_cast<int>(aurcor::Result::OK),
+			static_cast<int>(preset->load()), name.c_str());
+
+		BenchMicroPython mp{bus, preset};
+		mp.run();
+
+		auto &frames = mp.frame_ns_;
+		auto &gc_frames = mp.gc_frame_ns_;
+
+		if (frames.empty()) {
+			std::printf("BENCH {\"preset\": \"%s\", \"script\": \"%s\", \"frames\": 0}\n",
+				name.c_str(), preset->script().c_str());
+			continue;
+		}
+
+		uint64_t total_ns = 0;
+		uint64_t gc_total_ns = 0;
+
+		for (auto frame_ns : frames)
+			total_ns += frame_ns;
+
+		for (auto frame_ns : gc_frames)
+			gc_total_ns += frame_ns;
+
+		std::sort(frames.begin(), frames.end());
+		std::sort(gc_frames.begin(), gc_frames.end());
+
+		uint64_t virtual_us = mp.last_us_ - mp.first_us_;
+
+		std::printf("BENCH {\"preset\": \"%s\", \"script\": \"%s\", \"leds\": %u,"
+			" \"frames\": %zu, \"fps\": %.1f, \"max_fps\": %.1f,"
+			" \"frame_us\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f},"
+			" \"gc\": {\"count\": %zu, \"total_us\": %.1f, \"max_us\": %.1f},"
+			" \"heap_peak_bytes\": %zu}\n",
+			name.c_str(), preset->script().c_str(), BENCH_PRESETS_LENGTH,
+			frames.size(),
+			virtual_us ? frames.size() * 1000000.0 / virtual_us : 0.0,
+			total_ns ? frames.size() * 1000000000.0 / total_ns : 0.0,
+			percentile(frames, 50) / 1000.0, percentile(frames, 90) / 1000.0,
+			percentile(frames, 99) / 1000.0, frames.back() / 1000.0,
+			gc_frames.size(), gc_total_ns / 1000.0,
+			gc_frames.empty() ? 0.0 : gc_frames.back() / 1000.0,
+			mp.heap_peak_);
+	}
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(bench_presets);
+
+	return UNITY_END();
+}
@@ -0,0 +1,158 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity.h>
+
+#include <array>
+
+#include "aurcor/compositor.h"
+
+#include "test_led_bus.h"
+#include "test_micropython.h"
+
+using aurcor::Compositor;
+using Blend = Compositor::Blend;
+
+static void test_blend_modes() {
+	Compositor compositor{3};
+	std::array<uint8_t,3> frame{100, 200, 0};
+	uint8_t *layer = compositor.layer(0, Blend::ADD, Compositor::MAX_OPACITY);
+
+	layer[0] = 100;
+	layer[1] = 100;
+	layer[2] = 255;
+	compositor.apply(frame.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(200, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(255, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(255, frame[2]);
+
+	compositor.layer(0, Blend::MULTIPLY, Compositor::MAX_OPACITY);
+	frame = {100, 200, 0};
+	compositor.apply(frame.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(39, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(78, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(0, frame[2]);
+
+	compositor.layer(0, Blend::MAX, Compositor::MAX_OPACITY);
+	frame = {100, 200, 0};
+	compositor.apply(frame.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(100, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(200, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(255, frame[2]);
+
+	compositor.layer(0, Blend::ALPHA, Compositor::MAX_OPACITY);
+	frame = {100, 200, 0};
+	compositor.apply(frame.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(100, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(100, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(255, frame[2]);
+
+	compositor.layer(0, Blend::NONE, Compositor::MAX_OPACITY);
+	frame = {100, 200, 0};
+	compositor.apply(frame.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(100, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(200, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(0, frame[2]);
+}
+
+static void test_opacity() {
+	Compositor compositor{3};
+	std::array<uint8_t,3> frame{0, 255, 100};
+	uint8_t *layer = compositor.layer(0, Blend::ALPHA, 128);
+
+	layer[0] = 255;
+	layer[1] = 0;
+	layer[2] = 100;
+	compositor.apply(frame.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(128, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(127, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(100, frame[2]);
+
+	compositor.layer(0, Blend::ALPHA, 0);
+	frame = {0, 255, 100};
+	compositor.apply(frame.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(0, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(255, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(100, frame[2]);
+}
+
+static void test_layer_order() {
+	Compositor compositor{3};
+	std::array<uint8_t,3> frame{10, 10, 10};
+	uint8_t *layer0 = compositor.layer(0, Blend::ALPHA, Compositor::MAX_OPACITY);
+	uint8_t *layer1 = compositor.layer(1, Blend::ADD, Compositor::MAX_OPACITY);
+
+	layer0[0] = layer0[1] = layer0[2] = 50;
+	layer1[0] = layer1[1] = layer1[2] = 5;
+	compositor.apply(frame.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(55, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(55, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(55, frame[2]);
+}
+
+static void test_copy() {
+	Compositor compositor{3};
+	std::array<uint8_t,3> frame{10, 20, 30};
+	std::array<uint8_t,3> output{};
+	uint8_t *layer = compositor.layer(0, Blend::ADD, Compositor::MAX_OPACITY);
+
+	layer[0] = layer[1] = layer[2] = 5;
+	compositor.apply(frame.data(), output.data(), frame.size());
+	TEST_ASSERT_EQUAL_UINT8(15, output[0]);
+	TEST_ASSERT_EQUAL_UINT8(25, output[1]);
+	TEST_ASSERT_EQUAL_UINT8(35, output[2]);
+	TEST_ASSERT_EQUAL_UINT8(10, frame[0]);
+	TEST_ASSERT_EQUAL_UINT8(20, frame[1]);
+	TEST_ASSERT_EQUAL_UINT8(30, frame[2]);
+}
+
+static void test_script_layer() {
+	auto bus = TestMicroPython::run_bus(1, 2, R"python(
+import aurcor
+frame = aurcor.frame()
+frame[0:3] = bytes((10, 20, 30))
+layer = aurcor.layer(0)
+aurcor.show()
+layer[0:3] = bytes((1, 2, 3))
+aurcor.show()
+	)python");
+
+	/* A new layer has no effect by default and the frame isn't modified */
+	std::array<uint8_t,3> expected1{10,20,30};
+	std::array<uint8_t,3> expected2{11,22,33};
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected1.data(), bus->outputs_[0].data(), expected1.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected2.data(), bus->outputs_[1].data(), expected2.size());
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(test_blend_modes);
+	RUN_TEST(test_opacity);
+	RUN_TEST(test_layer_order);
+	RUN_TEST(test_copy);
+	RUN_TEST(test_script_layer);
+
+	return UNITY_END();
+}
@@ -20,6 +20,7 @@
 #include <Arduino.h>
 
 #include <memory>
+#include <vector>
 
 #include "aurcor/app.h"
 #include "aurcor/preset.h"
@@ -67,6 +68,73 @@ aurcor.register_config({
 	// TODO check output
 }
 
+static void test_native() {
+	using Type = aurcor::ScriptConfig::Type;
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	auto preset = std::make_shared<aurcor::Preset>(test_app, bus);
+	int32_t duration = 0;
+	bool real_time = true;
+	std::vector<int32_t> colours;
+
+	preset->register_config([] (aurcor::ScriptConfig &config) {
+		config.register_property("duration", Type::S32).as_s32().set_default(25000);
+		config.register_property("real_time", Type::BOOL);
+		config.register_property("colours", Type::LIST_RGB).as_s32_list().defaults() = {0};
+	});
+
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, preset->set_config("duration", "1000"));
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, preset->add_config("colours", "#FF9900"));
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, preset->add_config("colours", "00FF00"));
+
+	TEST_ASSERT_TRUE(preset->populate_config([&] (const aurcor::ScriptConfig &config) {
+		TEST_ASSERT_TRUE(config.get("duration", duration));
+		TEST_ASSERT_FALSE(config.get("real_time", real_time));
+		TEST_ASSERT_TRUE(config.get("colours", colours));
+		TEST_ASSERT_FALSE(config.get("missing", duration));
+	}));
+
+	TEST_ASSERT_EQUAL_INT(1000, duration);
+	TEST_ASSERT_TRUE(real_time);
+	TEST_ASSERT_EQUAL_INT(2, colours.size());
+	TEST_ASSERT_EQUAL_HEX32(0xFF9900, colours[0]);
+	TEST_ASSERT_EQUAL_HEX32(0x00FF00, colours[1]);
+
+	TEST_ASSERT_FALSE(preset->populate_config([] (const aurcor::ScriptConfig &config) {}));
+
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, preset->set_config("duration", ""));
+	TEST_ASSERT_TRUE(preset->populate_config([&] (const aurcor::ScriptConfig &config) {
+		TEST_ASSERT_TRUE(config.get("duration", duration));
+	}));
+	TEST_ASSERT_EQUAL_INT(25000, duration);
+}
+
+static void test_check() {
+	using Type = aurcor::ScriptConfig::Type;
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	auto preset = std::make_shared<aurcor::Preset>(test_app, bus);
+	int32_t duration = 0;
+
+	preset->register_config([] (aurcor::ScriptConfig &config) {
+		config.register_property("duration", Type::S32).as_s32().set_default(25000);
+		config.register_property("real_time", Type::BOOL);
+		config.register_property("colours", Type::LIST_RGB);
+	});
+
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, preset->check_config("duration", "1000"));
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, preset->check_config("duration", ""));
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OUT_OF_RANGE, preset->check_config("duration", "x"));
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, preset->check_config("real_time", "false"));
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OUT_OF_RANGE, preset->check_config("real_time", "maybe"));
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OUT_OF_RANGE, preset->check_config("colours", "#FF9900"));
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::NOT_FOUND, preset->check_config("missing", "1"));
+
+	TEST_ASSERT_FALSE(preset->modified());
+	TEST_ASSERT_TRUE(preset->populate_config([&] (const aurcor::ScriptConfig &config) {
+		TEST_ASSERT_TRUE(config.get("duration", duration));
+	}));
+	TEST_ASSERT_EQUAL_INT(25000, duration);
+}
+
 void tearDown(void) {
 	TestMicroPython::tearDown();
 }
@@ -77,6 +145,8 @@ int main(int argc, char *argv[]) {
 	TestMicroPython::init();
 
 	RUN_TEST(test_save);
+	RUN_TEST(test_native);
+	RUN_TEST(test_check);
 
 	return UNITY_END();
 }
@@ -0,0 +1,103 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+
+#include <memory>
+
+#include "aurcor/cpu_usage.h"
+
+#include "test_led_bus.h"
+#include "test_micropython.h"
+
+using aurcor::CPUUsage;
+
+static void test_usage() {
+	CPUUsage cpu;
+
+	cpu.start(1000000);
+	TEST_ASSERT_FALSE(cpu.update(1100000));
+
+	/* Running for 100ms then waiting for 900ms */
+	TEST_ASSERT_FALSE(cpu.wait(1100000, 900000));
+	TEST_ASSERT_FALSE(cpu.update(1900000));
+	TEST_ASSERT_TRUE(cpu.update(2000000));
+	TEST_ASSERT_EQUAL_UINT(10, cpu.usage());
+
+	/* Running continuously */
+	TEST_ASSERT_TRUE(cpu.update(3000000));
+	TEST_ASSERT_EQUAL_UINT(100, cpu.usage());
+}
+
+static void test_limit() {
+	CPUUsage cpu;
+
+	cpu.start(0);
+	cpu.update(200000);
+	TEST_ASSERT_EQUAL_UINT64(0, cpu.exceeded_us(200000, 50));
+
+	/* Over the limit until the end of the window */
+	cpu.update(600000);
+	TEST_ASSERT_EQUAL_UINT64(400000, cpu.exceeded_us(600000, 50));
+	TEST_ASSERT_EQUAL_UINT64(0, cpu.exceeded_us(600000, CPUUsage::MAX_LIMIT));
+
+	/* Waiting isn't counted */
+	TEST_ASSERT_FALSE(cpu.wait(600000, 400000));
+	TEST_ASSERT_TRUE(cpu.update(1000000));
+	TEST_ASSERT_EQUAL_UINT(60, cpu.usage());
+	TEST_ASSERT_EQUAL_UINT64(0, cpu.exceeded_us(1000000, 50));
+}
+
+static unsigned int busy_loop_usage(unsigned int limit) {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	TestMicroPython mp{bus};
+
+	bus->cpu_limit(limit);
+	mp.run_for(R"python(
+while True:
+	pass
+	)python", 2500);
+
+	return bus->cpu_usage();
+}
+
+/* A script that never waits is made to wait when it exceeds the limit */
+static void test_throttle() {
+	TEST_ASSERT_GREATER_OR_EQUAL_UINT(90, busy_loop_usage(CPUUsage::MAX_LIMIT));
+
+	unsigned int usage = busy_loop_usage(20);
+	TEST_ASSERT_GREATER_THAN_UINT(0, usage);
+	TEST_ASSERT_LESS_OR_EQUAL_UINT(25, usage);
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(test_usage);
+	RUN_TEST(test_limit);
+	RUN_TEST(test_throttle);
+
+	return UNITY_END();
+}
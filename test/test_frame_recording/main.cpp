@@ -0,0 +1,129 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "aurcor/frame_player.h"
+#include "aurcor/frame_recorder.h"
+
+#include "test_micropython.h"
+
+using aurcor::FramePlayer;
+using aurcor::FrameRecording;
+
+static void round_trip(const std::vector<uint8_t> &frame, const std::vector<uint8_t> &previous,
+		std::vector<uint8_t> &decoded, uint32_t interval_us) {
+	std::vector<uint8_t> record(FrameRecording::MAX_RECORD_SIZE);
+	uint32_t decoded_interval_us = 0;
+
+	size_t length = FrameRecording::encode(interval_us, frame.data(), frame.size(),
+		previous.data(), previous.size(), record.data());
+	TEST_ASSERT_GREATER_THAN_UINT(0, length);
+	TEST_ASSERT_LESS_OR_EQUAL_UINT(FrameRecording::MAX_RECORD_SIZE, length);
+
+	TEST_ASSERT_EQUAL_UINT(length, FrameRecording::decode(record.data(), length,
+		decoded_interval_us, decoded));
+	TEST_ASSERT_EQUAL_UINT32(interval_us, decoded_interval_us);
+	TEST_ASSERT_EQUAL_UINT(frame.size(), decoded.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(frame.data(), decoded.data(), frame.size());
+}
+
+static void test_codec() {
+	std::vector<uint8_t> decoded;
+	std::vector<uint8_t> frame1(30);
+	std::vector<uint8_t> frame2;
+
+	/* Literal followed by a repeating colour */
+	for (size_t i = 0; i < 6; i++)
+		frame1[i] = i * 10;
+	for (size_t i = 6; i < frame1.size(); i++)
+		frame1[i] = (i % 3) + 1;
+
+	round_trip(frame1, {}, decoded, 20000);
+
+	/* Mostly unchanged from the previous frame */
+	frame2 = frame1;
+	frame2[12] = 0xFF;
+	frame2[13] = 0xFE;
+
+	round_trip(frame2, frame1, decoded, 0);
+
+	/* Change of size */
+	frame1.resize(9, 0x42);
+
+	round_trip(frame1, frame2, decoded, 1000000);
+}
+
+static void test_invalid() {
+	std::vector<uint8_t> decoded;
+	uint32_t interval_us;
+
+	/* Truncated */
+	const uint8_t truncated[] = {0x00, 0x06, (6 << 2) | 1, 1, 2, 3};
+	TEST_ASSERT_EQUAL_UINT(0, FrameRecording::decode(truncated, sizeof(truncated),
+		interval_us, decoded));
+
+	/* Repeat at the start of the frame */
+	const uint8_t repeat[] = {0x00, 0x06, (6 << 2) | 2};
+	TEST_ASSERT_EQUAL_UINT(0, FrameRecording::decode(repeat, sizeof(repeat),
+		interval_us, decoded));
+
+	/* Op longer than the frame */
+	const uint8_t overrun[] = {0x00, 0x03, (6 << 2) | 0};
+	TEST_ASSERT_EQUAL_UINT(0, FrameRecording::decode(overrun, sizeof(overrun),
+		interval_us, decoded));
+}
+
+static void test_names() {
+	TEST_ASSERT_TRUE(FrameRecording::valid_name("test"));
+	TEST_ASSERT_TRUE(FrameRecording::valid_name(std::string(FrameRecording::MAX_NAME_LENGTH, 'a')));
+	TEST_ASSERT_FALSE(FrameRecording::valid_name(""));
+	TEST_ASSERT_FALSE(FrameRecording::valid_name("../test"));
+	TEST_ASSERT_FALSE(FrameRecording::valid_name(std::string(FrameRecording::MAX_NAME_LENGTH + 1, 'a')));
+	/* Reserved for the console command */
+	TEST_ASSERT_FALSE(FrameRecording::valid_name("stop"));
+
+	TEST_ASSERT_TRUE(FramePlayer::supported("recording:test"));
+	TEST_ASSERT_FALSE(FramePlayer::supported("test"));
+	TEST_ASSERT_FALSE(FramePlayer::supported("recording:"));
+	TEST_ASSERT_FALSE(FramePlayer::supported("recording:../test"));
+	TEST_ASSERT_FALSE(FramePlayer::supported("recording:/test"));
+	TEST_ASSERT_FALSE(FramePlayer::supported("recording:stop"));
+	TEST_ASSERT_FALSE(FramePlayer::supported("recording:"
+		+ std::string(FrameRecording::MAX_NAME_LENGTH + 1, 'a')));
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(test_codec);
+	RUN_TEST(test_invalid);
+	RUN_TEST(test_names);
+
+	return UNITY_END();
+}
@@ -0,0 +1,91 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity.h>
+
+#include "aurcor/frame_scheduler.h"
+
+#include "test_micropython.h"
+
+using aurcor::FrameScheduler;
+
+static constexpr uint32_t INTERVAL_US = 10000;
+static constexpr uint32_t LATENCY_US = 1000;
+
+static void test_first_frame() {
+	FrameScheduler scheduler{LATENCY_US};
+
+	TEST_ASSERT_EQUAL_UINT64(5000000, scheduler.deadline_us(INTERVAL_US, 5000000));
+	TEST_ASSERT_FALSE(scheduler.output(5000000, INTERVAL_US, 5000000));
+	TEST_ASSERT_EQUAL_UINT64(5010000, scheduler.deadline_us(INTERVAL_US, 5000100));
+
+	/* No interval */
+	TEST_ASSERT_EQUAL_UINT64(5000100, scheduler.deadline_us(0, 5000100));
+
+	scheduler.reset();
+	TEST_ASSERT_EQUAL_UINT64(6000000, scheduler.deadline_us(INTERVAL_US, 6000000));
+	TEST_ASSERT_EQUAL_UINT32(0, scheduler.missed_deadlines());
+}
+
+static void test_no_drift() {
+	FrameScheduler scheduler{LATENCY_US};
+	uint64_t deadline_us = scheduler.deadline_us(INTERVAL_US, 0);
+
+	scheduler.output(deadline_us, INTERVAL_US, 0);
+
+	/* Frames output late (within the latency target) don't delay the next deadline */
+	for (unsigned int i = 1; i <= 100; i++) {
+		deadline_us = scheduler.deadline_us(INTERVAL_US, deadline_us);
+		TEST_ASSERT_EQUAL_UINT64(i * INTERVAL_US, deadline_us);
+		TEST_ASSERT_FALSE(scheduler.output(deadline_us, INTERVAL_US, deadline_us + LATENCY_US));
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(0, scheduler.missed_deadlines());
+}
+
+static void test_missed_deadline() {
+	FrameScheduler scheduler{LATENCY_US};
+
+	scheduler.output(scheduler.deadline_us(INTERVAL_US, 0), INTERVAL_US, 0);
+
+	/* Late, but the next deadline is still in phase */
+	TEST_ASSERT_TRUE(scheduler.output(INTERVAL_US, INTERVAL_US, INTERVAL_US + LATENCY_US + 1));
+	TEST_ASSERT_EQUAL_UINT64(2 * INTERVAL_US, scheduler.deadline_us(INTERVAL_US, INTERVAL_US + LATENCY_US + 1));
+	TEST_ASSERT_EQUAL_UINT32(1, scheduler.missed_deadlines());
+
+	/* More than 2 intervals late, so the frames that were missed are not output */
+	TEST_ASSERT_TRUE(scheduler.output(2 * INTERVAL_US, INTERVAL_US, 4 * INTERVAL_US + 500));
+	TEST_ASSERT_EQUAL_UINT64(5 * INTERVAL_US, scheduler.deadline_us(INTERVAL_US, 4 * INTERVAL_US + 500));
+	TEST_ASSERT_EQUAL_UINT32(2, scheduler.missed_deadlines());
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(test_first_frame);
+	RUN_TEST(test_no_drift);
+	RUN_TEST(test_missed_deadline);
+
+	return UNITY_END();
+}
@@ -0,0 +1,127 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity.h>
+
+#include <array>
+
+#include "aurcor/interpolator.h"
+
+#include "test_micropython.h"
+
+using aurcor::Interpolation;
+
+static void assert_output(const std::array<uint8_t,3> &expected, const Interpolation &frames) {
+	TEST_ASSERT_EQUAL_INT(expected.size(), frames.output().size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), frames.output().data(), expected.size());
+}
+
+static void test_first_frame() {
+	Interpolation frames{3};
+	std::array<uint8_t,3> first{10, 20, 30};
+
+	TEST_ASSERT_TRUE(frames.finished());
+	TEST_ASSERT_FALSE(frames.blend(1000000));
+
+	/* There's no previous frame to interpolate from */
+	frames.add(first.data(), first.size(), 1000000);
+	TEST_ASSERT_FALSE(frames.finished());
+	TEST_ASSERT_TRUE(frames.blend(1000000));
+	assert_output(first, frames);
+	TEST_ASSERT_TRUE(frames.finished());
+	TEST_ASSERT_FALSE(frames.blend(1000001));
+}
+
+static void test_intermediate_frames() {
+	Interpolation frames{3};
+	std::array<uint8_t,3> first{0, 0, 0};
+	std::array<uint8_t,3> second{200, 100, 0};
+
+	frames.add(first.data(), first.size(), 1000000);
+	TEST_ASSERT_TRUE(frames.blend(1000000));
+
+	/* Interpolates over the interval between the two frames */
+	frames.add(second.data(), second.size(), 1100000);
+	TEST_ASSERT_TRUE(frames.blend(1100000));
+	assert_output({0, 0, 0}, frames);
+	TEST_ASSERT_TRUE(frames.blend(1125000));
+	assert_output({50, 25, 0}, frames);
+	TEST_ASSERT_TRUE(frames.blend(1150000));
+	assert_output({100, 50, 0}, frames);
+	TEST_ASSERT_FALSE(frames.finished());
+
+	TEST_ASSERT_TRUE(frames.blend(1200000));
+	assert_output(second, frames);
+	TEST_ASSERT_TRUE(frames.finished());
+	TEST_ASSERT_FALSE(frames.blend(1225000));
+	assert_output(second, frames);
+}
+
+static void test_interrupted() {
+	Interpolation frames{3};
+	std::array<uint8_t,3> first{0, 0, 0};
+	std::array<uint8_t,3> second{200, 100, 0};
+	std::array<uint8_t,3> third{0, 100, 200};
+
+	frames.add(first.data(), first.size(), 1000000);
+	frames.add(second.data(), second.size(), 1100000);
+	TEST_ASSERT_TRUE(frames.blend(1150000));
+	assert_output({100, 50, 0}, frames);
+
+	/* Continues from the current output instead of the previous frame */
+	frames.add(third.data(), third.size(), 1150000);
+	TEST_ASSERT_TRUE(frames.blend(1175000));
+	assert_output({50, 75, 100}, frames);
+	TEST_ASSERT_TRUE(frames.blend(1200000));
+	assert_output(third, frames);
+	TEST_ASSERT_TRUE(frames.finished());
+}
+
+static void test_max_interval() {
+	Interpolation frames{3};
+	std::array<uint8_t,3> first{0, 0, 0};
+	std::array<uint8_t,3> second{200, 100, 0};
+
+	frames.add(first.data(), first.size(), 1000000);
+	TEST_ASSERT_TRUE(frames.blend(1000000));
+
+	/* Long gaps between frames are limited to the maximum interval */
+	frames.add(second.data(), second.size(), 6000000);
+	TEST_ASSERT_TRUE(frames.blend(6000000 + Interpolation::MAX_INTERVAL_US / 2));
+	assert_output({100, 50, 0}, frames);
+	TEST_ASSERT_TRUE(frames.blend(6000000 + Interpolation::MAX_INTERVAL_US));
+	assert_output(second, frames);
+	TEST_ASSERT_TRUE(frames.finished());
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(test_first_frame);
+	RUN_TEST(test_intermediate_frames);
+	RUN_TEST(test_interrupted);
+	RUN_TEST(test_max_interval);
+
+	return UNITY_END();
+}
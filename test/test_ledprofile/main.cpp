@@ -18,12 +18,18 @@
 
 #include <unity.h>
 
+#include <array>
+
 #include "app/fs.h"
+#include "aurcor/led_bus_format.h"
+#include "aurcor/led_profile.h"
 #include "aurcor/led_profiles.h"
 #include "aurcor/util.h"
 
 #include "test_micropython.h"
 
+using aurcor::LEDBusFormat;
+using aurcor::LEDProfile;
 using aurcor::LEDProfiles;
 using aurcor::Result;
 
@@ -185,6 +191,28 @@ static void test_load() {
 	TEST_ASSERT_EQUAL_INT(253, b);
 }
 
+static void test_snapshot() {
+	LEDProfiles profiles{"test_snapshot"};
+	auto &profile = profiles.get(LED_PROFILE_NORMAL);
+	LEDProfile::SnapshotReader reader;
+	std::array<uint8_t,6> data;
+
+	profile.clear();
+	TEST_ASSERT_EQUAL_INT(Result::OK, profile.set(0, 255, 51, 0));
+
+	data.fill(255);
+	profile.snapshot(reader).transform(data.data(), data.size(), LEDBusFormat::RGB);
+	const std::array<uint8_t,6> expected1{255, 51, 0, 255, 51, 0};
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected1.data(), data.data(), data.size());
+
+	TEST_ASSERT_EQUAL_INT(Result::OK, profile.set(1, 0, 0, 255));
+
+	data.fill(255);
+	profile.snapshot(reader).transform(data.data(), data.size(), LEDBusFormat::RGB);
+	const std::array<uint8_t,6> expected2{255, 51, 0, 0, 0, 255};
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected2.data(), data.data(), data.size());
+}
+
 void tearDown(void) {
 	TestMicroPython::tearDown();
 }
@@ -196,6 +224,7 @@ int main(int argc, char *argv[]) {
 
 	RUN_TEST(test_save);
 	RUN_TEST(test_load);
+	RUN_TEST(test_snapshot);
 
 	return UNITY_END();
 }
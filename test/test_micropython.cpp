@@ -53,6 +53,10 @@ void TestMicroPython::init() {
 	MicroPython::setup(1);
 }
 
+aurcor::App& TestMicroPython::app() {
+	return test_app;
+}
+
 std::shared_ptr<TestByteBufferLEDBus> TestMicroPython::run_bus(size_t length,
 		size_t outputs, const std::string &script) {
 	auto bus = std::make_shared<TestByteBufferLEDBus>();
@@ -91,6 +95,12 @@ TestMicroPython::TestMicroPython(std::shared_ptr<aurcor::LEDBus> bus,
 		: MicroPython("test", bus, preset), bus_(bus) {
 }
 
+TestMicroPython::TestMicroPython(std::shared_ptr<aurcor::LEDBus> bus,
+		std::vector<std::shared_ptr<aurcor::LEDBus>> group)
+		: MicroPython("test", bus,
+			std::make_shared<aurcor::Preset>(test_app, bus), std::move(group)), bus_(bus) {
+}
+
 void TestMicroPython::run(std::string script, bool safe) {
 	script_ = script;
 	safe_ = safe;
@@ -121,6 +131,29 @@ void TestMicroPython::run(std::string script, bool safe) {
 	TEST_ASSERT_FALSE(stop_failed_);
 }
 
+void TestMicroPython::run_for(std::string script, unsigned long duration_ms) {
+	script_ = script;
+	safe_ = true;
+
+	TEST_ASSERT_TRUE(MicroPython::start());
+
+	unsigned long start = millis();
+	while (running() && millis() - start < duration_ms)
+		yield();
+
+	start = millis();
+	while (!stop()) {
+		if (millis() - start > 10000) {
+			stop_failed_ = true;
+			break;
+		} else {
+			yield();
+		}
+	}
+
+	TEST_ASSERT_FALSE(stop_failed_);
+}
+
 void TestMicroPython::main() {
 	nlr_buf_t nlr;
 	nlr.ret_val = nullptr;
@@ -147,6 +180,11 @@ void TestMicroPython::mp_hal_stdout_tx_strn(const uint8_t *str, size_t len) {
 	output_.append(reinterpret_cast<const char *>(str), len);
 }
 
+void TestMicroPython::frame_written() {
+	if (on_frame_written_)
+		on_frame_written_();
+}
+
 uuid::log::Level TestMicroPython::modulogging_effective_level() {
 	return uuid::log::Level::ALL;
 }
@@ -20,16 +20,25 @@
 
 #include "aurcor/micropython.h"
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <uuid/log.h>
 
+namespace aurcor {
+
+class App;
+
+} // namespace aurcor
+
 class TestByteBufferLEDBus;
 
 class TestMicroPython: public aurcor::MicroPython {
 public:
 	static void init();
+	static aurcor::App& app();
 	static std::shared_ptr<TestByteBufferLEDBus> run_bus(size_t length,
 		size_t outputs, const std::string &script);
 	static std::shared_ptr<TestMicroPython> run_script(
@@ -38,22 +47,29 @@ public:
 
 	TestMicroPython(std::shared_ptr<aurcor::LEDBus> bus);
 	TestMicroPython(std::shared_ptr<aurcor::LEDBus> bus, std::shared_ptr<aurcor::Preset> preset);
+	TestMicroPython(std::shared_ptr<aurcor::LEDBus> bus, std::vector<std::shared_ptr<aurcor::LEDBus>> group);
 	virtual ~TestMicroPython() = default;
 
 	const char *type() const override { return "TestMicroPython"; }
 
 	void run(std::string script, bool safe = true);
+	/* Run a script that doesn't finish on its own and then stop it */
+	void run_for(std::string script, unsigned long duration_ms);
+	inline void simulate_clock(uint64_t start_us) { clock().simulate(start_us); }
 
 	std::string output_;
 	int ret_{-1};
 	bool force_exit_{false};
 	bool stop_failed_{false};
 	size_t print_instances_{0};
+	/* Called on the interpreter thread after each frame is written to the bus */
+	std::function<void()> on_frame_written_;
 
 protected:
 	void main() override;
 
 	void mp_hal_stdout_tx_strn(const uint8_t *str, size_t len) override;
+	void frame_written() override;
 
 	uuid::log::Level modulogging_effective_level() override;
 	std::unique_ptr<aurcor::micropython::Print> modulogging_print(uuid::log::Level level) override;
@@ -19,6 +19,7 @@
 #include <unity.h>
 #include <Arduino.h>
 
+#include <array>
 #include <memory>
 
 #include "test_led_bus.h"
@@ -121,6 +122,154 @@ raise Exception()
 	TEST_ASSERT_EQUAL_INT(0, mp.print_instances_);
 }
 
+static void test_simulated_clock() {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	TestMicroPython mp{bus};
+
+	bus->length(1);
+	mp.simulate_clock(1000000);
+	mp.run(R"python(
+import aurcor
+import utime
+start = aurcor.ticks64_us()
+start_time = aurcor.time_us()
+print(start)
+utime.sleep_ms(60000)
+print(aurcor.ticks64_us() - start, aurcor.time_us() - start_time)
+aurcor.output_rgb(bytearray(3))
+aurcor.output_rgb(bytearray(3), wait_ms=10)
+print(aurcor.ticks64_us() - start)
+print(aurcor.next_ticks64_us(wait_ms=10) - start)
+	)python");
+
+	TEST_ASSERT_EQUAL_STRING(
+		"1000000\r\n"
+		"60000000 60000000\r\n"
+		"60010000\r\n"
+		"60020000\r\n",
+		mp.output_.c_str());
+	TEST_ASSERT_EQUAL_INT(2, bus->outputs_.size());
+	TEST_ASSERT_EQUAL_INT(0, mp.ret_);
+}
+
+static void test_ticks30_mod() {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	TestMicroPython mp{bus};
+
+	bus->length(1);
+	/* Beyond the small int range (and ticks period) on every platform */
+	mp.simulate_clock((1ULL << 62) + 500);
+	mp.run(R"python(
+import aurcor
+print(aurcor.next_ticks30_us(wait_us=0, mod=1000))
+print(aurcor.next_ticks64_us(wait_us=0, mod=1000))
+	)python");
+
+	TEST_ASSERT_EQUAL_STRING("404\r\n404\r\n", mp.output_.c_str());
+	TEST_ASSERT_EQUAL_INT(0, mp.ret_);
+}
+
+static void test_frame() {
+	auto bus = TestMicroPython::run_bus(3, 2, R"python(
+import aurcor
+frame = aurcor.frame()
+assert len(frame) == 9
+for i in range(len(frame)):
+	frame[i] = i + 1
+aurcor.show()
+frame[3:6] = bytes((7, 8, 9))
+aurcor.show(wait_us=0)
+	)python");
+
+	std::array<uint8_t,9> expected1{1,2,3,4,5,6,7,8,9};
+	std::array<uint8_t,9> expected2{1,2,3,7,8,9,7,8,9};
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected1.data(), bus->outputs_[0].data(), expected1.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected2.data(), bus->outputs_[1].data(), expected2.size());
+}
+
+static void test_frame_profile() {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	auto &profile = bus->profile(LED_PROFILE_NORMAL);
+	TestMicroPython mp{bus};
+
+	profile.clear();
+	profile.set(0, 127, 127, 127);
+	bus->length(1);
+	mp.run(R"python(
+import aurcor
+frame = aurcor.frame()
+frame[0:3] = bytes((254, 254, 254))
+aurcor.show(wait_us=0)
+aurcor.show(wait_us=0)
+print(list(frame))
+	)python");
+
+	/* The profile must not be applied to the script's frame */
+	std::array<uint8_t,3> expected{126,126,126};
+	TEST_ASSERT_EQUAL_STRING("[254, 254, 254]\r\n", mp.output_.c_str());
+	TEST_ASSERT_EQUAL_INT(2, bus->outputs_.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), bus->outputs_[0].data(), expected.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), bus->outputs_[1].data(), expected.size());
+	TEST_ASSERT_EQUAL_INT(0, mp.ret_);
+}
+
+static void test_non_blocking() {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	TestMicroPython mp{bus};
+
+	bus->length(1);
+	mp.simulate_clock(1000000);
+	mp.run(R"python(
+import aurcor
+print(aurcor.output_rgb(bytearray(3), wait_ms=10, block=False) == aurcor.OUTPUT_SENT)
+print(aurcor.output_rgb(bytearray(3), wait_ms=10, block=False) == aurcor.OUTPUT_SKIPPED)
+print(aurcor.show(wait_ms=10, block=False) == aurcor.OUTPUT_SKIPPED)
+print(aurcor.output_rgb(bytearray(3), wait_ms=10) == aurcor.OUTPUT_SENT)
+	)python");
+
+	TEST_ASSERT_EQUAL_STRING("True\r\nTrue\r\nTrue\r\nTrue\r\n", mp.output_.c_str());
+	TEST_ASSERT_EQUAL_INT(2, bus->outputs_.size());
+	TEST_ASSERT_EQUAL_INT(2, bus->skipped_frames());
+	TEST_ASSERT_EQUAL_INT(0, mp.ret_);
+}
+
+static void test_group() {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	auto member = std::make_shared<TestByteBufferLEDBus>();
+	TestMicroPython mp{bus, {member}};
+
+	bus->length(1);
+	member->length(2);
+	mp.run(R"python(
+import aurcor
+print(aurcor.buses(), aurcor.length(), aurcor.length(0), aurcor.length(1))
+try:
+	aurcor.length(2)
+except IndexError as e:
+	print(e)
+print(aurcor.output_rgb([0x010203, 0x040506], bus=1) == aurcor.OUTPUT_QUEUED)
+print(aurcor.output_rgb([0x0A0B0C, 0x0D0E0F], bus=1) == aurcor.OUTPUT_QUEUED)
+print(aurcor.output_rgb([0x070809]) == aurcor.OUTPUT_SENT)
+	)python");
+
+	TEST_ASSERT_EQUAL_STRING(
+		"2 1 1 2\r\n"
+		"bus index out of range\r\n"
+		"True\r\n"
+		"True\r\n"
+		"True\r\n",
+		mp.output_.c_str());
+	TEST_ASSERT_EQUAL_INT(0, mp.ret_);
+
+	/* Frames for the group are held until the next frame for the main bus */
+	std::array<uint8_t,3> expected{7,8,9};
+	std::array<uint8_t,6> expected_member{10,11,12,13,14,15};
+	TEST_ASSERT_EQUAL_INT(1, bus->outputs_.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), bus->outputs_[0].data(), expected.size());
+	TEST_ASSERT_EQUAL_INT(1, member->outputs_.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_member.data(), member->outputs_[0].data(), expected_member.size());
+}
+
 void tearDown(void) {
 	TestMicroPython::tearDown();
 }
@@ -136,6 +285,12 @@ int main(int argc, char *argv[]) {
 	RUN_TEST(test_logging);
 	RUN_TEST(test_logging_exception);
 	RUN_TEST(test_uncaught_exception);
+	RUN_TEST(test_simulated_clock);
+	RUN_TEST(test_ticks30_mod);
+	RUN_TEST(test_frame);
+	RUN_TEST(test_frame_profile);
+	RUN_TEST(test_non_blocking);
+	RUN_TEST(test_group);
 
 	return UNITY_END();
 }
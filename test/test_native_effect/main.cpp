@@ -0,0 +1,223 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+
+#include <array>
+#include <memory>
+
+#include "aurcor/app.h"
+#include "aurcor/native_effect.h"
+#include "aurcor/preset.h"
+
+#include "test_led_bus.h"
+#include "test_micropython.h"
+
+using aurcor::NativeEffect;
+using aurcor::Preset;
+using aurcor::Result;
+using aurcor::ScriptConfig;
+
+static aurcor::App test_app;
+
+static std::shared_ptr<Preset> make_preset(NativeEffect::Renderer &renderer) {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	auto preset = std::make_shared<Preset>(test_app, bus);
+
+	preset->register_config([&] (ScriptConfig &config) { renderer.register_config(config); });
+	return preset;
+}
+
+static void read_config(NativeEffect::Renderer &renderer, Preset &preset) {
+	TEST_ASSERT_TRUE(preset.populate_config([&] (const ScriptConfig &config) {
+		renderer.read_config(config);
+	}));
+}
+
+template <size_t N>
+static void assert_render(NativeEffect::Renderer &renderer, const std::array<uint8_t,N> &expected, uint64_t now_us) {
+	std::array<uint8_t,N> frame{};
+
+	renderer.render(frame.data(), N / 3, now_us);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), frame.data(), N);
+}
+
+static void test_unsupported() {
+	NativeEffect::Renderer renderer{"static_rgb"};
+	auto preset = make_preset(renderer);
+
+	TEST_ASSERT_FALSE(NativeEffect::supported("rainbow", ScriptConfig{}));
+
+	TEST_ASSERT_TRUE(preset->populate_config([&] (const ScriptConfig &config) {
+		TEST_ASSERT_TRUE(NativeEffect::supported("static_rgb", config));
+		renderer.read_config(config);
+	}));
+	TEST_ASSERT_FALSE(renderer.fallback());
+
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("sweep.enabled", "true"));
+	TEST_ASSERT_TRUE(preset->populate_config([&] (const ScriptConfig &config) {
+		TEST_ASSERT_FALSE(NativeEffect::supported("static_rgb", config));
+		renderer.read_config(config);
+	}));
+	TEST_ASSERT_TRUE(renderer.fallback());
+
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("sweep.enabled", "false"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("twinkle.enabled", "true"));
+	read_config(renderer, *preset);
+	TEST_ASSERT_TRUE(renderer.fallback());
+
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("twinkle.enabled", "false"));
+	read_config(renderer, *preset);
+	TEST_ASSERT_FALSE(renderer.fallback());
+}
+
+static void test_unsupported_overlays() {
+	NativeEffect::Renderer hue_scroll{"hue_scroll"};
+	NativeEffect::Renderer burst_rgb{"burst_rgb"};
+	auto hue_scroll_preset = make_preset(hue_scroll);
+	auto burst_rgb_preset = make_preset(burst_rgb);
+
+	/* There's no sweep overlay for hue_scroll */
+	TEST_ASSERT_EQUAL_INT(Result::NOT_FOUND, hue_scroll_preset->set_config("sweep.enabled", "true"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, hue_scroll_preset->set_config("twinkle.enabled", "true"));
+	read_config(hue_scroll, *hue_scroll_preset);
+	TEST_ASSERT_TRUE(hue_scroll.fallback());
+
+	/* There are no overlays for burst_rgb */
+	TEST_ASSERT_EQUAL_INT(Result::NOT_FOUND, burst_rgb_preset->set_config("twinkle.enabled", "true"));
+	read_config(burst_rgb, *burst_rgb_preset);
+	TEST_ASSERT_FALSE(burst_rgb.fallback());
+}
+
+static void test_static_rgb() {
+	NativeEffect::Renderer renderer{"static_rgb"};
+	auto preset = make_preset(renderer);
+
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->add_config("colours", "#FF9900"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->add_config("colours", "#00FF00"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("profile", "hdr"));
+	read_config(renderer, *preset);
+
+	TEST_ASSERT_EQUAL_INT(LED_PROFILE_HDR, renderer.profile());
+	assert_render(renderer, std::array<uint8_t,9>{
+		0xFF,0x99,0x00, 0x00,0xFF,0x00, 0xFF,0x99,0x00}, 0);
+	assert_render(renderer, std::array<uint8_t,9>{
+		0xFF,0x99,0x00, 0x00,0xFF,0x00, 0xFF,0x99,0x00}, 12345678);
+}
+
+static void test_hue_fade() {
+	NativeEffect::Renderer renderer{"hue_fade"};
+	auto preset = make_preset(renderer);
+
+	/* 1ms per 2 expanded hues */
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("duration", "420"));
+	read_config(renderer, *preset);
+
+	TEST_ASSERT_FALSE(renderer.real_time());
+	TEST_ASSERT_EQUAL_INT(LED_PROFILE_NORMAL, renderer.profile());
+	assert_render(renderer, std::array<uint8_t,6>{0xFF,0x00,0x00, 0xFF,0x00,0x00}, 0);
+	assert_render(renderer, std::array<uint8_t,6>{0xFF,0x80,0x00, 0xFF,0x80,0x00}, 60000);
+	assert_render(renderer, std::array<uint8_t,6>{0xFF,0xFF,0x00, 0xFF,0xFF,0x00}, 120000);
+	assert_render(renderer, std::array<uint8_t,6>{0x00,0xFF,0x00, 0x00,0xFF,0x00}, 180000);
+	assert_render(renderer, std::array<uint8_t,6>{0x00,0x00,0xFF, 0x00,0x00,0xFF}, 300000);
+	assert_render(renderer, std::array<uint8_t,6>{0xFF,0x00,0x00, 0xFF,0x00,0x00}, 420000);
+}
+
+static void test_hue_scroll() {
+	NativeEffect::Renderer renderer{"hue_scroll"};
+	auto preset = make_preset(renderer);
+
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("duration", "1000"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("real_time", "true"));
+	read_config(renderer, *preset);
+
+	TEST_ASSERT_TRUE(renderer.real_time());
+	assert_render(renderer, std::array<uint8_t,12>{
+		0xFF,0x00,0x00, 0xFF,0xDF,0x00, 0x00,0xFF,0x80, 0x40,0x00,0xFF}, 0);
+	/* A quarter of the duration moves the hues along by one of four LEDs */
+	assert_render(renderer, std::array<uint8_t,12>{
+		0xFF,0xDF,0x00, 0x00,0xFF,0x80, 0x40,0x00,0xFF, 0xFF,0x00,0x00}, 250000);
+	assert_render(renderer, std::array<uint8_t,12>{
+		0xFF,0x00,0x00, 0xFF,0xDF,0x00, 0x00,0xFF,0x80, 0x40,0x00,0xFF}, 1000000);
+}
+
+static void test_burst_rgb() {
+	NativeEffect::Renderer renderer{"burst_rgb"};
+	auto preset = make_preset(renderer);
+
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->add_config("colours", "#FF0000"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->add_config("colours", "#0000FF"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("number", "2"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("duration", "1000"));
+	read_config(renderer, *preset);
+
+	/* Filled from the end, with too few LEDs for any fade */
+	assert_render(renderer, std::array<uint8_t,54>{
+		0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00,
+		0x00,0x00,0xFF, 0x00,0x00,0xFF, 0x00,0x00,0xFF, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00,
+		0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0xFF,0x00,0x00, 0xFF,0x00,0x00, 0xFF,0x00,0x00}, 0);
+	assert_render(renderer, std::array<uint8_t,54>{
+		0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00,
+		0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0xFF, 0x00,0x00,0xFF, 0x00,0x00,0xFF, 0x00,0x00,0x00,
+		0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0xFF,0x00,0x00}, 100000);
+	assert_render(renderer, std::array<uint8_t,54>{
+		0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0xFF,0x00,0x00, 0xFF,0x00,0x00,
+		0xFF,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00,
+		0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0x00, 0x00,0x00,0xFF}, 500000);
+}
+
+/* The trailing fade mirrors the leading fade */
+static void test_burst_rgb_fade() {
+	NativeEffect::Renderer renderer{"burst_rgb"};
+	auto preset = make_preset(renderer);
+	std::array<uint8_t,54> frame{};
+
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->add_config("colours", "#FF0000"));
+	TEST_ASSERT_EQUAL_INT(Result::OK, preset->set_config("number", "1"));
+	read_config(renderer, *preset);
+
+	/* One LED of fade either side of the active LEDs, filled from the end */
+	renderer.render(frame.data(), 18, 0);
+	TEST_ASSERT_GREATER_THAN_UINT8(0, frame[17 * 3]);
+	TEST_ASSERT_LESS_THAN_UINT8(0xFF, frame[17 * 3]);
+	for (size_t i = 12; i <= 16; i++)
+		TEST_ASSERT_EQUAL_UINT8(0xFF, frame[i * 3]);
+	TEST_ASSERT_EQUAL_UINT8(frame[17 * 3], frame[11 * 3]);
+	TEST_ASSERT_EQUAL_UINT8(0, frame[10 * 3]);
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(test_unsupported);
+	RUN_TEST(test_unsupported_overlays);
+	RUN_TEST(test_static_rgb);
+	RUN_TEST(test_hue_fade);
+	RUN_TEST(test_hue_scroll);
+	RUN_TEST(test_burst_rgb);
+	RUN_TEST(test_burst_rgb_fade);
+
+	return UNITY_END();
+}
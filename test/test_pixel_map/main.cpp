@@ -0,0 +1,86 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity.h>
+
+#include <vector>
+
+#include "aurcor/pixel_map.h"
+
+#include "test_micropython.h"
+
+using aurcor::PixelMap;
+
+static void test_matrix() {
+	PixelMap map;
+
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, map.compile(3, 2, false, false, {}));
+	TEST_ASSERT_EQUAL_UINT(6, map.length());
+
+	std::vector<PixelMap::index_t> expected{0, 1, 2, 3, 4, 5};
+	TEST_ASSERT_EQUAL_UINT(expected.size(), map.lut().size());
+	TEST_ASSERT_EQUAL_UINT16_ARRAY(expected.data(), map.lut().data(), expected.size());
+}
+
+static void test_serpentine() {
+	PixelMap map;
+
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, map.compile(3, 2, false, true, {}));
+
+	std::vector<PixelMap::index_t> expected{0, 1, 2, 5, 4, 3};
+	TEST_ASSERT_EQUAL_UINT(expected.size(), map.lut().size());
+	TEST_ASSERT_EQUAL_UINT16_ARRAY(expected.data(), map.lut().data(), expected.size());
+
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, map.compile(3, 2, true, true, {}));
+
+	expected = {0, 3, 4, 1, 2, 5};
+	TEST_ASSERT_EQUAL_UINT(expected.size(), map.lut().size());
+	TEST_ASSERT_EQUAL_UINT16_ARRAY(expected.data(), map.lut().data(), expected.size());
+}
+
+static void test_segments() {
+	PixelMap map;
+
+	/* Two segments with a gap of 2 LEDs, the second is reversed */
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OK, map.compile(5, 1, false, false,
+		{{0, 2, false}, {4, 3, true}}));
+	TEST_ASSERT_EQUAL_UINT(5, map.length());
+
+	std::vector<PixelMap::index_t> expected{0, 1, PixelMap::UNMAPPED, PixelMap::UNMAPPED, 4, 3, 2};
+	TEST_ASSERT_EQUAL_UINT(expected.size(), map.lut().size());
+	TEST_ASSERT_EQUAL_UINT16_ARRAY(expected.data(), map.lut().data(), expected.size());
+
+	TEST_ASSERT_EQUAL_INT(aurcor::Result::OUT_OF_RANGE, map.compile(0, 1, false, false, {}));
+	TEST_ASSERT_TRUE(map.empty());
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+
+	RUN_TEST(test_matrix);
+	RUN_TEST(test_serpentine);
+	RUN_TEST(test_segments);
+
+	return UNITY_END();
+}
@@ -0,0 +1,223 @@
+/*
+ * aurora-coriolis - ESP32 WS281x multi-channel LED controller with MicroPython
+ * Copyright 2023  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unity.h>
+#include <Arduino.h>
+
+#include <array>
+#include <memory>
+
+#include "aurcor/app.h"
+#include "aurcor/transition.h"
+#include "aurcor/util.h"
+
+#include "test_led_bus.h"
+#include "test_micropython.h"
+
+using aurcor::Transition;
+
+static void test_inactive() {
+	Transition transition;
+	std::array<uint8_t,3> src{10, 20, 30};
+	std::array<uint8_t,3> dst{1, 2, 3};
+	std::array<uint8_t,3> expected{1, 2, 3};
+
+	TEST_ASSERT_FALSE(transition.start(Transition::Type::NONE, 1000, 1000000));
+	TEST_ASSERT_FALSE(transition.start(Transition::Type::CROSSFADE, 0, 1000000));
+	TEST_ASSERT_FALSE(transition.active());
+	TEST_ASSERT_FALSE(transition.blend(src.data(), dst.data(), dst.size(), 1000000));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), dst.data(), expected.size());
+}
+
+static void test_crossfade() {
+	Transition transition;
+	std::array<uint8_t,6> outgoing{200, 100, 0, 255, 255, 255};
+	std::array<uint8_t,6> src{0, 100, 200, 0, 0, 0};
+	std::array<uint8_t,6> dst{};
+
+	TEST_ASSERT_TRUE(transition.start(Transition::Type::CROSSFADE, 1000, 1000000));
+	TEST_ASSERT_TRUE(transition.active());
+
+	/* Only the first LED has been rendered by the outgoing script */
+	transition.outgoing(outgoing.data(), 3);
+
+	std::array<uint8_t,6> start{200, 100, 0, 0, 0, 0};
+	TEST_ASSERT_TRUE(transition.blend(src.data(), dst.data(), dst.size(), 1000000));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(start.data(), dst.data(), start.size());
+
+	transition.outgoing(outgoing.data(), outgoing.size());
+
+	std::array<uint8_t,6> halfway{100, 100, 100, 127, 127, 127};
+	TEST_ASSERT_TRUE(transition.blend(src.data(), dst.data(), dst.size(), 1500000));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(halfway.data(), dst.data(), halfway.size());
+
+	/* The incoming frame is not modified */
+	std::array<uint8_t,6> unmodified{0, 100, 200, 0, 0, 0};
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(unmodified.data(), src.data(), unmodified.size());
+
+	/* In place */
+	TEST_ASSERT_TRUE(transition.blend(src.data(), src.data(), src.size(), 1500000));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(halfway.data(), src.data(), halfway.size());
+
+	TEST_ASSERT_FALSE(transition.blend(src.data(), dst.data(), dst.size(), 2000000));
+	TEST_ASSERT_FALSE(transition.active());
+}
+
+static void test_wipe() {
+	Transition transition;
+	std::array<uint8_t,12> outgoing{1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4};
+	std::array<uint8_t,12> src{5, 5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8};
+	std::array<uint8_t,12> dst{};
+
+	TEST_ASSERT_TRUE(transition.start(Transition::Type::WIPE, 1000, 1000000));
+	transition.outgoing(outgoing.data(), outgoing.size());
+
+	std::array<uint8_t,12> start{1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4};
+	TEST_ASSERT_TRUE(transition.blend(src.data(), dst.data(), dst.size(), 1000000));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(start.data(), dst.data(), start.size());
+
+	std::array<uint8_t,12> halfway{5, 5, 5, 6, 6, 6, 3, 3, 3, 4, 4, 4};
+	TEST_ASSERT_TRUE(transition.blend(src.data(), dst.data(), dst.size(), 1500000));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(halfway.data(), dst.data(), halfway.size());
+
+	/* Finished by the bus loop */
+	transition.loop(1999999);
+	TEST_ASSERT_TRUE(transition.active());
+	transition.loop(2000000);
+	TEST_ASSERT_FALSE(transition.active());
+}
+
+static void test_no_buffer() {
+	Transition transition1;
+	Transition transition2;
+
+	TEST_ASSERT_TRUE(transition1.start(Transition::Type::CROSSFADE, 1000, 1000000));
+	TEST_ASSERT_FALSE(transition2.start(Transition::Type::CROSSFADE, 1000, 1000000));
+
+	transition1.stop();
+	TEST_ASSERT_TRUE(transition2.start(Transition::Type::CROSSFADE, 1000, 1000000));
+}
+
+static void test_app_not_running() {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	auto mp = std::make_shared<TestMicroPython>(bus);
+	auto &app = TestMicroPython::app();
+
+	TEST_ASSERT_FALSE(app.transition(bus));
+
+	app.attach(bus, mp);
+	TEST_ASSERT_FALSE(app.transition(bus));
+
+	/* The script isn't running so it can't be the outgoing script */
+	bus->transition(Transition::Type::CROSSFADE, 1000);
+	TEST_ASSERT_FALSE(app.transition(bus));
+	TEST_ASSERT_FALSE(bus->transition().active());
+	TEST_ASSERT_TRUE(app.detach(bus, mp, false));
+}
+
+/*
+ * Frames from the outgoing script are blended into frames from the incoming
+ * script, but the outgoing script's frame rate and skipped frames must not
+ * affect the bus.
+ */
+static void test_app_outgoing() {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	auto mp = std::make_shared<TestMicroPython>(bus);
+	auto &app = TestMicroPython::app();
+	unsigned int transitions = 0;
+
+	bus->length(1);
+	bus->transition(Transition::Type::CROSSFADE, 60000);
+	app.attach(bus, mp);
+	mp->on_frame_written_ = [&] {
+		if (app.transition(bus))
+			transitions++;
+	};
+
+	mp->simulate_clock(1000000);
+	mp->run(R"python(
+import aurcor
+print(aurcor.output_rgb([0x102030], wait_ms=10) == aurcor.OUTPUT_SENT)
+print(aurcor.output_rgb([0x405060], wait_ms=10) == aurcor.OUTPUT_SENT)
+print(aurcor.output_rgb([0x708090], wait_ms=10, block=False) == aurcor.OUTPUT_SKIPPED)
+	)python");
+
+	TEST_ASSERT_EQUAL_STRING("True\r\nTrue\r\nTrue\r\n", mp->output_.c_str());
+	TEST_ASSERT_EQUAL_INT(0, mp->ret_);
+	TEST_ASSERT_EQUAL_INT(1, transitions);
+
+	std::array<uint8_t,3> first{0x10, 0x20, 0x30};
+	TEST_ASSERT_EQUAL_INT(1, bus->outputs_.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(first.data(), bus->outputs_[0].data(), first.size());
+	TEST_ASSERT_EQUAL_INT(0, bus->skipped_frames());
+
+	std::array<uint8_t,3> src{};
+	std::array<uint8_t,3> dst{};
+	std::array<uint8_t,3> outgoing{0x40, 0x50, 0x60};
+	TEST_ASSERT_TRUE(bus->transition().active());
+	TEST_ASSERT_TRUE(bus->transition().blend(src.data(), dst.data(), dst.size(), aurcor::current_time_us()));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(outgoing.data(), dst.data(), outgoing.size());
+
+	bus->transition().stop();
+}
+
+/* Output with a simulated clock must be reproducible */
+static void test_simulated_clock() {
+	auto bus = std::make_shared<TestByteBufferLEDBus>();
+	TestMicroPython mp{bus};
+	std::array<uint8_t,3> outgoing{0xFF, 0xFF, 0xFF};
+
+	bus->length(1);
+	TEST_ASSERT_TRUE(bus->transition().start(Transition::Type::CROSSFADE, 60000, aurcor::current_time_us()));
+	bus->transition().outgoing(outgoing.data(), outgoing.size());
+
+	mp.simulate_clock(1000000);
+	mp.run(R"python(
+import aurcor
+aurcor.output_rgb([0x102030])
+	)python");
+
+	std::array<uint8_t,3> expected{0x10, 0x20, 0x30};
+	TEST_ASSERT_EQUAL_INT(0, mp.ret_);
+	TEST_ASSERT_EQUAL_INT(1, bus->outputs_.size());
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), bus->outputs_[0].data(), expected.size());
+	TEST_ASSERT_TRUE(bus->transition().active());
+
+	bus->transition().stop();
+}
+
+void tearDown(void) {
+	TestMicroPython::tearDown();
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+
+	TestMicroPython::init();
+	Transition::setup(1);
+
+	RUN_TEST(test_inactive);
+	RUN_TEST(test_crossfade);
+	RUN_TEST(test_wipe);
+	RUN_TEST(test_no_buffer);
+	RUN_TEST(test_app_not_running);
+	RUN_TEST(test_app_outgoing);
+	RUN_TEST(test_simulated_clock);
+
+	return UNITY_END();
+}